@@ -8,7 +8,8 @@
 static bool RunBenchmark(std::function<void()> setupFn,
                          std::function<bool()> benchFn,
                          std::function<void()> teardownFn,
-                         size_t minIter = 5, double minTime = 5.0) {
+                         size_t minIter = 5, double minTime = 5.0,
+                         size_t bytesPerIter = 0) {
     // Warmup
     setupFn();
     if(!benchFn()) {
@@ -36,6 +37,10 @@ static bool RunBenchmark(std::function<void()> setupFn,
     fprintf(stdout, "Iterations: %zd\n", iter);
     fprintf(stdout, "Time:       %.3f s\n", time);
     fprintf(stdout, "Per iter.:  %.3f s\n", time / (double)iter);
+    if(bytesPerIter > 0) {
+        fprintf(stdout, "Throughput: %.1f MB/s\n",
+                (double)bytesPerIter * (double)iter / time / 1e6);
+    }
 
     return true;
 }
@@ -56,6 +61,29 @@ int main(int argc, char **argv) {
 
     bool result = false;
     if(mode == "load") {
+        // Reading the file alone, and then together with regenerating it.
+        std::string data;
+        if(!ReadFile(filename, &data)) {
+            fprintf(stderr, "Cannot read \"%s\"\n", filename.raw.c_str());
+            return 1;
+        }
+
+        fprintf(stdout, "Parse:\n");
+        result = RunBenchmark(
+            [] {
+                SS.Init();
+            },
+            [&] {
+                return SS.ParseFile(filename);
+            },
+            [] {
+                SK.Clear();
+                SS.Clear();
+            },
+            5, 5.0, data.size());
+        if(!result) return 1;
+
+        fprintf(stdout, "Load:\n");
         result = RunBenchmark(
             [] {
                 SS.Init();
@@ -11,7 +11,41 @@
 SBsp2 *SBsp2::Alloc() { return (SBsp2 *)AllocTemporary(sizeof(SBsp2)); }
 SBsp3 *SBsp3::Alloc() { return (SBsp3 *)AllocTemporary(sizeof(SBsp3)); }
 
-SBsp3 *SBsp3::FromMesh(const SMesh *m) {
+namespace {
+
+enum class PlaneSide { POS, NEG, ON, BOTH };
+
+// Which side of a node's plane a triangle would go to, with the same
+// tolerance that BspUtil uses to classify it for real.
+PlaneSide SideOfPlane(const STriangle *tr, Vector n, double d) {
+    int posc = 0, negc = 0;
+    for(int i = 0; i < 3; i++) {
+        double dt = (tr->vertices[i]).Dot(n);
+        if(dt > d + LENGTH_EPS) {
+            posc++;
+        } else if(dt < d - LENGTH_EPS) {
+            negc++;
+        }
+    }
+    if(posc > 0 && negc > 0) return PlaneSide::BOTH;
+    if(posc > 0) return PlaneSide::POS;
+    if(negc > 0) return PlaneSide::NEG;
+    return PlaneSide::ON;
+}
+
+}
+
+//-----------------------------------------------------------------------------
+// Build the tree for a mesh. Each triangle becomes the splitter of the first
+// empty leaf that it reaches, so the shape of the tree depends only on the
+// order in which they're inserted. So choose that order top-down: of a few
+// candidates for the root of each subtree, take the one whose plane splits
+// the fewest of the other triangles and best balances the rest, and then do
+// the same on either side. The triangles that straddle a splitter go in last,
+// so that their pieces don't become splitters themselves. Unless ordered, the
+// triangles just go in shuffled, as they used to.
+//-----------------------------------------------------------------------------
+SBsp3 *SBsp3::FromMesh(const SMesh *m, bool ordered) {
     SBsp3 *bsp3 = NULL;
     int i;
 
@@ -28,8 +62,82 @@ SBsp3 *SBsp3::FromMesh(const SMesh *m) {
         swap(mc.l.elem[k], mc.l.elem[n]);
     }
 
+    // Since the triangles are shuffled, and every subset below keeps that
+    // order, the first few of any subset are a random sample of it.
+    const size_t CANDIDATES = 8;
+    const size_t SAMPLES    = 64;
+    const int    SPLIT_COST = 8;
+
+    std::vector<int> order, straddling;
+    order.reserve(mc.l.n);
+    std::vector<std::vector<int>> work(1);
     for(i = 0; i < mc.l.n; i++) {
-        bsp3 = InsertOrCreate(bsp3, &(mc.l.elem[i]), NULL);
+        work[0].push_back(i);
+    }
+    if(!ordered) {
+        order = std::move(work[0]);
+        work.clear();
+    }
+    while(!work.empty()) {
+        std::vector<int> tris = std::move(work.back());
+        work.pop_back();
+
+        int best = -1, bestCost = INT_MAX;
+        bool bestOneSided = false;
+        Vector bestn = Vector::From(0, 0, 0);
+        double bestd = 0;
+        for(size_t c = 0; c < tris.size() && c < CANDIDATES && tris.size() > 2; c++) {
+            const STriangle *tr = &(mc.l.elem[tris[c]]);
+            if(tr->MinAltitude() < LENGTH_EPS) continue;
+            Vector tn = (tr->Normal()).WithMagnitude(1);
+            double td = (tr->a).Dot(tn);
+
+            int posc = 0, negc = 0, splitc = 0;
+            for(size_t j = 0; j < tris.size() && j < SAMPLES; j++) {
+                switch(SideOfPlane(&(mc.l.elem[tris[j]]), tn, td)) {
+                    case PlaneSide::POS:  posc++;   break;
+                    case PlaneSide::NEG:  negc++;   break;
+                    case PlaneSide::BOTH: splitc++; break;
+                    case PlaneSide::ON:             break;
+                }
+            }
+            int cost = SPLIT_COST*splitc + abs(posc - negc);
+            if(cost < bestCost) {
+                best         = (int)c;
+                bestCost     = cost;
+                bestOneSided = (splitc == 0 && (posc == 0 || negc == 0));
+                bestn        = tn;
+                bestd        = td;
+            }
+        }
+        if(best < 0 || bestOneSided) {
+            // Too few or too degenerate to be worth choosing; or else most
+            // likely a convex piece, for which every plane leaves all the
+            // rest on one side, so that any order gives the same chain.
+            order.insert(order.end(), tris.begin(), tris.end());
+            continue;
+        }
+
+        // The splitter goes first, and then the triangles in its plane, which
+        // will join its node.
+        order.push_back(tris[best]);
+        std::vector<int> pos, neg;
+        for(size_t j = 0; j < tris.size(); j++) {
+            if((int)j == best) continue;
+            switch(SideOfPlane(&(mc.l.elem[tris[j]]), bestn, bestd)) {
+                case PlaneSide::POS:  pos.push_back(tris[j]);        break;
+                case PlaneSide::NEG:  neg.push_back(tris[j]);        break;
+                case PlaneSide::BOTH: straddling.push_back(tris[j]); break;
+                case PlaneSide::ON:   order.push_back(tris[j]);      break;
+            }
+        }
+        if(!neg.empty()) work.push_back(std::move(neg));
+        if(!pos.empty()) work.push_back(std::move(pos));
+    }
+    order.insert(order.end(), straddling.begin(), straddling.end());
+
+    for(int k : order) {
+        bsp3 = InsertOrCreate(bsp3, &(mc.l.elem[k]), NULL);
     }
 
     mc.Clear();
@@ -82,16 +190,27 @@ void SBsp3::InsertInPlane(bool pos2, STriangle *tr, SMesh *m) {
     }
 }
 
+// When we're only classifying against the tree (instead is set), the tree
+// must not be written at all, not even the same child pointer back, since
+// that may be happening on several threads at once.
 void SBsp3::InsertHow(BspClass how, STriangle *tr, SMesh *instead) {
     switch(how) {
         case BspClass::POS:
             if(instead && !pos) goto alt;
-            pos = InsertOrCreate(pos, tr, instead);
+            if(pos) {
+                pos->Insert(tr, instead);
+            } else {
+                pos = InsertOrCreate(pos, tr, instead);
+            }
             break;
 
         case BspClass::NEG:
             if(instead && !neg) goto alt;
-            neg = InsertOrCreate(neg, tr, instead);
+            if(neg) {
+                neg->Insert(tr, instead);
+            } else {
+                neg = InsertOrCreate(neg, tr, instead);
+            }
             break;
 
         case BspClass::COPLANAR: {
@@ -390,14 +509,14 @@ void SBsp3::InsertConvexHow(BspClass how, STriMeta meta, Vector *vertex, size_t
     switch(how) {
         case BspClass::POS:
             if(pos) {
-                pos = pos->InsertConvex(meta, vertex, n, instead);
+                pos->InsertConvex(meta, vertex, n, instead);
                 return;
             }
             break;
 
         case BspClass::NEG:
             if(neg) {
-                neg = neg->InsertConvex(meta, vertex, n, instead);
+                neg->InsertConvex(meta, vertex, n, instead);
                 return;
             }
             break;
@@ -94,6 +94,11 @@ void TextWindow::ScreenChangeCheckClosedContour(int link, uint32_t v) {
     InvalidateGraphics();
 }
 
+void TextWindow::ScreenChangeSaveRegenCache(int link, uint32_t v) {
+    SS.saveRegenCache = !SS.saveRegenCache;
+    InvalidateGraphics();
+}
+
 void TextWindow::ScreenChangeShadedTriangles(int link, uint32_t v) {
     SS.exportShadedTriangles = !SS.exportShadedTriangles;
     InvalidateGraphics();
@@ -313,12 +318,21 @@ void TextWindow::ShowConfiguration() {
     Printf(false, "  %Fd%f%Ll%s  show areas of closed contours%E",
         &ScreenChangeShowContourAreas,
         SS.showContourAreas ? CHECK_TRUE : CHECK_FALSE);
+    Printf(false, "  %Fd%f%Ll%s  save geometry to skip regenerating on load%E",
+        &ScreenChangeSaveRegenCache,
+        SS.saveRegenCache ? CHECK_TRUE : CHECK_FALSE);
 
     Printf(false, "");
     Printf(false, "%Ft autosave interval (in minutes)%E");
     Printf(false, "%Ba   %d %Fl%Ll%f[change]%E",
         SS.autosaveInterval, &ScreenChangeAutosaveInterval);
 
+    Printf(false, "");
+    Printf(false, "%Ft undo history%E");
+    Printf(false, "%Ba   %d undo, %d redo steps in %s KB",
+        SS.undo.cnt, SS.redo.cnt,
+        ssprintf("%.1f", SS.UndoMemoryUsed() / 1024.0).c_str());
+
     if(canvas) {
         const char *gl_vendor, *gl_renderer, *gl_version;
         canvas->GetIdent(&gl_vendor, &gl_renderer, &gl_version);
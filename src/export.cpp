@@ -385,6 +385,7 @@ void SolveSpaceUI::ExportLinesAndMesh(SEdgeList *sel, SBezierList *sbl, SMesh *s
     // And now we perform hidden line removal if requested
     SEdgeList hlrd = {};
     if(sm) {
+        int64_t startMillis = GetMilliseconds();
         SKdNode *root = SKdNode::From(&smp);
 
         // Generate the edges where a curved surface turns from front-facing
@@ -395,36 +396,47 @@ void SolveSpaceUI::ExportLinesAndMesh(SEdgeList *sel, SBezierList *sbl, SMesh *s
                                        GW.showOutlines ? Style::OUTLINE : Style::SOLID_EDGE);
         }
 
-        root->ClearTags();
-        int cnt = 1234;
-
-        SEdge *se;
-        for(se = sel->l.First(); se; se = sel->l.NextAfter(se)) {
-            if(se->auxA == Style::CONSTRAINT) {
-                // Constraints should not get hidden line removed; they're
-                // always on top.
-                hlrd.AddEdge(se->a, se->b, se->auxA);
-                continue;
-            }
+        // Each edge gets split and occlusion tested on its own, against a
+        // tree that's only read; so spread the edges across threads, in
+        // chunks that each keep their own visit stamps, and then collect the
+        // results in the original order.
+        const int CHUNK = 64;
+        int chunks = (sel->l.n + CHUNK - 1) / CHUNK;
+        std::vector<SEdgeList> results(sel->l.n);
+        ParallelFor(chunks, [&](size_t chunk) {
+            SKdNode::VisitStamps visited = {};
+            int end = min((int)(chunk + 1)*CHUNK, sel->l.n);
+            for(int i = (int)chunk*CHUNK; i < end; i++) {
+                const SEdge *se = &(sel->l.elem[i]);
+                SEdgeList *edges = &results[i];
+                if(se->auxA == Style::CONSTRAINT) {
+                    // Constraints should not get hidden line removed; they're
+                    // always on top.
+                    edges->AddEdge(se->a, se->b, se->auxA);
+                    continue;
+                }
 
-            SEdgeList edges = {};
-            // Split the original edge against the mesh
-            edges.AddEdge(se->a, se->b, se->auxA);
-            root->OcclusionTestLine(*se, &edges, cnt);
-            if(SS.GW.drawOccludedAs == GraphicsWindow::DrawOccludedAs::STIPPLED) {
-                for(SEdge &se : edges.l) {
-                    if(se.tag == 1) {
-                        se.auxA = Style::HIDDEN_EDGE;
+                // Split the original edge against the mesh
+                edges->AddEdge(se->a, se->b, se->auxA);
+                visited.Begin();
+                root->OcclusionTestLine(*se, edges, &visited);
+                if(SS.GW.drawOccludedAs == GraphicsWindow::DrawOccludedAs::STIPPLED) {
+                    for(SEdge &se : edges->l) {
+                        if(se.tag == 1) {
+                            se.auxA = Style::HIDDEN_EDGE;
+                        }
                     }
+                } else if(SS.GW.drawOccludedAs == GraphicsWindow::DrawOccludedAs::INVISIBLE) {
+                    edges->l.RemoveTagged();
                 }
-            } else if(SS.GW.drawOccludedAs == GraphicsWindow::DrawOccludedAs::INVISIBLE) {
-                edges.l.RemoveTagged();
+
+                // the occlusion test splits unnecessarily; so fix those
+                edges->MergeCollinearSegments(se->a, se->b);
             }
+        });
 
-            // the occlusion test splits unnecessarily; so fix those
-            edges.MergeCollinearSegments(se->a, se->b);
-            cnt++;
-            // And add the results to our output
+        // And add the results to our output
+        for(SEdgeList &edges : results) {
             SEdge *sen;
             for(sen = edges.l.First(); sen; sen = edges.l.NextAfter(sen)) {
                 hlrd.AddEdge(sen->a, sen->b, sen->auxA);
@@ -432,6 +444,17 @@ void SolveSpaceUI::ExportLinesAndMesh(SEdgeList *sel, SBezierList *sbl, SMesh *s
             edges.Clear();
         }
 
+        int64_t hlrMillis = GetMilliseconds() - startMillis;
+        if(hlrMillis > 30) {
+            SKdNode::Stats stats = root->GetStats();
+            dbp("Hidden line removal took %lld ms; kd-tree has %d nodes, "
+                "depth %d, %.1f triangles per leaf (at most %d), each in "
+                "%.2f leaves", hlrMillis, stats.nodes, stats.maxDepth,
+                (double)stats.references / max(1, stats.leaves - stats.emptyLeaves),
+                stats.maxLeafSize,
+                (double)stats.references / max(1, stats.triangles));
+        }
+
         sel = &hlrd;
     }
 
@@ -790,6 +813,41 @@ void VectorFileWriter::BezierAsNonrationalCubic(SBezier *sb, int depth) {
     }
 }
 
+//-----------------------------------------------------------------------------
+// Write n records to a file, formatting them in parallel. Large meshes spend
+// most of their export time formatting numbers, so chunks of records are
+// formatted into separate buffers concurrently, and then written in order;
+// a batch at a time, so that memory use stays bounded.
+//-----------------------------------------------------------------------------
+namespace {
+void WriteRecords(FILE *f, size_t n,
+                  const std::function<void(std::string *, size_t)> &format) {
+    const size_t CHUNK = 4096;
+    const size_t BATCH = 64;
+    size_t chunks = (n + CHUNK - 1) / CHUNK;
+
+    std::vector<std::string> buffers(min(chunks, BATCH));
+    for(size_t first = 0; first < chunks; first += BATCH) {
+        size_t count = min(BATCH, chunks - first);
+        ParallelFor(count, [&](size_t c) {
+            std::string *buf = &buffers[c];
+            buf->clear();
+            size_t end = min((first + c + 1) * CHUNK, n);
+            for(size_t i = (first + c) * CHUNK; i < end; i++) {
+                format(buf, i);
+            }
+        });
+        for(size_t c = 0; c < count; c++) {
+            fwrite(buffers[c].data(), 1, buffers[c].size(), f);
+        }
+    }
+}
+
+void AppendFloat(std::string *dest, float w) {
+    dest->append((const char *)&w, sizeof(w));
+}
+}
+
 //-----------------------------------------------------------------------------
 // Export a triangle mesh, in the requested format.
 //-----------------------------------------------------------------------------
@@ -812,6 +870,18 @@ void SolveSpaceUI::ExportMeshTo(const Platform::Path &filename) {
         return;
     }
     ShowNakedEdges(/*reportOnlyWhenNotOkay=*/true);
+
+    // If asked to, simplify the mesh down to a triangle budget or an error
+    // bound; faces and sharp edges are kept, so this is still a valid solid.
+    // The mesh is still in mm here, and so is the error bound.
+    SMesh decimated = {};
+    if(exportDecimateTriangles > 0 || exportDecimateError > 0.0) {
+        double maxError = (exportDecimateError > 0.0) ? exportDecimateError : VERY_POSITIVE;
+        m->MakeDecimatedInto(&decimated, (size_t)max(exportDecimateTriangles, 0),
+                             maxError);
+        m = &decimated;
+    }
+
     if(filename.HasExtension("stl")) {
         ExportMeshAsStlTo(f, m);
     } else if(filename.HasExtension("obj")) {
@@ -819,6 +889,7 @@ void SolveSpaceUI::ExportMeshTo(const Platform::Path &filename) {
         FILE *fMtl = OpenFile(mtlFilename, "wb");
         if(!fMtl) {
             Error("Couldn't write to '%s'", filename.raw.c_str());
+            decimated.Clear();
             return;
         }
 
@@ -830,12 +901,16 @@ void SolveSpaceUI::ExportMeshTo(const Platform::Path &filename) {
               filename.HasExtension("html")) {
         SOutlineList *e = &(SK.GetGroup(SS.GW.activeGroup)->displayOutlines);
         ExportMeshAsThreeJsTo(f, filename, m, e);
+    } else if(filename.HasExtension("glb")) {
+        SOutlineList *e = &(SK.GetGroup(SS.GW.activeGroup)->displayOutlines);
+        ExportMeshAsGltfTo(f, m, e);
     } else {
         Error("Can't identify output file type from file extension of "
-              "filename '%s'; try .stl, .obj, .js, .html.", filename.raw.c_str());
+              "filename '%s'; try .stl, .obj, .js, .html, .glb.", filename.raw.c_str());
     }
 
     fclose(f);
+    decimated.Clear();
 
     SS.justExportedInfo.showOrigin = false;
     SS.justExportedInfo.draw = true;
@@ -855,26 +930,23 @@ void SolveSpaceUI::ExportMeshAsStlTo(FILE *f, SMesh *sm) {
     fwrite(&n, 4, 1, f);
 
     double s = SS.exportScale;
-    int i;
-    for(i = 0; i < sm->l.n; i++) {
+    WriteRecords(f, sm->l.n, [&](std::string *buf, size_t i) {
         STriangle *tr = &(sm->l.elem[i]);
         Vector n = tr->Normal().WithMagnitude(1);
-        float w;
-        w = (float)n.x;           fwrite(&w, 4, 1, f);
-        w = (float)n.y;           fwrite(&w, 4, 1, f);
-        w = (float)n.z;           fwrite(&w, 4, 1, f);
-        w = (float)((tr->a.x)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->a.y)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->a.z)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->b.x)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->b.y)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->b.z)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->c.x)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->c.y)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->c.z)/s); fwrite(&w, 4, 1, f);
-        fputc(0, f);
-        fputc(0, f);
-    }
+        AppendFloat(buf, (float)n.x);
+        AppendFloat(buf, (float)n.y);
+        AppendFloat(buf, (float)n.z);
+        AppendFloat(buf, (float)((tr->a.x)/s));
+        AppendFloat(buf, (float)((tr->a.y)/s));
+        AppendFloat(buf, (float)((tr->a.z)/s));
+        AppendFloat(buf, (float)((tr->b.x)/s));
+        AppendFloat(buf, (float)((tr->b.y)/s));
+        AppendFloat(buf, (float)((tr->b.z)/s));
+        AppendFloat(buf, (float)((tr->c.x)/s));
+        AppendFloat(buf, (float)((tr->c.y)/s));
+        AppendFloat(buf, (float)((tr->c.z)/s));
+        buf->append(2, '\0');
+    });
 }
 
 //-----------------------------------------------------------------------------
@@ -882,9 +954,12 @@ void SolveSpaceUI::ExportMeshAsStlTo(FILE *f, SMesh *sm) {
 // identical vertices to the same identifier, so do that first.
 //-----------------------------------------------------------------------------
 void SolveSpaceUI::ExportMeshAsObjTo(FILE *fObj, FILE *fMtl, SMesh *sm) {
+    SIndexedTriMesh im = {};
+    im.MakeFromMesh(sm);
+
     std::map<RgbaColor, std::string, RgbaColorCompare> colors;
-    for(const STriangle &t : sm->l) {
-        RgbaColor color = t.meta.color;
+    for(const STriMeta &meta : im.meta) {
+        RgbaColor color = meta.color;
         if(colors.find(color) == colors.end()) {
             std::string id = ssprintf("h%02x%02x%02x",
                                       color.red,
@@ -892,11 +967,17 @@ void SolveSpaceUI::ExportMeshAsObjTo(FILE *fObj, FILE *fMtl, SMesh *sm) {
                                       color.blue);
             colors.emplace(color, id);
         }
-        for(int i = 0; i < 3; i++) {
-            fprintf(fObj, "v %.10f %.10f %.10f\n",
-                    CO(t.vertices[i].ScaledBy(1 / SS.exportScale)));
-        }
     }
+    WriteRecords(fObj, im.vertex.size(), [&](std::string *buf, size_t i) {
+        Vector v = im.vertex[i].ScaledBy(1 / SS.exportScale);
+        *buf += "v ";
+        FormatFixedInto(buf, v.x, 10);
+        *buf += ' ';
+        FormatFixedInto(buf, v.y, 10);
+        *buf += ' ';
+        FormatFixedInto(buf, v.z, 10);
+        *buf += '\n';
+    });
 
     for(auto &it : colors) {
         fprintf(fMtl, "newmtl %s\n",
@@ -905,27 +986,36 @@ void SolveSpaceUI::ExportMeshAsObjTo(FILE *fObj, FILE *fMtl, SMesh *sm) {
                 it.first.redF(), it.first.greenF(), it.first.blueF());
     }
 
-    for(const STriangle &t : sm->l) {
-        for(int i = 0; i < 3; i++) {
-            Vector n = t.normals[i].WithMagnitude(1.0);
-            fprintf(fObj, "vn %.10f %.10f %.10f\n",
-                    CO(n));
+    WriteRecords(fObj, im.normal.size(), [&](std::string *buf, size_t i) {
+        Vector n = im.normal[i].WithMagnitude(1.0);
+        *buf += "vn ";
+        FormatFixedInto(buf, n.x, 10);
+        *buf += ' ';
+        FormatFixedInto(buf, n.y, 10);
+        *buf += ' ';
+        FormatFixedInto(buf, n.z, 10);
+        *buf += '\n';
+    });
+
+    // The material changes whenever the color differs from the previous
+    // triangle's, which we can tell without any state shared between chunks.
+    WriteRecords(fObj, im.TriangleCount(), [&](std::string *buf, size_t i) {
+        RgbaColor previousColor = (i > 0) ? im.meta[i - 1].color : RgbaColor {};
+        if(!previousColor.Equals(im.meta[i].color)) {
+            *buf += "usemtl ";
+            *buf += colors.at(im.meta[i].color);
+            *buf += '\n';
         }
-    }
 
-    RgbaColor currentColor = {};
-    for(int i = 0; i < sm->l.n; i++) {
-        const STriangle &t = sm->l.elem[i];
-        if(!currentColor.Equals(t.meta.color)) {
-            currentColor = t.meta.color;
-            fprintf(fObj, "usemtl %s\n", colors[currentColor].c_str());
+        *buf += 'f';
+        for(size_t k = 0; k < 3; k++) {
+            *buf += ' ';
+            FormatUnsignedInto(buf, im.index[3*i + k] + 1);
+            *buf += "//";
+            FormatUnsignedInto(buf, im.normalIndex[3*i + k] + 1);
         }
-
-        fprintf(fObj, "f %d//%d %d//%d %d//%d\n",
-                i * 3 + 1, i * 3 + 1,
-                i * 3 + 2, i * 3 + 2,
-                i * 3 + 3, i * 3 + 3);
-    }
+        *buf += '\n';
+    });
 }
 
 //-----------------------------------------------------------------------------
@@ -934,8 +1024,6 @@ void SolveSpaceUI::ExportMeshAsObjTo(FILE *fObj, FILE *fMtl, SMesh *sm) {
 void SolveSpaceUI::ExportMeshAsThreeJsTo(FILE *f, const Platform::Path &filename,
                                          SMesh *sm, SOutlineList *sol)
 {
-    SPointList spl = {};
-    STriangle *tr;
     Vector bndl, bndh;
     const char htmlbegin[] = R"(
 <!DOCTYPE html>
@@ -1030,62 +1118,86 @@ void SolveSpaceUI::ExportMeshAsThreeJsTo(FILE *f, const Platform::Path &filename
     fprintf(f, "    ],\n"
                "    a: %f\n", SS.ambientIntensity);
 
-    for(tr = sm->l.First(); tr; tr = sm->l.NextAfter(tr)) {
-        spl.IncrementTagFor(tr->a);
-        spl.IncrementTagFor(tr->b);
-        spl.IncrementTagFor(tr->c);
-    }
+    SIndexedTriMesh im = {};
+    im.MakeFromMesh(sm);
 
     // Output all the vertices.
-    SPoint *sp;
     fputs("  },\n"
           "  points: [\n", f);
-    for(sp = spl.l.First(); sp; sp = spl.l.NextAfter(sp)) {
-        fprintf(f, "    [%f, %f, %f],\n",
-                sp->p.x / SS.exportScale,
-                sp->p.y / SS.exportScale,
-                sp->p.z / SS.exportScale);
-    }
+    WriteRecords(f, im.vertex.size(), [&](std::string *buf, size_t i) {
+        const Vector &v = im.vertex[i];
+        *buf += "    [";
+        FormatFixedInto(buf, v.x / SS.exportScale, 6);
+        *buf += ", ";
+        FormatFixedInto(buf, v.y / SS.exportScale, 6);
+        *buf += ", ";
+        FormatFixedInto(buf, v.z / SS.exportScale, 6);
+        *buf += "],\n";
+    });
 
     fputs("  ],\n"
           "  faces: [\n", f);
     // And now all the triangular faces, in terms of those vertices.
     // This time we count from zero.
-    for(tr = sm->l.First(); tr; tr = sm->l.NextAfter(tr)) {
-        fprintf(f, "    [%d, %d, %d],\n",
-                spl.IndexForPoint(tr->a),
-                spl.IndexForPoint(tr->b),
-                spl.IndexForPoint(tr->c));
-    }
+    WriteRecords(f, im.TriangleCount(), [&](std::string *buf, size_t i) {
+        *buf += "    [";
+        FormatUnsignedInto(buf, im.index[3*i + 0]);
+        *buf += ", ";
+        FormatUnsignedInto(buf, im.index[3*i + 1]);
+        *buf += ", ";
+        FormatUnsignedInto(buf, im.index[3*i + 2]);
+        *buf += "],\n";
+    });
 
     // Output face normals.
     fputs("  ],\n"
           "  normals: [\n", f);
-    for(tr = sm->l.First(); tr; tr = sm->l.NextAfter(tr)) {
-        fprintf(f, "    [[%f, %f, %f], [%f, %f, %f], [%f, %f, %f]],\n",
-                CO(tr->an), CO(tr->bn), CO(tr->cn));
-    }
+    WriteRecords(f, sm->l.n, [&](std::string *buf, size_t i) {
+        const STriangle &tr = sm->l.elem[i];
+        const Vector *normals[3] = { &tr.an, &tr.bn, &tr.cn };
+        *buf += "    [";
+        for(size_t k = 0; k < 3; k++) {
+            if(k > 0) *buf += ", ";
+            *buf += '[';
+            FormatFixedInto(buf, normals[k]->x, 6);
+            *buf += ", ";
+            FormatFixedInto(buf, normals[k]->y, 6);
+            *buf += ", ";
+            FormatFixedInto(buf, normals[k]->z, 6);
+            *buf += ']';
+        }
+        *buf += "],\n";
+    });
 
     fputs("  ],\n"
           "  colors: [\n", f);
     // Output triangle colors.
-    for(tr = sm->l.First(); tr; tr = sm->l.NextAfter(tr)) {
-        fprintf(f, "    0x%x,\n", tr->meta.color.ToARGB32());
-    }
+    WriteRecords(f, sm->l.n, [&](std::string *buf, size_t i) {
+        char str[32];
+        snprintf(str, sizeof(str), "    0x%x,\n", sm->l.elem[i].meta.color.ToARGB32());
+        *buf += str;
+    });
 
     fputs("  ],\n"
           "  edges: [\n", f);
     // Output edges. Assume user's model colors do not obscure white edges.
-    for(const SOutline &so : sol->l) {
-        if(so.tag == 0) continue;
-        fprintf(f, "    [[%f, %f, %f], [%f, %f, %f]],\n",
-                so.a.x / SS.exportScale,
-                so.a.y / SS.exportScale,
-                so.a.z / SS.exportScale,
-                so.b.x / SS.exportScale,
-                so.b.y / SS.exportScale,
-                so.b.z / SS.exportScale);
-    }
+    WriteRecords(f, sol->l.n, [&](std::string *buf, size_t i) {
+        const SOutline &so = sol->l.elem[i];
+        if(so.tag == 0) return;
+        *buf += "    [[";
+        FormatFixedInto(buf, so.a.x / SS.exportScale, 6);
+        *buf += ", ";
+        FormatFixedInto(buf, so.a.y / SS.exportScale, 6);
+        *buf += ", ";
+        FormatFixedInto(buf, so.a.z / SS.exportScale, 6);
+        *buf += "], [";
+        FormatFixedInto(buf, so.b.x / SS.exportScale, 6);
+        *buf += ", ";
+        FormatFixedInto(buf, so.b.y / SS.exportScale, 6);
+        *buf += ", ";
+        FormatFixedInto(buf, so.b.z / SS.exportScale, 6);
+        *buf += "]],\n";
+    });
 
     fputs("  ]\n};\n", f);
 
@@ -1097,8 +1209,178 @@ void SolveSpaceUI::ExportMeshAsThreeJsTo(FILE *f, const Platform::Path &filename
                 CO(SS.GW.projUp),
                 CO(SS.GW.projRight));
     }
+}
 
-    spl.Clear();
+//-----------------------------------------------------------------------------
+// Export the mesh as binary glTF. Vertices are shared between triangles that
+// have the same position and normal, and there's one indexed primitive per
+// color, plus one primitive with the outlines as lines, if there are any.
+// The JSON only describes the layout of the binary buffer, so it's written
+// up front, and then the buffer follows in one go.
+//-----------------------------------------------------------------------------
+void SolveSpaceUI::ExportMeshAsGltfTo(FILE *f, SMesh *sm, SOutlineList *sol) {
+    // A mesh without primitives isn't valid glTF.
+    if(sm->IsEmpty()) {
+        Error(_("Active group mesh is empty; nothing to export."));
+        return;
+    }
+
+    SIndexedTriMesh im = {};
+    im.MakeFromMesh(sm);
+
+    // A glTF vertex is a position together with its normal, so weld the
+    // (position, normal) pairs of the indexed mesh.
+    std::unordered_map<uint64_t, uint32_t> vertexOf;
+    std::vector<float> position, normal;
+    std::vector<uint32_t> vertexIndex(im.index.size());
+    for(size_t i = 0; i < im.index.size(); i++) {
+        uint64_t key = ((uint64_t)im.index[i] << 32) | im.normalIndex[i];
+        auto it = vertexOf.find(key);
+        if(it == vertexOf.end()) {
+            it = vertexOf.emplace(key, (uint32_t)(position.size() / 3)).first;
+            Vector p = im.vertex[im.index[i]].ScaledBy(1 / SS.exportScale);
+            Vector n = im.normal[im.normalIndex[i]].WithMagnitude(1.0);
+            position.insert(position.end(), { (float)p.x, (float)p.y, (float)p.z });
+            normal.insert(normal.end(), { (float)n.x, (float)n.y, (float)n.z });
+        }
+        vertexIndex[i] = it->second;
+    }
+
+    // One primitive per color, in order of first appearance; bucket the
+    // triangles so that each primitive's indices are contiguous.
+    std::vector<RgbaColor> colors;
+    std::map<RgbaColor, size_t, RgbaColorCompare> primitiveOf;
+    std::vector<size_t> primitive(im.TriangleCount());
+    for(size_t i = 0; i < im.TriangleCount(); i++) {
+        auto it = primitiveOf.find(im.meta[i].color);
+        if(it == primitiveOf.end()) {
+            it = primitiveOf.emplace(im.meta[i].color, colors.size()).first;
+            colors.push_back(im.meta[i].color);
+        }
+        primitive[i] = it->second;
+    }
+    std::vector<size_t> first(colors.size() + 1, 0);
+    for(size_t p : primitive) first[p + 1] += 3;
+    for(size_t p = 0; p < colors.size(); p++) first[p + 1] += first[p];
+    std::vector<uint32_t> index(im.index.size());
+    std::vector<size_t> next(first.begin(), first.end() - 1);
+    for(size_t i = 0; i < im.TriangleCount(); i++) {
+        for(size_t k = 0; k < 3; k++) {
+            index[next[primitive[i]]++] = vertexIndex[3*i + k];
+        }
+    }
+
+    std::vector<float> outline;
+    for(const SOutline &so : sol->l) {
+        if(so.tag == 0) continue;
+        Vector a = so.a.ScaledBy(1 / SS.exportScale),
+               b = so.b.ScaledBy(1 / SS.exportScale);
+        outline.insert(outline.end(), { (float)a.x, (float)a.y, (float)a.z,
+                                        (float)b.x, (float)b.y, (float)b.z });
+    }
+
+    auto boundsOf = [](const std::vector<float> &v) {
+        float lo[3] = { VERY_POSITIVE, VERY_POSITIVE, VERY_POSITIVE },
+              hi[3] = { VERY_NEGATIVE, VERY_NEGATIVE, VERY_NEGATIVE };
+        for(size_t i = 0; i < v.size(); i++) {
+            lo[i % 3] = min(lo[i % 3], v[i]);
+            hi[i % 3] = max(hi[i % 3], v[i]);
+        }
+        return ssprintf("\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]",
+                        lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]);
+    };
+    // glTF colors are linear, ours are sRGB.
+    auto linear = [](float c) {
+        return (c <= 0.04045f) ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+    };
+
+    uint32_t positionBytes = (uint32_t)(position.size() * sizeof(float)),
+             indexBytes    = (uint32_t)(index.size() * sizeof(uint32_t)),
+             outlineBytes  = (uint32_t)(outline.size() * sizeof(float));
+    uint32_t vertexCount   = (uint32_t)(position.size() / 3);
+
+    std::string primitives, materials, accessors, bufferViews;
+    auto add = [](std::string *list, const std::string &item) {
+        if(!list->empty()) *list += ",";
+        *list += item;
+    };
+    add(&accessors, ssprintf(
+        "{\"bufferView\":0,\"componentType\":5126,\"count\":%u,\"type\":\"VEC3\",%s}",
+        vertexCount, boundsOf(position).c_str()));
+    add(&accessors, ssprintf(
+        "{\"bufferView\":1,\"componentType\":5126,\"count\":%u,\"type\":\"VEC3\"}",
+        vertexCount));
+    for(uint32_t p = 0; p < colors.size(); p++) {
+        RgbaColor color = colors[p];
+        add(&primitives, ssprintf(
+            "{\"attributes\":{\"POSITION\":0,\"NORMAL\":1},\"indices\":%u,\"material\":%u}",
+            p + 2, p));
+        add(&materials, ssprintf(
+            "{\"pbrMetallicRoughness\":{\"baseColorFactor\":[%.6g,%.6g,%.6g,%.6g],"
+            "\"metallicFactor\":0,\"roughnessFactor\":0.5}%s}",
+            linear(color.redF()), linear(color.greenF()), linear(color.blueF()),
+            color.alphaF(), (color.alpha < 255) ? ",\"alphaMode\":\"BLEND\"" : ""));
+        add(&accessors, ssprintf(
+            "{\"bufferView\":2,\"byteOffset\":%u,\"componentType\":5125,"
+            "\"count\":%u,\"type\":\"SCALAR\"}",
+            (uint32_t)(first[p] * sizeof(uint32_t)), (uint32_t)(first[p + 1] - first[p])));
+    }
+    add(&bufferViews, ssprintf(
+        "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%u,\"target\":34962}",
+        positionBytes));
+    add(&bufferViews, ssprintf(
+        "{\"buffer\":0,\"byteOffset\":%u,\"byteLength\":%u,\"target\":34962}",
+        positionBytes, positionBytes));
+    add(&bufferViews, ssprintf(
+        "{\"buffer\":0,\"byteOffset\":%u,\"byteLength\":%u,\"target\":34963}",
+        2 * positionBytes, indexBytes));
+    if(!outline.empty()) {
+        add(&primitives, ssprintf(
+            "{\"attributes\":{\"POSITION\":%u},\"mode\":1,\"material\":%u}",
+            (uint32_t)colors.size() + 2, (uint32_t)colors.size()));
+        add(&materials, "{\"pbrMetallicRoughness\":{\"baseColorFactor\":[0,0,0,1],"
+                        "\"metallicFactor\":0}}");
+        add(&accessors, ssprintf(
+            "{\"bufferView\":3,\"componentType\":5126,\"count\":%u,\"type\":\"VEC3\",%s}",
+            (uint32_t)(outline.size() / 3), boundsOf(outline).c_str()));
+        add(&bufferViews, ssprintf(
+            "{\"buffer\":0,\"byteOffset\":%u,\"byteLength\":%u,\"target\":34962}",
+            2 * positionBytes + indexBytes, outlineBytes));
+    }
+
+    // Coordinates are in export units; glTF is in meters.
+    double scale = SS.exportScale / 1000.0;
+    uint32_t binBytes = 2 * positionBytes + indexBytes + outlineBytes;
+    std::string json = ssprintf(
+        "{\"asset\":{\"version\":\"2.0\",\"generator\":\"SolveSpace\"},"
+        "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+        "\"nodes\":[{\"mesh\":0,\"scale\":[%.9g,%.9g,%.9g]}],"
+        "\"meshes\":[{\"primitives\":[%s]}],"
+        "\"materials\":[%s],"
+        "\"accessors\":[%s],"
+        "\"bufferViews\":[%s],"
+        "\"buffers\":[{\"byteLength\":%u}]}",
+        scale, scale, scale, primitives.c_str(), materials.c_str(),
+        accessors.c_str(), bufferViews.c_str(), binBytes);
+    // Chunks must be 4-byte aligned; the JSON is padded with spaces, and the
+    // binary buffer is made of 4-byte values already.
+    json.append((4 - json.size() % 4) % 4, ' ');
+
+    uint32_t header[3] = {
+        0x46546C67, // "glTF"
+        2,
+        (uint32_t)(12 + 8 + json.size() + 8 + binBytes)
+    };
+    uint32_t jsonChunk[2] = { (uint32_t)json.size(), 0x4E4F534A }; // "JSON"
+    uint32_t binChunk[2]  = { binBytes,                0x004E4942 }; // "BIN"
+    fwrite(header, sizeof(header), 1, f);
+    fwrite(jsonChunk, sizeof(jsonChunk), 1, f);
+    fwrite(json.data(), 1, json.size(), f);
+    fwrite(binChunk, sizeof(binChunk), 1, f);
+    fwrite(position.data(), 1, positionBytes, f);
+    fwrite(normal.data(), 1, positionBytes, f);
+    fwrite(index.data(), 1, indexBytes, f);
+    fwrite(outline.data(), 1, outlineBytes, f);
 }
 
 //-----------------------------------------------------------------------------
@@ -6,7 +6,14 @@
 #include "solvespace.h"
 
 void StepFileWriter::WriteHeader() {
-    fprintf(f,
+    out.clear();
+    pointIds.clear();
+    vertices.clear();
+    vertexGrid = {};
+    vertexGrid.size = 4*LENGTH_EPS;
+    edges.clear();
+
+    Write(
 "ISO-10303-21;\n"
 "HEADER;\n"
 "\n"
@@ -67,7 +74,7 @@ void StepFileWriter::WriteHeader() {
     id = 200;
 }
 void StepFileWriter::WriteProductHeader() {
-	fprintf(f,
+	Write(
 		"#175 = SHAPE_DEFINITION_REPRESENTATION(#176, #169);\n"
 		"#176 = PRODUCT_DEFINITION_SHAPE('Version', 'Test Part', #177);\n"
 		"#177 = PRODUCT_DEFINITION('Version', 'Test Part', #182, #178);\n"
@@ -81,38 +88,147 @@ void StepFileWriter::WriteProductHeader() {
 		"\n"
 		);
 }
+
+//-----------------------------------------------------------------------------
+// The output is collected in a buffer and written out in large pieces, and
+// the numbers are formatted without going through printf.
+//-----------------------------------------------------------------------------
+void StepFileWriter::Write(const char *str) {
+    out += str;
+}
+
+void StepFileWriter::Printf(const char *fmt, ...) {
+    char buf[256];
+    va_list va;
+    va_start(va, fmt);
+    int size = vsnprintf(buf, sizeof(buf), fmt, va);
+    va_end(va);
+    ssassert(size >= 0, "vsnprintf could not encode string");
+    if((size_t)size < sizeof(buf)) {
+        out.append(buf, size);
+    } else {
+        std::string str;
+        str.resize(size + 1);
+        va_start(va, fmt);
+        vsnprintf(&str[0], size + 1, fmt, va);
+        va_end(va);
+        out.append(str, 0, size);
+    }
+}
+
+void StepFileWriter::WriteId(int v) {
+    out += '#';
+    FormatUnsignedInto(&out, (uint64_t)v);
+}
+
+void StepFileWriter::WriteNumber(double v) {
+    FormatFixedInto(&out, v, 10);
+}
+
+void StepFileWriter::Flush() {
+    fwrite(out.data(), 1, out.size(), f);
+    out.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Points and vertices are each written only once, however many faces share
+// them. Control points are looked up by their exact coordinates; but each
+// face computes the ends of its edges on its own, so vertices are merged
+// when they're equal to within the usual tolerance.
+//-----------------------------------------------------------------------------
+int StepFileWriter::ExportPoint(Vector p) {
+    std::string key((const char *)&p, sizeof(p));
+    auto it = pointIds.find(key);
+    if(it != pointIds.end()) return it->second;
+
+    int ret = id++;
+    WriteId(ret);
+    Write("=CARTESIAN_POINT('',(");
+    WriteNumber(p.x);
+    Write(",");
+    WriteNumber(p.y);
+    Write(",");
+    WriteNumber(p.z);
+    Write("));\n");
+    pointIds[key] = ret;
+    return ret;
+}
+
+int StepFileWriter::ExportVertex(Vector p) {
+    Vector r = Vector::From(LENGTH_EPS, LENGTH_EPS, LENGTH_EPS);
+    std::vector<int> near;
+    vertexGrid.FindInBox(p.Minus(r), p.Plus(r), &near);
+    for(int i : near) {
+        if(vertices[i].p.Equals(p)) return vertices[i].id;
+    }
+
+    int pt = ExportPoint(p);
+    int ret = id++;
+    WriteId(ret);
+    Write("=VERTEX_POINT('',");
+    WriteId(pt);
+    Write(");\n");
+    vertexGrid.Add(p, (int)vertices.size());
+    vertices.push_back({ p, ret });
+    return ret;
+}
+
 int StepFileWriter::ExportCurve(SBezier *sb) {
-    int i, ret = id;
+    int i;
+
+    int pts[4];
+    for(i = 0; i <= sb->deg; i++) {
+        pts[i] = ExportPoint(sb->ctrl[i]);
+    }
 
-    fprintf(f, "#%d=(\n", ret);
-    fprintf(f, "BOUNDED_CURVE()\n");
-    fprintf(f, "B_SPLINE_CURVE(%d,(", sb->deg);
+    int ret = id++;
+    Printf("#%d=(\n", ret);
+    Write("BOUNDED_CURVE()\n");
+    Printf("B_SPLINE_CURVE(%d,(", sb->deg);
     for(i = 0; i <= sb->deg; i++) {
-        fprintf(f, "#%d", ret + i + 1);
-        if(i != sb->deg) fprintf(f, ",");
+        WriteId(pts[i]);
+        if(i != sb->deg) Write(",");
     }
-    fprintf(f, "),.UNSPECIFIED.,.F.,.F.)\n");
-    fprintf(f, "B_SPLINE_CURVE_WITH_KNOTS((%d,%d),",
+    Write("),.UNSPECIFIED.,.F.,.F.)\n");
+    Printf("B_SPLINE_CURVE_WITH_KNOTS((%d,%d),",
         (sb->deg + 1), (sb-> deg + 1));
-    fprintf(f, "(0.000,1.000),.UNSPECIFIED.)\n");
-    fprintf(f, "CURVE()\n");
-    fprintf(f, "GEOMETRIC_REPRESENTATION_ITEM()\n");
-    fprintf(f, "RATIONAL_B_SPLINE_CURVE((");
+    Write("(0.000,1.000),.UNSPECIFIED.)\n");
+    Write("CURVE()\n");
+    Write("GEOMETRIC_REPRESENTATION_ITEM()\n");
+    Write("RATIONAL_B_SPLINE_CURVE((");
     for(i = 0; i <= sb->deg; i++) {
-        fprintf(f, "%.10f", sb->weight[i]);
-        if(i != sb->deg) fprintf(f, ",");
+        WriteNumber(sb->weight[i]);
+        if(i != sb->deg) Write(",");
     }
-    fprintf(f, "))\n");
-    fprintf(f, "REPRESENTATION_ITEM('')\n);\n");
+    Write("))\n");
+    Write("REPRESENTATION_ITEM('')\n);\n");
+    Write("\n");
 
-    for(i = 0; i <= sb->deg; i++) {
-        fprintf(f, "#%d=CARTESIAN_POINT('',(%.10f,%.10f,%.10f));\n",
-            id + 1 + i,
-            CO(sb->ctrl[i]));
+    return ret;
+}
+
+// An edge between two faces is traced once by each of them, in opposite
+// directions, and the two share their vertices. So if an edge was already
+// written from our finish to our start, along the same curve reversed (to
+// within the usual tolerance, since each face splits its own copy of the
+// curve), then it's the same edge, and gets used backwards.
+int StepFileWriter::ExportEdge(SBezier *sb, int start, int finish, bool *backwards) {
+    SBezier reversed = *sb;
+    reversed.Reverse();
+    auto range = edges.equal_range(EdgeKey(finish, start));
+    for(auto it = range.first; it != range.second; ++it) {
+        if(it->second.curve.Equals(&reversed)) {
+            *backwards = true;
+            return it->second.id;
+        }
     }
-    fprintf(f, "\n");
 
-    id = ret + 1 + (sb->deg + 1);
+    int curveId = ExportCurve(sb);
+    int ret = id++;
+    Printf("#%d=EDGE_CURVE('',#%d,#%d,#%d,%s);\n",
+        ret, start, finish, curveId, ".T.");
+    edges.emplace(EdgeKey(start, finish), WrittenEdge { *sb, ret });
+    *backwards = false;
     return ret;
 }
 
@@ -126,48 +242,38 @@ int StepFileWriter::ExportCurveLoop(SBezierLoop *loop, bool inner) {
     // Generate "exactly closed" contours, with the same vertex id for the
     // finish of a previous edge and the start of the next one. So we need
     // the finish of the last Bezier in the loop before we start our process.
-    fprintf(f, "#%d=CARTESIAN_POINT('',(%.10f,%.10f,%.10f));\n",
-        id, CO(sb->Finish()));
-    fprintf(f, "#%d=VERTEX_POINT('',#%d);\n", id+1, id);
-    int lastFinish = id + 1, prevFinish = lastFinish;
-    id += 2;
+    int lastFinish = ExportVertex(sb->Finish()), prevFinish = lastFinish;
 
     for(sb = loop->l.First(); sb; sb = loop->l.NextAfter(sb)) {
-        int curveId = ExportCurve(sb);
-
         int thisFinish;
         if(loop->l.NextAfter(sb) != NULL) {
-            fprintf(f, "#%d=CARTESIAN_POINT('',(%.10f,%.10f,%.10f));\n",
-                id, CO(sb->Finish()));
-            fprintf(f, "#%d=VERTEX_POINT('',#%d);\n", id+1, id);
-            thisFinish = id + 1;
-            id += 2;
+            thisFinish = ExportVertex(sb->Finish());
         } else {
             thisFinish = lastFinish;
         }
 
-        fprintf(f, "#%d=EDGE_CURVE('',#%d,#%d,#%d,%s);\n",
-            id, prevFinish, thisFinish, curveId, ".T.");
-        fprintf(f, "#%d=ORIENTED_EDGE('',*,*,#%d,.T.);\n",
-            id+1, id);
-
-        int oe = id+1;
+        bool backwards;
+        int edgeId = ExportEdge(sb, prevFinish, thisFinish, &backwards);
+        int oe = id++;
+        WriteId(oe);
+        Write("=ORIENTED_EDGE('',*,*,");
+        WriteId(edgeId);
+        Write(backwards ? ",.F.);\n" : ",.T.);\n");
         listOfTrims.Add(&oe);
-        id += 2;
 
         prevFinish = thisFinish;
     }
 
-    fprintf(f, "#%d=EDGE_LOOP('',(", id);
+    Printf("#%d=EDGE_LOOP('',(", id);
     int *oe;
     for(oe = listOfTrims.First(); oe; oe = listOfTrims.NextAfter(oe)) {
-        fprintf(f, "#%d", *oe);
-        if(listOfTrims.NextAfter(oe) != NULL) fprintf(f, ",");
+        WriteId(*oe);
+        if(listOfTrims.NextAfter(oe) != NULL) Write(",");
     }
-    fprintf(f, "));\n");
+    Write("));\n");
 
     int fb = id + 1;
-        fprintf(f, "#%d=%s('',#%d,.T.);\n",
+        Printf("#%d=%s('',#%d,.T.);\n",
             fb, inner ? "FACE_BOUND" : "FACE_OUTER_BOUND", id);
 
     id += 2;
@@ -176,77 +282,59 @@ int StepFileWriter::ExportCurveLoop(SBezierLoop *loop, bool inner) {
     return fb;
 }
 
-void StepFileWriter::ExportSurface(SSurface *ss, SBezierList *sbl) {
-    int i, j, srfid = id;
+void StepFileWriter::ExportSurface(SSurface *ss, SBezierLoopSetSet *sblss) {
+    int i, j;
 
-    // First, we create the untrimmed surface. We always specify a rational
-    // B-spline surface (in fact, just a Bezier surface).
-    fprintf(f, "#%d=(\n", srfid);
-    fprintf(f, "BOUNDED_SURFACE()\n");
-    fprintf(f, "B_SPLINE_SURFACE(%d,%d,(", ss->degm, ss->degn);
+    // The control points for the untrimmed surface.
+    std::vector<int> pts;
     for(i = 0; i <= ss->degm; i++) {
-        fprintf(f, "(");
         for(j = 0; j <= ss->degn; j++) {
-            fprintf(f, "#%d", srfid + 1 + j + i*(ss->degn + 1));
-            if(j != ss->degn) fprintf(f, ",");
+            pts.push_back(ExportPoint(ss->ctrl[i][j]));
         }
-        fprintf(f, ")");
-        if(i != ss->degm) fprintf(f, ",");
     }
-    fprintf(f, "),.UNSPECIFIED.,.F.,.F.,.F.)\n");
-    fprintf(f, "B_SPLINE_SURFACE_WITH_KNOTS((%d,%d),(%d,%d),",
-        (ss->degm + 1), (ss->degm + 1),
-        (ss->degn + 1), (ss->degn + 1));
-    fprintf(f, "(0.000,1.000),(0.000,1.000),.UNSPECIFIED.)\n");
-    fprintf(f, "GEOMETRIC_REPRESENTATION_ITEM()\n");
-    fprintf(f, "RATIONAL_B_SPLINE_SURFACE((");
+
+    // First, we create the untrimmed surface. We always specify a rational
+    // B-spline surface (in fact, just a Bezier surface).
+    int srfid = id++;
+    Printf("#%d=(\n", srfid);
+    Write("BOUNDED_SURFACE()\n");
+    Printf("B_SPLINE_SURFACE(%d,%d,(", ss->degm, ss->degn);
     for(i = 0; i <= ss->degm; i++) {
-        fprintf(f, "(");
+        Write("(");
         for(j = 0; j <= ss->degn; j++) {
-            fprintf(f, "%.10f", ss->weight[i][j]);
-            if(j != ss->degn) fprintf(f, ",");
+            WriteId(pts[j + i*(ss->degn + 1)]);
+            if(j != ss->degn) Write(",");
         }
-        fprintf(f, ")");
-        if(i != ss->degm) fprintf(f, ",");
+        Write(")");
+        if(i != ss->degm) Write(",");
     }
-    fprintf(f, "))\n");
-    fprintf(f, "REPRESENTATION_ITEM('')\n");
-    fprintf(f, "SURFACE()\n");
-    fprintf(f, ");\n");
-
-    // The control points for the untrimmed surface.
+    Write("),.UNSPECIFIED.,.F.,.F.,.F.)\n");
+    Printf("B_SPLINE_SURFACE_WITH_KNOTS((%d,%d),(%d,%d),",
+        (ss->degm + 1), (ss->degm + 1),
+        (ss->degn + 1), (ss->degn + 1));
+    Write("(0.000,1.000),(0.000,1.000),.UNSPECIFIED.)\n");
+    Write("GEOMETRIC_REPRESENTATION_ITEM()\n");
+    Write("RATIONAL_B_SPLINE_SURFACE((");
     for(i = 0; i <= ss->degm; i++) {
+        Write("(");
         for(j = 0; j <= ss->degn; j++) {
-            fprintf(f, "#%d=CARTESIAN_POINT('',(%.10f,%.10f,%.10f));\n",
-                srfid + 1 + j + i*(ss->degn + 1),
-                CO(ss->ctrl[i][j]));
+            WriteNumber(ss->weight[i][j]);
+            if(j != ss->degn) Write(",");
         }
+        Write(")");
+        if(i != ss->degm) Write(",");
     }
-    fprintf(f, "\n");
-
-    id = srfid + 1 + (ss->degm + 1)*(ss->degn + 1);
-
-    // Now we do the trim curves. We must group each outer loop separately
-    // along with its inner faces, so do that now.
-    SBezierLoopSetSet sblss = {};
-    SPolygon spxyz = {};
-    bool allClosed;
-    SEdge notClosedAt;
-    // We specify a surface, so it doesn't check for coplanarity; and we
-    // don't want it to give us any open contours. The polygon and chord
-    // tolerance are required, because they are used to calculate the
-    // contour directions and determine inner vs. outer contours.
-    sblss.FindOuterFacesFrom(sbl, &spxyz, ss,
-                             SS.ExportChordTolMm(),
-                             &allClosed, &notClosedAt,
-                             NULL, NULL,
-                             NULL);
+    Write("))\n");
+    Write("REPRESENTATION_ITEM('')\n");
+    Write("SURFACE()\n");
+    Write(");\n");
+    Write("\n");
 
     // So in our list of SBezierLoopSet, each set contains at least one loop
     // (the outer boundary), plus any inner loops associated with that outer
     // loop.
     SBezierLoopSet *sbls;
-    for(sbls = sblss.l.First(); sbls; sbls = sblss.l.NextAfter(sbls)) {
+    for(sbls = sblss->l.First(); sbls; sbls = sblss->l.NextAfter(sbls)) {
         SBezierLoop *loop = sbls->l.First();
 
         List<int> listOfLoops = {};
@@ -265,31 +353,30 @@ void StepFileWriter::ExportSurface(SSurface *ss, SBezierList *sbl) {
         // And now create the face that corresponds to this outer loop
         // and all of its holes.
         int advFaceId = id;
-        fprintf(f, "#%d=ADVANCED_FACE('',(", advFaceId);
+        Printf("#%d=ADVANCED_FACE('',(", advFaceId);
         int *fb;
         for(fb = listOfLoops.First(); fb; fb = listOfLoops.NextAfter(fb)) {
-            fprintf(f, "#%d", *fb);
-            if(listOfLoops.NextAfter(fb) != NULL) fprintf(f, ",");
+            WriteId(*fb);
+            if(listOfLoops.NextAfter(fb) != NULL) Write(",");
         }
 
-        fprintf(f, "),#%d,.T.);\n", srfid);
-        fprintf(f, "\n");
+        Printf("),#%d,.T.);\n", srfid);
+        Write("\n");
         advancedFaces.Add(&advFaceId);
 
         id++;
         listOfLoops.Clear();
     }
-    sblss.Clear();
-    spxyz.Clear();
 }
 
 void StepFileWriter::WriteFooter() {
-    fprintf(f,
+    Write(
 "\n"
 "ENDSEC;\n"
 "\n"
 "END-ISO-10303-21;\n"
         );
+    Flush();
 }
 
 void StepFileWriter::ExportSurfacesTo(const Platform::Path &filename) {
@@ -316,36 +403,83 @@ void StepFileWriter::ExportSurfacesTo(const Platform::Path &filename) {
 
     advancedFaces = {};
 
-    SSurface *ss;
-    for(ss = shell->surface.First(); ss; ss = shell->surface.NextAfter(ss)) {
-        if(ss->trim.n == 0) continue;
+    std::vector<SSurface *> surfaces;
+    for(SSurface &ss : shell->surface) {
+        if(ss.trim.n == 0) continue;
+        surfaces.push_back(&ss);
+    }
 
-        // Get all of the loops of Beziers that trim our surface (with each
-        // Bezier split so that we use the section as t goes from 0 to 1), and
-        // the piecewise linearization of those loops in xyz space.
-        SBezierList sbl = {};
-        ss->MakeSectionEdgesInto(shell, NULL, &sbl);
+    // Get all of the loops of Beziers that trim our surfaces (with each
+    // Bezier split so that we use the section as t goes from 0 to 1). The
+    // approximate trims project into the neighbouring surfaces, so these must
+    // all be found before any surface gets scaled below; and the samples for
+    // those projections must be made first, since the surfaces are shared
+    // between threads.
+    for(SSurface &ss : shell->surface) {
+        ss.MakeSamples();
+    }
+    std::vector<SBezierList> sbls(surfaces.size());
+    ParallelFor(surfaces.size(), [&](size_t i) {
+        sbls[i] = {};
+        surfaces[i]->MakeSectionEdgesInto(shell, NULL, &sbls[i]);
+    });
+
+    // Then assemble those into the outer loops of each face, each along with
+    // its inner loops; that's the expensive part, and each surface is done
+    // on its own, so that's in parallel too.
+    std::vector<SBezierLoopSetSet> sblsss(surfaces.size());
+    ParallelFor(surfaces.size(), [&](size_t i) {
+        SSurface *ss = surfaces[i];
+        SBezierList *sbl = &sbls[i];
 
         // Apply the export scale factor.
         ss->ScaleSelfBy(1.0/SS.exportScale);
-        sbl.ScaleSelfBy(1.0/SS.exportScale);
-
-        ExportSurface(ss, &sbl);
-
-        sbl.Clear();
+        sbl->ScaleSelfBy(1.0/SS.exportScale);
+
+        SBezierLoopSetSet *sblss = &sblsss[i];
+        *sblss = {};
+        SPolygon spxyz = {};
+        bool allClosed;
+        SEdge notClosedAt;
+        // We specify a surface, so it doesn't check for coplanarity; and we
+        // don't want it to give us any open contours. The polygon and chord
+        // tolerance are required, because they are used to calculate the
+        // contour directions and determine inner vs. outer contours.
+        sblss->FindOuterFacesFrom(sbl, &spxyz, ss,
+                                  SS.ExportChordTolMm(),
+                                  &allClosed, &notClosedAt,
+                                  NULL, NULL,
+                                  NULL);
+        spxyz.Clear();
+    });
+
+    // And write them out in order, so that the ids don't depend on the
+    // scheduling; sizing the tables for that up front.
+    size_t sections = 0;
+    for(const SBezierList &sbl : sbls) {
+        sections += sbl.l.n;
+    }
+    pointIds.reserve(sections * 4);
+    vertices.reserve(sections);
+    edges.reserve(sections);
+    for(size_t i = 0; i < surfaces.size(); i++) {
+        ExportSurface(surfaces[i], &sblsss[i]);
+        sblsss[i].Clear();
+        sbls[i].Clear();
+        if(out.size() > 1024*1024) Flush();
     }
 
-    fprintf(f, "#%d=CLOSED_SHELL('',(", id);
+    Printf("#%d=CLOSED_SHELL('',(", id);
     int *af;
     for(af = advancedFaces.First(); af; af = advancedFaces.NextAfter(af)) {
-        fprintf(f, "#%d", *af);
-        if(advancedFaces.NextAfter(af) != NULL) fprintf(f, ",");
+        WriteId(*af);
+        if(advancedFaces.NextAfter(af) != NULL) Write(",");
     }
-    fprintf(f, "));\n");
-    fprintf(f, "#%d=MANIFOLD_SOLID_BREP('brep',#%d);\n", id+1, id);
-    fprintf(f, "#%d=ADVANCED_BREP_SHAPE_REPRESENTATION('',(#%d,#170),#168);\n",
+    Write("));\n");
+    Printf("#%d=MANIFOLD_SOLID_BREP('brep',#%d);\n", id+1, id);
+    Printf("#%d=ADVANCED_BREP_SHAPE_REPRESENTATION('',(#%d,#170),#168);\n",
         id+2, id+1);
-    fprintf(f, "#%d=SHAPE_REPRESENTATION_RELATIONSHIP($,$,#169,#%d);\n",
+    Printf("#%d=SHAPE_REPRESENTATION_RELATIONSHIP($,$,#169,#%d);\n",
         id+3, id+2);
 
     WriteFooter();
@@ -355,19 +489,18 @@ void StepFileWriter::ExportSurfacesTo(const Platform::Path &filename) {
 }
 
 void StepFileWriter::WriteWireframe() {
-    fprintf(f, "#%d=GEOMETRIC_CURVE_SET('curves',(", id);
+    Printf("#%d=GEOMETRIC_CURVE_SET('curves',(", id);
     int *c;
     for(c = curves.First(); c; c = curves.NextAfter(c)) {
-        fprintf(f, "#%d", *c);
-        if(curves.NextAfter(c) != NULL) fprintf(f, ",");
+        WriteId(*c);
+        if(curves.NextAfter(c) != NULL) Write(",");
     }
-    fprintf(f, "));\n");
-    fprintf(f, "#%d=GEOMETRICALLY_BOUNDED_WIREFRAME_SHAPE_REPRESENTATION"
-                    "('',(#%d,#170),#168);\n", id+1, id);
-    fprintf(f, "#%d=SHAPE_REPRESENTATION_RELATIONSHIP($,$,#169,#%d);\n",
+    Write("));\n");
+    Printf("#%d=GEOMETRICALLY_BOUNDED_WIREFRAME_SHAPE_REPRESENTATION"
+                "('',(#%d,#170),#168);\n", id+1, id);
+    Printf("#%d=SHAPE_REPRESENTATION_RELATIONSHIP($,$,#169,#%d);\n",
         id+2, id+1);
 
     id += 3;
     curves.Clear();
 }
-
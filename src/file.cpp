@@ -19,6 +19,7 @@ static int StrStartsWith(const char *str, const char *start) {
 void SolveSpaceUI::ClearExisting() {
     UndoClearStack(&redo);
     UndoClearStack(&undo);
+    UndoClearState(&undoLast);
 
     for(int i = 0; i < SK.groupOrder.n; i++) {
         Group *g = SK.GetGroup(SK.groupOrder.elem[i]);
@@ -34,6 +35,12 @@ void SolveSpaceUI::ClearExisting() {
     SK.entity.Clear();
     SK.param.Clear();
     images.clear();
+    SSurface::ClearTriangulationCache();
+
+    regenCache.hash.clear();
+    regenCache.shell.Clear();
+    regenCache.mesh.Clear();
+    regenCache.group = {};
 }
 
 hGroup SolveSpaceUI::CreateDefaultDrawingGroup() {
@@ -116,6 +123,7 @@ const SolveSpaceUI::SaveTable SolveSpaceUI::SAVED[] = {
     { 'g',  "Group.allowRedundant",     'b',    &(SS.sv.g.allowRedundant)     },
     { 'g',  "Group.allDimsReference",   'b',    &(SS.sv.g.allDimsReference)   },
     { 'g',  "Group.scale",              'f',    &(SS.sv.g.scale)              },
+    { 'g',  "Group.linkMeshOnly",       'd',    &(SS.sv.g.linkMeshOnly)       },
     { 'g',  "Group.remap",              'M',    &(SS.sv.g.remap)              },
     { 'g',  "Group.impFile",            'i',    NULL                          },
     { 'g',  "Group.impFileRel",         'P',    &(SS.sv.g.linkFile)           },
@@ -223,13 +231,25 @@ struct SAVEDptr {
     uint32_t  &x() { return *((uint32_t *)this); }
 };
 
+// The field that a table entry points to within SS.sv, but within another
+// set of save variables; so that files can be loaded on several threads.
+static SAVEDptr *SavedField(const SolveSpaceUI::SaveTable &st, SolveSpaceUI::SaveVars *vars) {
+    if(st.ptr == NULL) return NULL;
+    return (SAVEDptr *)((char *)vars + ((char *)st.ptr - (char *)&SS.sv));
+}
+
 void SolveSpaceUI::SaveUsingTable(const Platform::Path &filename, int type) {
+    SaveUsingTable(fh, filename, type, &sv);
+}
+
+void SolveSpaceUI::SaveUsingTable(FILE *fh, const Platform::Path &filename, int type,
+                                  SaveVars *vars) {
     int i;
     for(i = 0; SAVED[i].type != 0; i++) {
         if(SAVED[i].type != type) continue;
 
         int fmt = SAVED[i].fmt;
-        SAVEDptr *p = (SAVEDptr *)SAVED[i].ptr;
+        SAVEDptr *p = SavedField(SAVED[i], vars);
         // Any items that aren't specified are assumed to be zero
         if(fmt == 'S' && p->S().empty())          continue;
         if(fmt == 'P' && p->P().IsEmpty())        continue;
@@ -276,6 +296,258 @@ void SolveSpaceUI::SaveUsingTable(const Platform::Path &filename, int type) {
     }
 }
 
+//-----------------------------------------------------------------------------
+// Hashing everything that goes into generating each group, so that a shell
+// and mesh saved along with the sketch can stand in for regenerating them,
+// for as long as the hashes still match.
+//-----------------------------------------------------------------------------
+namespace {
+class InputHash {
+public:
+    uint64_t value;
+
+    void Bytes(const void *data, size_t length) {
+        const uint8_t *p = (const uint8_t *)data;
+        for(size_t i = 0; i < length; i++) {
+            value = (value ^ p[i]) * 0x100000001b3ULL;
+        }
+    }
+    void Int(uint32_t v)           { Bytes(&v, sizeof(v)); }
+    void Double(double v)          { Bytes(&v, sizeof(v)); }
+    void Point(Vector v)           { Double(v.x); Double(v.y); Double(v.z); }
+    void String(const char *str)   { Bytes(str, strlen(str) + 1); }
+
+    void Mesh(SMesh &m) {
+        for(STriangle &tr : m.l) {
+            Int(tr.meta.face);
+            Int(tr.meta.color.ToPackedInt());
+            Point(tr.a);
+            Point(tr.b);
+            Point(tr.c);
+        }
+    }
+    void Shell(SShell &sh) {
+        for(SSurface &srf : sh.surface) {
+            Int(srf.h.v);
+            Int(srf.color.ToPackedInt());
+            Int(srf.face);
+            Int(srf.degm);
+            Int(srf.degn);
+            for(int i = 0; i <= srf.degm; i++) {
+                for(int j = 0; j <= srf.degn; j++) {
+                    Point(srf.ctrl[i][j]);
+                    Double(srf.weight[i][j]);
+                }
+            }
+            for(STrimBy &stb : srf.trim) {
+                Int(stb.curve.v);
+                Int(stb.backwards);
+                Point(stb.start);
+                Point(stb.finish);
+            }
+        }
+        for(SCurve &sc : sh.curve) {
+            Int(sc.h.v);
+            Int(sc.isExact);
+            Int(sc.surfA.v);
+            Int(sc.surfB.v);
+            if(sc.isExact) {
+                for(int i = 0; i <= sc.exact.deg; i++) {
+                    Point(sc.exact.ctrl[i]);
+                    Double(sc.exact.weight[i]);
+                }
+            }
+            for(SCurvePt &scpt : sc.pts) {
+                Int(scpt.vertex);
+                Point(scpt.p);
+            }
+        }
+    }
+};
+}
+
+uint64_t SolveSpaceUI::HashUsingTable(int type, uint64_t hash) {
+    InputHash h = { hash };
+    for(int i = 0; SAVED[i].type != 0; i++) {
+        if(SAVED[i].type != type) continue;
+
+        // Skip exactly what SaveUsingTable() would, and take paths from the
+        // linked files' contents instead, since they're written relative.
+        int fmt = SAVED[i].fmt;
+        SAVEDptr *p = (SAVEDptr *)SAVED[i].ptr;
+        if(fmt == 'S' && p->S().empty())          continue;
+        if(fmt == 'd' && p->d() == 0)             continue;
+        if(fmt == 'f' && EXACT(p->f() == 0.0))    continue;
+        if(fmt == 'x' && p->x() == 0)             continue;
+        if(fmt == 'i' || fmt == 'P')              continue;
+
+        h.String(SAVED[i].desc);
+        switch(fmt) {
+            case 'S': h.String(p->S().c_str());         break;
+            case 'b': h.Int(p->b() ? 1 : 0);            break;
+            case 'c': h.Int(p->c().ToPackedInt());      break;
+            case 'd': h.Int((uint32_t)p->d());          break;
+            case 'x': h.Int(p->x());                    break;
+
+            // Hash the value as it reads back from the file, so that this
+            // is the same before saving and after loading.
+            case 'f': h.Double(strtod(ssprintf("%.20f", p->f()).c_str(), NULL)); break;
+
+            case 'M':
+                for(EntityMap &em : p->M()) {
+                    h.Int(em.h.v);
+                    h.Int(em.input.v);
+                    h.Int((uint32_t)em.copyNumber);
+                }
+                break;
+
+            default: ssassert(false, "Unexpected value format");
+        }
+    }
+    return h.value;
+}
+
+// Whether two items of the given type, laid out like the one in SS.sv, have
+// the same saved fields; exactly so, since this decides what undo can share.
+bool SolveSpaceUI::SameUsingTable(int type, const void *a, const void *b) {
+    const void *base;
+    switch(type) {
+        case 'g': base = &sv.g; break;
+        case 'p': base = &sv.p; break;
+        case 'r': base = &sv.r; break;
+        case 'e': base = &sv.e; break;
+        case 'c': base = &sv.c; break;
+        case 's': base = &sv.s; break;
+        default: ssassert(false, "Unexpected table type");
+    }
+
+    for(int i = 0; SAVED[i].type != 0; i++) {
+        if(SAVED[i].type != type || SAVED[i].fmt == 'i') continue;
+
+        ptrdiff_t offset = (const char *)SAVED[i].ptr - (const char *)base;
+        SAVEDptr *pa = (SAVEDptr *)((const char *)a + offset);
+        SAVEDptr *pb = (SAVEDptr *)((const char *)b + offset);
+        switch(SAVED[i].fmt) {
+            case 'S': if(pa->S() != pb->S()) return false;                   break;
+            case 'P': if(pa->P().raw != pb->P().raw) return false;           break;
+            case 'b': if(pa->b() != pb->b()) return false;                   break;
+            case 'c': if(!pa->c().Equals(pb->c())) return false;             break;
+            case 'd': if(pa->d() != pb->d()) return false;                   break;
+            case 'x': if(pa->x() != pb->x()) return false;                   break;
+            case 'f':
+                if(memcmp(&pa->f(), &pb->f(), sizeof(double)) != 0) return false;
+                break;
+
+            case 'M': {
+                IdList<EntityMap,EntityId> &ma = pa->M(), &mb = pb->M();
+                if(ma.n != mb.n) return false;
+                for(int j = 0; j < ma.n; j++) {
+                    const EntityMap &ea = ma.elem[ma.iti[j].i],
+                                    &eb = mb.elem[mb.iti[j].i];
+                    if(ea.h.v != eb.h.v || ea.input.v != eb.input.v ||
+                       ea.copyNumber != eb.copyNumber) return false;
+                }
+                break;
+            }
+
+            default: ssassert(false, "Unexpected value format");
+        }
+    }
+    return true;
+}
+
+void SolveSpaceUI::CalculateRegenHashes(std::vector<std::pair<hGroup, uint64_t>> *hash) {
+    std::vector<Group *> order;
+    for(Group &g : SK.group) {
+        order.push_back(&g);
+    }
+    std::sort(order.begin(), order.end(),
+        [](const Group *a, const Group *b) { return a->order < b->order; });
+
+    // The group that each param belongs to, through its request, its
+    // constraint, or directly.
+    std::vector<hGroup> paramGroup(SK.param.n);
+    for(int i = 0; i < SK.param.n; i++) {
+        hParam hp = SK.param.elem[SK.param.iti[i].i].h;
+        if(hp.v & 0x80000000) {
+            paramGroup[i].v = (hp.v >> 16) & 0x7fff;
+        } else if(hp.v & 0x40000000) {
+            hConstraint hc;
+            hc.v = hp.v & ~0x40000000u;
+            Constraint *c = SK.constraint.FindByIdNoOops(hc);
+            if(c) paramGroup[i] = c->group;
+        } else {
+            Request *r = SK.request.FindByIdNoOops(hp.request());
+            if(r) paramGroup[i] = r->group;
+        }
+    }
+
+    // Each group's hash covers all of the groups before it, and the
+    // tolerances that the geometry gets generated with.
+    InputHash h = { 0xcbf29ce484222325ULL };
+    h.Int(1);
+    h.Double(chordTol);
+    h.Int((uint32_t)maxSegments);
+
+    // Text depends on what's in the font file, not just on its name; read
+    // each font that's used once.
+    std::map<std::string, uint64_t> fontHash;
+    auto hashFont = [&](const std::string &font) {
+        auto it = fontHash.find(font);
+        if(it == fontHash.end()) {
+            InputHash fh = { 0xcbf29ce484222325ULL };
+            TtfFont *tf = fonts.LoadFont(font);
+            std::string data;
+            if(tf != NULL && ReadFile(tf->fontFile, &data)) {
+                fh.Bytes(data.data(), data.size());
+            }
+            it = fontHash.emplace(font, fh.value).first;
+        }
+        return it->second;
+    };
+
+    hash->clear();
+    for(Group *g : order) {
+        sv.g = *g;
+        h.value = HashUsingTable('g', h.value);
+
+        for(int i = 0; i < SK.request.n; i++) {
+            Request *r = &SK.request.elem[SK.request.iti[i].i];
+            if(r->group.v != g->h.v) continue;
+            sv.r = *r;
+            h.value = HashUsingTable('r', h.value);
+            if(r->type == Request::Type::TTF_TEXT) {
+                uint64_t fv = hashFont(r->font);
+                h.Bytes(&fv, sizeof(fv));
+            }
+        }
+        for(int i = 0; i < SK.constraint.n; i++) {
+            Constraint *c = &SK.constraint.elem[SK.constraint.iti[i].i];
+            if(c->group.v != g->h.v) continue;
+            sv.c = *c;
+            // Reference dimensions only measure, and get remeasured on load.
+            if(sv.c.reference) sv.c.valA = 0.0;
+            h.value = HashUsingTable('c', h.value);
+        }
+        for(int i = 0; i < SK.param.n; i++) {
+            if(paramGroup[i].v != g->h.v) continue;
+            sv.p = SK.param.elem[SK.param.iti[i].i];
+            h.value = HashUsingTable('p', h.value);
+        }
+
+        if(g->type == Group::Type::LINKED) {
+            for(Entity &e : g->impEntity) {
+                sv.e = e;
+                h.value = HashUsingTable('e', h.value);
+            }
+            h.Mesh(g->impMesh);
+            h.Shell(g->impShell);
+        }
+
+        hash->emplace_back(g->h, h.value);
+    }
+}
+
 bool SolveSpaceUI::SaveToFile(const Platform::Path &filename) {
     // Make sure all the entities are regenerated up to date, since they will be exported.
     SS.ScheduleShowTW();
@@ -296,6 +568,14 @@ bool SolveSpaceUI::SaveToFile(const Platform::Path &filename) {
         Error("Couldn't write to file '%s'", filename.raw.c_str());
         return false;
     }
+    // It might be linked, and saved again within the same second.
+    ForgetLinkedFile(filename);
+
+    if(filename.HasExtension("slvsb")) {
+        SaveBinaryTo(filename);
+        fclose(fh);
+        return true;
+    }
 
     fprintf(fh, "%s\n\n\n", VERSION_STRING);
 
@@ -340,6 +620,17 @@ bool SolveSpaceUI::SaveToFile(const Platform::Path &filename) {
         }
     }
 
+    if(saveRegenCache) {
+        // Record what went into each group, so that the geometry below can
+        // stand in for regenerating it when this file is loaded again.
+        std::vector<std::pair<hGroup, uint64_t>> hash;
+        CalculateRegenHashes(&hash);
+        for(const auto &gh : hash) {
+            fprintf(fh, "GroupHash %08x %08x %08x\n", gh.first.v,
+                (uint32_t)(gh.second >> 32), (uint32_t)gh.second);
+        }
+    }
+
     // A group will have either a mesh or a shell, but not both; but the code
     // to print either of those just does nothing if the mesh/shell is empty.
 
@@ -403,72 +694,443 @@ bool SolveSpaceUI::SaveToFile(const Platform::Path &filename) {
     return true;
 }
 
-void SolveSpaceUI::LoadUsingTable(const Platform::Path &filename, char *key, char *val) {
-    int i;
-    for(i = 0; SAVED[i].type != 0; i++) {
-        if(strcmp(SAVED[i].desc, key)==0) {
-            SAVEDptr *p = (SAVEDptr *)SAVED[i].ptr;
-            unsigned int u = 0;
-            switch(SAVED[i].fmt) {
-                case 'S': p->S() = val;                     break;
-                case 'b': p->b() = (atoi(val) != 0);        break;
-                case 'd': p->d() = atoi(val);               break;
-                case 'f': p->f() = atof(val);               break;
-                case 'x': sscanf(val, "%x", &u); p->x()= u; break;
+//-----------------------------------------------------------------------------
+// Write the sketch as recorded in an undo state, without the entities, mesh
+// and shell, which are all regenerated on load anyway. This touches nothing
+// but the state, so it can run on another thread; it writes to a temporary
+// file first and then renames that over the file, so that a crash halfway
+// through never leaves a truncated file behind.
+//-----------------------------------------------------------------------------
+bool SolveSpaceUI::SaveStateTo(const UndoState &ut, const Platform::Path &filename) {
+    Platform::Path tempFile = Platform::Path::From(filename.raw + ".tmp");
+    FILE *fh = OpenFile(tempFile, "wb");
+    if(!fh) return false;
 
-                case 'P': {
-                    Platform::Path path = Platform::Path::FromPortable(val);
-                    if(!path.IsEmpty()) {
-                        p->P() = filename.Parent().Join(path).Expand();
-                    }
-                    break;
-                }
+    fprintf(fh, "%s\n\n\n", VERSION_STRING);
 
-                case 'c':
-                    sscanf(val, "%x", &u);
-                    p->c() = RgbaColor::FromPackedInt(u);
-                    break;
+    std::unique_ptr<SaveVars> vars(new SaveVars());
+    for(size_t i = 0; i < ut.group.size(); i++) {
+        vars->g = *ut.group[i];
+        vars->g.remap = *ut.remap[i];
+        SaveUsingTable(fh, filename, 'g', vars.get());
+        fprintf(fh, "AddGroup\n\n");
+    }
+    for(const std::shared_ptr<const Param> &p : ut.param) {
+        vars->p = *p;
+        SaveUsingTable(fh, filename, 'p', vars.get());
+        fprintf(fh, "AddParam\n\n");
+    }
+    for(const std::shared_ptr<const Request> &r : ut.request) {
+        vars->r = *r;
+        SaveUsingTable(fh, filename, 'r', vars.get());
+        fprintf(fh, "AddRequest\n\n");
+    }
+    for(const std::shared_ptr<const Constraint> &c : ut.constraint) {
+        vars->c = *c;
+        SaveUsingTable(fh, filename, 'c', vars.get());
+        fprintf(fh, "AddConstraint\n\n");
+    }
+    for(const std::shared_ptr<const Style> &s : ut.style) {
+        if(s->h.v < Style::FIRST_CUSTOM) continue;
+        vars->s = *s;
+        SaveUsingTable(fh, filename, 's', vars.get());
+        fprintf(fh, "AddStyle\n\n");
+    }
+    // The remap was only borrowed from the state.
+    vars->g.remap = {};
 
-                case 'M': {
-                    // Don't clear this list! When the group gets added, it
-                    // makes a shallow copy, so that would result in us
-                    // freeing memory that we want to keep around. Just
-                    // zero it out so that new memory is allocated.
-                    p->M() = {};
-                    for(;;) {
-                        EntityMap em;
-                        char line2[1024];
-                        if (fgets(line2, (int)sizeof(line2), fh) == NULL)
-                            break;
-                        if(sscanf(line2, "%d %x %d", &(em.h.v), &(em.input.v),
-                                                     &(em.copyNumber)) == 3)
-                        {
-                            p->M().Add(&em);
-                        } else {
-                            break;
-                        }
-                    }
-                    break;
-                }
+    bool ok = !ferror(fh);
+    if(fclose(fh) != 0) ok = false;
+    if(!ok || !RenameFile(tempFile, filename)) {
+        RemoveFile(tempFile);
+        return false;
+    }
+    return true;
+}
 
-                case 'i': break;
+//-----------------------------------------------------------------------------
+// Reading files line by line, and parsing fields out of those lines, without
+// copying anything; the fields follow the conventions of scanf.
+//-----------------------------------------------------------------------------
+bool SolveSpaceUI::LoadCursor::NextLine() {
+    if(next >= end) return false;
+
+    line = next;
+    const char *newline = (const char *)memchr(line, '\n', end - line);
+    lineEnd = newline ? newline : end;
+    next    = newline ? newline + 1 : end;
+    // We should never get files with \r characters in them, but mailers
+    // will sometimes mangle attachments.
+    const char *cr = (const char *)memchr(line, '\r', lineEnd - line);
+    if(cr) lineEnd = cr;
+
+    field = line;
+    return true;
+}
 
-                default: ssassert(false, "Unexpected value format");
+bool SolveSpaceUI::LoadCursor::LineIs(const char *str) const {
+    size_t length = strlen(str);
+    return (size_t)(lineEnd - line) == length && memcmp(line, str, length) == 0;
+}
+
+bool SolveSpaceUI::LoadCursor::LineStartsWith(const char *str) const {
+    size_t length = strlen(str);
+    return (size_t)(lineEnd - line) >= length && memcmp(line, str, length) == 0;
+}
+
+static const char *SkipBlanks(const char *p, const char *end) {
+    while(p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+bool SolveSpaceUI::LoadCursor::Word(const char *str) {
+    const char *p = SkipBlanks(field, lineEnd);
+    size_t length = strlen(str);
+    if((size_t)(lineEnd - p) < length || memcmp(p, str, length) != 0) return false;
+    field = p + length;
+    return true;
+}
+
+bool SolveSpaceUI::LoadCursor::Int(int *v) {
+    const char *p = SkipBlanks(field, lineEnd);
+    bool negative = false;
+    if(p < lineEnd && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    if(p == lineEnd || !isdigit((unsigned char)*p)) return false;
+
+    unsigned value = 0;
+    for(; p < lineEnd && isdigit((unsigned char)*p); p++) {
+        value = value * 10 + (unsigned)(*p - '0');
+    }
+    *v = negative ? -(int)value : (int)value;
+    field = p;
+    return true;
+}
+
+bool SolveSpaceUI::LoadCursor::Hex(uint32_t *v) {
+    const char *p = SkipBlanks(field, lineEnd);
+    if(lineEnd - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') &&
+       isxdigit((unsigned char)p[2])) {
+        p += 2;
+    }
+    if(p == lineEnd || !isxdigit((unsigned char)*p)) return false;
+
+    uint32_t value = 0;
+    for(; p < lineEnd && isxdigit((unsigned char)*p); p++) {
+        unsigned char c = (unsigned char)*p;
+        int digit = isdigit(c) ? (c - '0') : (tolower(c) - 'a' + 10);
+        value = (value << 4) | (uint32_t)digit;
+    }
+    *v = value;
+    field = p;
+    return true;
+}
+
+bool SolveSpaceUI::LoadCursor::Double(double *v) {
+    // Powers of ten up to 10^27 are exact, given a 64-bit mantissa.
+    static const long double pow10[] = {
+        1e0L,  1e1L,  1e2L,  1e3L,  1e4L,  1e5L,  1e6L,  1e7L,  1e8L,  1e9L,
+        1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L,
+        1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L
+    };
+
+    const char *p = SkipBlanks(field, lineEnd);
+
+    // Numbers are written with %.20f, so take the first 19 significant
+    // digits as the mantissa, and remember whether any nonzero ones were
+    // cut off after those.
+    const char *q = p;
+    bool negative = false;
+    if(q < lineEnd && (*q == '-' || *q == '+')) {
+        negative = (*q == '-');
+        q++;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool truncated = false, anyDigits = false, inFraction = false;
+    for(; q < lineEnd; q++) {
+        if(*q == '.' && !inFraction) {
+            inFraction = true;
+            continue;
+        }
+        if(!isdigit((unsigned char)*q)) break;
+        anyDigits = true;
+        int digit = *q - '0';
+        if(digits < 19) {
+            if(digits > 0 || digit != 0) {
+                mantissa = mantissa * 10 + (uint64_t)digit;
+                digits++;
             }
-            break;
+            if(inFraction) exponent--;
+        } else {
+            if(digit != 0) truncated = true;
+            if(!inFraction) exponent++;
         }
     }
-    if(SAVED[i].type == 0) {
-        fileLoadError = true;
+    bool simple = anyDigits && !(q < lineEnd && (*q == 'e' || *q == 'E'));
+
+    if(simple && !truncated && mantissa <= ((uint64_t)1 << 53) &&
+       exponent >= -22 && exponent <= 22) {
+        // Both the mantissa and the power of ten are exact doubles, so a
+        // single multiplication or division rounds just like strtod.
+        double value = (double)mantissa, scale = (double)pow10[abs(exponent)];
+        value = (exponent < 0) ? value / scale : value * scale;
+        *v = negative ? -value : value;
+        field = q;
+        return true;
+    }
+    if(simple && exponent >= -27 && exponent <= 27) {
+        // Otherwise, the value lies between the mantissa and the next one up
+        // (if digits were cut off), scaled; compute both bounds with one
+        // rounding each, widen them by that rounding, and if everything in
+        // between rounds to the same double, then that's the answer. Where
+        // long double is no wider than double, this always falls through.
+        long double scale = pow10[abs(exponent)];
+        long double lo = (long double)mantissa,
+                    hi = (long double)(mantissa + (truncated ? 1 : 0));
+        lo = (exponent < 0) ? lo / scale : lo * scale;
+        hi = (exponent < 0) ? hi / scale : hi * scale;
+        lo = nextafterl(lo, -HUGE_VALL);
+        hi = nextafterl(hi, HUGE_VALL);
+        if((double)lo == (double)hi) {
+            double value = (double)lo;
+            *v = negative ? -value : value;
+            field = q;
+            return true;
+        }
     }
+
+    // Leave anything else to strtod; the mapping isn't null-terminated, so
+    // the field has to be copied first.
+    const char *fieldEnd = p;
+    while(fieldEnd < lineEnd && *fieldEnd != ' ' && *fieldEnd != '\t') fieldEnd++;
+    std::string str(p, fieldEnd);
+    char *parsedEnd;
+    double value = strtod(str.c_str(), &parsedEnd);
+    if(parsedEnd == str.c_str()) return false;
+    *v = value;
+    field = p + (parsedEnd - str.c_str());
+    return true;
 }
 
-bool SolveSpaceUI::LoadFromFile(const Platform::Path &filename, bool canCancel) {
-    allConsistent = false;
-    fileLoadError = false;
+//-----------------------------------------------------------------------------
+// Finding the entry of SAVED for a key, through a hash table that's built
+// the first time it's needed.
+//-----------------------------------------------------------------------------
+namespace {
+uint32_t HashKey(const char *key, size_t length) {
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+    }
+    return hash;
+}
 
-    fh = OpenFile(filename, "rb");
-    if(!fh) {
+class SaveTableIndex {
+public:
+    const SolveSpaceUI::SaveTable *table;
+    std::vector<int>               slot; // index into table, or -1 if empty
+    uint32_t                       mask;
+
+    SaveTableIndex(const SolveSpaceUI::SaveTable *table) : table(table) {
+        size_t n = 0;
+        while(table[n].type != 0) n++;
+        size_t size = 16;
+        while(size < 2 * n) size *= 2;
+        slot.assign(size, -1);
+        mask = (uint32_t)(size - 1);
+
+        for(int i = 0; table[i].type != 0; i++) {
+            const char *desc = table[i].desc;
+            // If a key is in the table twice, the first entry wins.
+            if(Find(desc, strlen(desc)) >= 0) continue;
+            uint32_t at = HashKey(desc, strlen(desc)) & mask;
+            while(slot[at] >= 0) at = (at + 1) & mask;
+            slot[at] = i;
+        }
+    }
+
+    int Find(const char *key, size_t length) const {
+        for(uint32_t at = HashKey(key, length) & mask; slot[at] >= 0;
+            at = (at + 1) & mask) {
+            const char *desc = table[slot[at]].desc;
+            if(strncmp(desc, key, length) == 0 && desc[length] == '\0') {
+                return slot[at];
+            }
+        }
+        return -1;
+    }
+};
+}
+
+bool SolveSpaceUI::LoadUsingTable(const Platform::Path &filename, LoadCursor *cursor,
+                                  const char *key, size_t keyLength, SaveVars *vars) {
+    static const SaveTableIndex index(SAVED);
+
+    int i = index.Find(key, keyLength);
+    if(i < 0) return false;
+
+    SAVEDptr *p = SavedField(SAVED[i], vars);
+    int d = 0;
+    double f = 0.0;
+    uint32_t u = 0;
+    switch(SAVED[i].fmt) {
+        case 'S': p->S() = std::string(cursor->field, cursor->lineEnd); break;
+        case 'b': cursor->Int(&d);    p->b() = (d != 0);                 break;
+        case 'd': cursor->Int(&d);    p->d() = d;                        break;
+        case 'f': cursor->Double(&f); p->f() = f;                        break;
+        case 'x': cursor->Hex(&u);    p->x() = u;                        break;
+
+        case 'P': {
+            Platform::Path path =
+                Platform::Path::FromPortable(std::string(cursor->field, cursor->lineEnd));
+            if(!path.IsEmpty()) {
+                p->P() = filename.Parent().Join(path).Expand();
+            }
+            break;
+        }
+
+        case 'c':
+            cursor->Hex(&u);
+            p->c() = RgbaColor::FromPackedInt(u);
+            break;
+
+        case 'M': {
+            // Don't clear this list! When the group gets added, it
+            // makes a shallow copy, so that would result in us
+            // freeing memory that we want to keep around. Just
+            // zero it out so that new memory is allocated.
+            p->M() = {};
+            while(cursor->NextLine()) {
+                EntityMap em;
+                int h;
+                if(cursor->Int(&h) && cursor->Hex(&(em.input.v)) &&
+                   cursor->Int(&(em.copyNumber)))
+                {
+                    em.h.v = (uint32_t)h;
+                    p->M().Add(&em);
+                } else {
+                    break;
+                }
+            }
+            break;
+        }
+
+        case 'i': break;
+
+        default: ssassert(false, "Unexpected value format");
+    }
+    return true;
+}
+
+// Read one line of a saved mesh or shell. Returns false if the line is not one
+// of those records, and clears *ok if it is, but can't be parsed.
+static bool LoadGeometryLine(SolveSpaceUI::LoadCursor *cursor, SMesh *m, SShell *sh,
+                             SSurface *srf, SCurve *crv, bool *ok) {
+    *ok = true;
+    if(cursor->Word("Triangle ")) {
+        STriangle tr = {};
+        uint32_t rgba = 0;
+        if(!(cursor->Hex(&(tr.meta.face)) && cursor->Hex(&rgba) &&
+             cursor->Double(&(tr.a.x)) && cursor->Double(&(tr.a.y)) && cursor->Double(&(tr.a.z)) &&
+             cursor->Double(&(tr.b.x)) && cursor->Double(&(tr.b.y)) && cursor->Double(&(tr.b.z)) &&
+             cursor->Double(&(tr.c.x)) && cursor->Double(&(tr.c.y)) && cursor->Double(&(tr.c.z))))
+        {
+            *ok = false;
+            return true;
+        }
+        tr.meta.color = RgbaColor::FromPackedInt(rgba);
+        m->AddTriangle(&tr);
+    } else if(cursor->Word("Surface ")) {
+        uint32_t rgba = 0;
+        if(!(cursor->Hex(&(srf->h.v)) && cursor->Hex(&rgba) && cursor->Hex(&(srf->face)) &&
+             cursor->Int(&(srf->degm)) && cursor->Int(&(srf->degn))))
+        {
+            *ok = false;
+            return true;
+        }
+        srf->color = RgbaColor::FromPackedInt(rgba);
+    } else if(cursor->Word("SCtrl ")) {
+        int i, j;
+        Vector c;
+        double w;
+        if(!(cursor->Int(&i) && cursor->Int(&j) &&
+             cursor->Double(&(c.x)) && cursor->Double(&(c.y)) && cursor->Double(&(c.z)) &&
+             cursor->Word("Weight") && cursor->Double(&w)) ||
+           i < 0 || i > 3 || j < 0 || j > 3)
+        {
+            *ok = false;
+            return true;
+        }
+        srf->ctrl[i][j] = c;
+        srf->weight[i][j] = w;
+    } else if(cursor->Word("TrimBy ")) {
+        STrimBy stb = {};
+        int backwards;
+        if(!(cursor->Hex(&(stb.curve.v)) && cursor->Int(&backwards) &&
+             cursor->Double(&(stb.start.x)) && cursor->Double(&(stb.start.y)) &&
+             cursor->Double(&(stb.start.z)) &&
+             cursor->Double(&(stb.finish.x)) && cursor->Double(&(stb.finish.y)) &&
+             cursor->Double(&(stb.finish.z))))
+        {
+            *ok = false;
+            return true;
+        }
+        stb.backwards = (backwards != 0);
+        srf->trim.Add(&stb);
+    } else if(cursor->LineIs("AddSurface")) {
+        sh->surface.Add(srf);
+        *srf = {};
+    } else if(cursor->Word("Curve ")) {
+        int isExact;
+        if(!(cursor->Hex(&(crv->h.v)) && cursor->Int(&isExact) &&
+             cursor->Int(&(crv->exact.deg)) &&
+             cursor->Hex(&(crv->surfA.v)) && cursor->Hex(&(crv->surfB.v))))
+        {
+            *ok = false;
+            return true;
+        }
+        crv->isExact = (isExact != 0);
+    } else if(cursor->Word("CCtrl ")) {
+        int i;
+        Vector c;
+        double w;
+        if(!(cursor->Int(&i) &&
+             cursor->Double(&(c.x)) && cursor->Double(&(c.y)) && cursor->Double(&(c.z)) &&
+             cursor->Word("Weight") && cursor->Double(&w)) ||
+           i < 0 || i > 3)
+        {
+            *ok = false;
+            return true;
+        }
+        crv->exact.ctrl[i] = c;
+        crv->exact.weight[i] = w;
+    } else if(cursor->Word("CurvePt ")) {
+        SCurvePt scpt;
+        int vertex;
+        if(!(cursor->Int(&vertex) &&
+             cursor->Double(&(scpt.p.x)) && cursor->Double(&(scpt.p.y)) &&
+             cursor->Double(&(scpt.p.z))))
+        {
+            *ok = false;
+            return true;
+        }
+        scpt.vertex = (vertex != 0);
+        crv->pts.Add(&scpt);
+    } else if(cursor->LineIs("AddCurve")) {
+        sh->curve.Add(crv);
+        *crv = {};
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool SolveSpaceUI::ParseFile(const Platform::Path &filename) {
+    Platform::MappedFile file = {};
+    if(!file.Map(filename)) {
         Error("Couldn't read from file '%s'", filename.raw.c_str());
         return false;
     }
@@ -479,23 +1141,29 @@ bool SolveSpaceUI::LoadFromFile(const Platform::Path &filename, bool canCancel)
     sv.g.scale = 1; // default is 1, not 0; so legacy files need this
     Style::FillDefaultStyle(&sv.s);
 
-    char line[1024];
-    while(fgets(line, (int)sizeof(line), fh)) {
-        char *s = strchr(line, '\n');
-        if(s) *s = '\0';
-        // We should never get files with \r characters in them, but mailers
-        // will sometimes mangle attachments.
-        s = strchr(line, '\r');
-        if(s) *s = '\0';
+    if(IsBinaryFile(file.data, file.size)) {
+        ParseBinary(filename, file.data, file.size);
+        file.Unmap();
+        return true;
+    }
+
+    SSurface srf = {};
+    SCurve crv = {};
+    bool ok;
 
-        if(*line == '\0') continue;
+    LoadCursor cursor = {};
+    cursor.next = file.data;
+    cursor.end  = file.data + file.size;
+    while(cursor.NextLine()) {
+        if(cursor.line == cursor.lineEnd) continue;
 
-        char *e = strchr(line, '=');
+        const char *e = (const char *)memchr(cursor.line, '=', cursor.lineEnd - cursor.line);
         if(e) {
-            *e = '\0';
-            char *key = line, *val = e+1;
-            LoadUsingTable(filename, key, val);
-        } else if(strcmp(line, "AddGroup")==0) {
+            cursor.field = e + 1;
+            if(!LoadUsingTable(filename, &cursor, cursor.line, e - cursor.line, &sv)) {
+                fileLoadError = true;
+            }
+        } else if(cursor.LineIs("AddGroup")) {
             // legacy files have a spurious dependency between linked groups
             // and their parent groups, remove
             if(sv.g.type == Group::Type::LINKED)
@@ -504,34 +1172,48 @@ bool SolveSpaceUI::LoadFromFile(const Platform::Path &filename, bool canCancel)
             SK.group.Add(&(sv.g));
             sv.g = {};
             sv.g.scale = 1; // default is 1, not 0; so legacy files need this
-        } else if(strcmp(line, "AddParam")==0) {
+        } else if(cursor.LineIs("AddParam")) {
             // params are regenerated, but we want to preload the values
             // for initial guesses
             SK.param.Add(&(sv.p));
             sv.p = {};
-        } else if(strcmp(line, "AddEntity")==0) {
+        } else if(cursor.LineIs("AddEntity")) {
             // entities are regenerated
-        } else if(strcmp(line, "AddRequest")==0) {
+        } else if(cursor.LineIs("AddRequest")) {
             SK.request.Add(&(sv.r));
             sv.r = {};
-        } else if(strcmp(line, "AddConstraint")==0) {
+        } else if(cursor.LineIs("AddConstraint")) {
             SK.constraint.Add(&(sv.c));
             sv.c = {};
-        } else if(strcmp(line, "AddStyle")==0) {
+        } else if(cursor.LineIs("AddStyle")) {
             SK.style.Add(&(sv.s));
             sv.s = {};
             Style::FillDefaultStyle(&sv.s);
-        } else if(strcmp(line, VERSION_STRING)==0) {
+        } else if(cursor.LineIs(VERSION_STRING)) {
             // do nothing, version string
-        } else if(StrStartsWith(line, "Triangle ")      ||
-                  StrStartsWith(line, "Surface ")       ||
-                  StrStartsWith(line, "SCtrl ")         ||
-                  StrStartsWith(line, "TrimBy ")        ||
-                  StrStartsWith(line, "Curve ")         ||
-                  StrStartsWith(line, "CCtrl ")         ||
-                  StrStartsWith(line, "CurvePt ")       ||
-                  strcmp(line, "AddSurface")==0         ||
-                  strcmp(line, "AddCurve")==0)
+        } else if(cursor.Word("GroupHash ")) {
+            hGroup hg;
+            uint32_t high, low;
+            if(cursor.Hex(&hg.v) && cursor.Hex(&high) && cursor.Hex(&low)) {
+                regenCache.hash.emplace_back(hg, ((uint64_t)high << 32) | low);
+            } else {
+                fileLoadError = true;
+            }
+        } else if(!regenCache.hash.empty() &&
+                  LoadGeometryLine(&cursor, &regenCache.mesh, &regenCache.shell,
+                                   &srf, &crv, &ok)) {
+            // the mesh or shell may stand in for regenerating, if the
+            // hashes of the groups still match once everything is loaded
+            if(!ok) fileLoadError = true;
+        } else if(cursor.LineStartsWith("Triangle ")      ||
+                  cursor.LineStartsWith("Surface ")       ||
+                  cursor.LineStartsWith("SCtrl ")         ||
+                  cursor.LineStartsWith("TrimBy ")        ||
+                  cursor.LineStartsWith("Curve ")         ||
+                  cursor.LineStartsWith("CCtrl ")         ||
+                  cursor.LineStartsWith("CurvePt ")       ||
+                  cursor.LineIs("AddSurface")             ||
+                  cursor.LineIs("AddCurve"))
         {
             // ignore the mesh or shell, since we regenerate that
         } else {
@@ -539,7 +1221,17 @@ bool SolveSpaceUI::LoadFromFile(const Platform::Path &filename, bool canCancel)
         }
     }
 
-    fclose(fh);
+    file.Unmap();
+    return true;
+}
+
+bool SolveSpaceUI::LoadFromFile(const Platform::Path &filename, bool canCancel) {
+    allConsistent = false;
+    fileLoadError = false;
+
+    if(!ParseFile(filename)) {
+        return false;
+    }
 
     if(fileLoadError) {
         Error(_("Unrecognized data in file. This file may be corrupt, or "
@@ -553,6 +1245,7 @@ bool SolveSpaceUI::LoadFromFile(const Platform::Path &filename, bool canCancel)
         return false;
     }
     UpgradeLegacyData();
+    ApplyRegenCache();
 
     return true;
 }
@@ -696,146 +1389,820 @@ void SolveSpaceUI::UpgradeLegacyData() {
     oldParam.Clear();
 }
 
+void SolveSpaceUI::ApplyRegenCache() {
+    if(!regenCache.hash.empty()) {
+        std::vector<std::pair<hGroup, uint64_t>> hash;
+        CalculateRegenHashes(&hash);
+
+        bool match = (hash.size() == regenCache.hash.size());
+        for(size_t i = 0; match && i < hash.size(); i++) {
+            match = (hash[i].first.v == regenCache.hash[i].first.v &&
+                     hash[i].second == regenCache.hash[i].second);
+        }
+        if(match) {
+            // The saved shell and mesh belong to the last group, and none of
+            // the groups need generating to get there.
+            for(Group &g : SK.group) {
+                g.regenCached = true;
+            }
+            Group *g = SK.GetGroup(hash.back().first);
+            g->runningShell = regenCache.shell;
+            g->runningMesh  = regenCache.mesh;
+            g->displayDirty = true;
+            regenCache.shell = {};
+            regenCache.mesh  = {};
+
+            regenCache.group       = g->h;
+            regenCache.chordTol    = chordTol;
+            regenCache.maxSegments = maxSegments;
+        }
+    }
+
+    regenCache.hash.clear();
+    regenCache.shell.Clear();
+    regenCache.mesh.Clear();
+}
+
 bool SolveSpaceUI::LoadEntitiesFromFile(const Platform::Path &filename, EntityList *le,
                                         SMesh *m, SShell *sh)
 {
     SSurface srf = {};
     SCurve crv = {};
+    bool ok;
 
-    fh = OpenFile(filename, "rb");
-    if(!fh) return false;
+    Platform::MappedFile file = {};
+    if(!file.Map(filename)) return false;
 
     le->Clear();
-    sv = {};
-
-    char line[1024];
-    while(fgets(line, (int)sizeof(line), fh)) {
-        char *s = strchr(line, '\n');
-        if(s) *s = '\0';
-        // We should never get files with \r characters in them, but mailers
-        // will sometimes mangle attachments.
-        s = strchr(line, '\r');
-        if(s) *s = '\0';
+    // Not SS.sv, since linked files get loaded concurrently.
+    std::unique_ptr<SaveVars> vars(new SaveVars());
+
+    if(IsBinaryFile(file.data, file.size)) {
+        bool loaded = LoadEntitiesFromBinary(filename, file.data, file.size, vars.get(),
+                                             le, m, sh);
+        file.Unmap();
+        return loaded;
+    }
 
-        if(*line == '\0') continue;
+    LoadCursor cursor = {};
+    cursor.next = file.data;
+    cursor.end  = file.data + file.size;
+    while(cursor.NextLine()) {
+        if(cursor.line == cursor.lineEnd) continue;
 
-        char *e = strchr(line, '=');
+        const char *e = (const char *)memchr(cursor.line, '=', cursor.lineEnd - cursor.line);
         if(e) {
-            *e = '\0';
-            char *key = line, *val = e+1;
-            LoadUsingTable(filename, key, val);
-        } else if(strcmp(line, "AddGroup")==0) {
+            cursor.field = e + 1;
+            LoadUsingTable(filename, &cursor, cursor.line, e - cursor.line, vars.get());
+        } else if(cursor.LineIs("AddGroup")) {
             // Don't leak memory; these get allocated whether we want them
             // or not.
-            sv.g.remap.Clear();
-        } else if(strcmp(line, "AddParam")==0) {
-
-        } else if(strcmp(line, "AddEntity")==0) {
-            le->Add(&(sv.e));
-            sv.e = {};
-        } else if(strcmp(line, "AddRequest")==0) {
-
-        } else if(strcmp(line, "AddConstraint")==0) {
-
-        } else if(strcmp(line, "AddStyle")==0) {
-
-        } else if(strcmp(line, VERSION_STRING)==0) {
-
-        } else if(StrStartsWith(line, "Triangle ")) {
-            STriangle tr = {};
-            unsigned int rgba = 0;
-            if(sscanf(line, "Triangle %x %x  "
-                             "%lf %lf %lf  %lf %lf %lf  %lf %lf %lf",
-                &(tr.meta.face), &rgba,
-                &(tr.a.x), &(tr.a.y), &(tr.a.z),
-                &(tr.b.x), &(tr.b.y), &(tr.b.z),
-                &(tr.c.x), &(tr.c.y), &(tr.c.z)) != 11) {
-                ssassert(false, "Unexpected Triangle format");
-            }
-            tr.meta.color = RgbaColor::FromPackedInt((uint32_t)rgba);
-            m->AddTriangle(&tr);
-        } else if(StrStartsWith(line, "Surface ")) {
-            unsigned int rgba = 0;
-            if(sscanf(line, "Surface %x %x %x %d %d",
-                &(srf.h.v), &rgba, &(srf.face),
-                &(srf.degm), &(srf.degn)) != 5) {
-                ssassert(false, "Unexpected Surface format");
-            }
-            srf.color = RgbaColor::FromPackedInt((uint32_t)rgba);
-        } else if(StrStartsWith(line, "SCtrl ")) {
-            int i, j;
-            Vector c;
-            double w;
-            if(sscanf(line, "SCtrl %d %d %lf %lf %lf Weight %lf",
-                                &i, &j, &(c.x), &(c.y), &(c.z), &w) != 6)
-            {
-                ssassert(false, "Unexpected SCtrl format");
-            }
-            srf.ctrl[i][j] = c;
-            srf.weight[i][j] = w;
-        } else if(StrStartsWith(line, "TrimBy ")) {
+            vars->g.remap.Clear();
+        } else if(cursor.LineIs("AddParam")) {
+
+        } else if(cursor.LineIs("AddEntity")) {
+            le->Add(&(vars->e));
+            vars->e = {};
+        } else if(cursor.LineIs("AddRequest")) {
+
+        } else if(cursor.LineIs("AddConstraint")) {
+
+        } else if(cursor.LineIs("AddStyle")) {
+
+        } else if(cursor.LineIs(VERSION_STRING)) {
+
+        } else if(cursor.LineStartsWith("GroupHash ")) {
+
+        } else if(LoadGeometryLine(&cursor, m, sh, &srf, &crv, &ok)) {
+            ssassert(ok, "Unexpected mesh or shell format");
+        } else ssassert(false, "Unexpected operation");
+    }
+
+    file.Unmap();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// The binary format holds the same tables as the text one, in sections that
+// each start with their tag and length, so that a reader can skip straight
+// over the ones that it doesn't need. Every table section lists the keys and
+// formats of its fields first, so that fields come and go just like in the
+// text format; the version only changes if the layout itself does.
+//-----------------------------------------------------------------------------
+#define BINARY_MAGIC "\261\262\263" "SolveSpaceBIN"
+static const uint32_t BINARY_VERSION = 1;
+
+namespace {
+class BinaryWriter {
+public:
+    std::string data;
+
+    void U8(uint8_t v)       { data.push_back((char)v); }
+    void U32(uint32_t v)     { for(int i = 0; i < 32; i += 8) U8((uint8_t)(v >> i)); }
+    void U64(uint64_t v)     { for(int i = 0; i < 64; i += 8) U8((uint8_t)(v >> i)); }
+    void Double(double v)    { uint64_t u; memcpy(&u, &v, sizeof(u)); U64(u); }
+    void Point(Vector v)     { Double(v.x); Double(v.y); Double(v.z); }
+    void String(const std::string &str) {
+        U32((uint32_t)str.size());
+        data += str;
+    }
+
+    void WriteSection(FILE *f, const char *tag) {
+        BinaryWriter header = {};
+        header.data.append(tag, 4);
+        header.U64(data.size());
+        fwrite(header.data.data(), 1, header.data.size(), f);
+        fwrite(data.data(), 1, data.size(), f);
+        data.clear();
+    }
+};
+
+class BinaryReader {
+public:
+    const uint8_t *p, *end;
+    bool ok;
+    bool unknown; // some fields were skipped, not being known
+
+    bool Have(size_t n) {
+        if((size_t)(end - p) >= n) return true;
+        ok = false;
+        p = end;
+        return false;
+    }
+    uint8_t U8() {
+        return Have(1) ? *p++ : 0;
+    }
+    uint32_t U32() {
+        if(!Have(4)) return 0;
+        uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                     ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+        p += 4;
+        return v;
+    }
+    uint64_t U64() {
+        uint64_t lo = U32();
+        return lo | ((uint64_t)U32() << 32);
+    }
+    double Double() {
+        uint64_t u = U64();
+        double v;
+        memcpy(&v, &u, sizeof(v));
+        return v;
+    }
+    Vector Point() {
+        Vector v;
+        v.x = Double();
+        v.y = Double();
+        v.z = Double();
+        return v;
+    }
+    std::string String() {
+        uint32_t n = U32();
+        if(!Have(n)) return "";
+        std::string str((const char *)p, n);
+        p += n;
+        return str;
+    }
+};
+
+// Whether a field gets written at all; these are the same as the ones that
+// SaveUsingTable() leaves out, so that both formats load the same way.
+bool IsSavedDefault(int fmt, SAVEDptr *p) {
+    switch(fmt) {
+        case 'S': return p->S().empty();
+        case 'P': return p->P().IsEmpty();
+        case 'd': return p->d() == 0;
+        case 'f': return EXACT(p->f() == 0.0);
+        case 'x': return p->x() == 0;
+        default:  return false;
+    }
+}
+
+// Write one table, with the item to write next loaded into SS.sv by the
+// callback; each record is a bitmap of the fields present, then those.
+void WriteTable(BinaryWriter *w, const Platform::Path &filename, int type, size_t count,
+                const std::function<void(size_t)> &load) {
+    std::vector<int> fields;
+    for(int i = 0; SolveSpaceUI::SAVED[i].type != 0; i++) {
+        if(SolveSpaceUI::SAVED[i].type != type || SolveSpaceUI::SAVED[i].fmt == 'i') continue;
+        fields.push_back(i);
+    }
+    w->U32((uint32_t)fields.size());
+    for(int i : fields) {
+        w->U8((uint8_t)SolveSpaceUI::SAVED[i].fmt);
+        w->String(SolveSpaceUI::SAVED[i].desc);
+    }
+
+    w->U32((uint32_t)count);
+    std::vector<uint8_t> present((fields.size() + 7) / 8);
+    for(size_t n = 0; n < count; n++) {
+        load(n);
+
+        std::fill(present.begin(), present.end(), 0);
+        for(size_t j = 0; j < fields.size(); j++) {
+            const SolveSpaceUI::SaveTable &st = SolveSpaceUI::SAVED[fields[j]];
+            if(!IsSavedDefault(st.fmt, (SAVEDptr *)st.ptr)) {
+                present[j / 8] |= (uint8_t)(1 << (j % 8));
+            }
+        }
+        for(uint8_t b : present) w->U8(b);
+
+        for(size_t j = 0; j < fields.size(); j++) {
+            if(!(present[j / 8] & (1 << (j % 8)))) continue;
+
+            const SolveSpaceUI::SaveTable &st = SolveSpaceUI::SAVED[fields[j]];
+            SAVEDptr *p = (SAVEDptr *)st.ptr;
+            switch(st.fmt) {
+                case 'S': w->String(p->S());                    break;
+                case 'b': w->U8(p->b() ? 1 : 0);                break;
+                case 'c': w->U32(p->c().ToPackedInt());         break;
+                case 'd': w->U32((uint32_t)p->d());             break;
+                case 'f': w->Double(p->f());                    break;
+                case 'x': w->U32(p->x());                       break;
+
+                case 'P': {
+                    Platform::Path relativePath = p->P().RelativeTo(filename.Parent());
+                    ssassert(!relativePath.IsEmpty(), "Cannot relativize path");
+                    w->String(relativePath.ToPortable());
+                    break;
+                }
+
+                case 'M':
+                    w->U32((uint32_t)p->M().n);
+                    for(EntityMap &em : p->M()) {
+                        w->U32(em.h.v);
+                        w->U32(em.input.v);
+                        w->U32((uint32_t)em.copyNumber);
+                    }
+                    break;
+
+                default: ssassert(false, "Unexpected value format");
+            }
+        }
+    }
+}
+
+// Read one table into vars, calling back before each record (to reset vars)
+// and after it (to add the item). Fields that we don't know are skipped.
+bool ReadTable(BinaryReader *r, const Platform::Path &filename, SolveSpaceUI::SaveVars *vars,
+               const std::function<void()> &reset, const std::function<void()> &add) {
+    static const SaveTableIndex index(SolveSpaceUI::SAVED);
+
+    struct Field {
+        int     fmt;
+        int     saved;
+    };
+    // Each field takes at least a byte, so this bounds a damaged count.
+    uint32_t count = r->U32();
+    if(!r->Have(count)) return false;
+    std::vector<Field> fields(count);
+    for(Field &field : fields) {
+        field.fmt = r->U8();
+        std::string key = r->String();
+        field.saved = index.Find(key.data(), key.size());
+        if(field.saved >= 0 && SolveSpaceUI::SAVED[field.saved].fmt != field.fmt) {
+            field.saved = -1;
+        }
+        if(field.saved < 0) r->unknown = true;
+        if(field.fmt == 0 || !strchr("SPbcdfxM", field.fmt)) return false;
+    }
+
+    count = r->U32();
+    std::vector<uint8_t> present((fields.size() + 7) / 8);
+    for(uint32_t n = 0; n < count && r->ok; n++) {
+        reset();
+        for(uint8_t &b : present) b = r->U8();
+
+        for(size_t j = 0; j < fields.size(); j++) {
+            if(!(present[j / 8] & (1 << (j % 8)))) continue;
+
+            // Read anything we don't know into a scratch value.
+            uint64_t scratch[2] = {};
+            std::string scratchString;
+            Platform::Path scratchPath;
+            IdList<EntityMap,EntityId> scratchMap = {};
+
+            SAVEDptr *p;
+            int fmt = fields[j].fmt;
+            if(fields[j].saved >= 0) {
+                p = SavedField(SolveSpaceUI::SAVED[fields[j].saved], vars);
+            } else if(fmt == 'S') {
+                p = (SAVEDptr *)&scratchString;
+            } else if(fmt == 'P') {
+                p = (SAVEDptr *)&scratchPath;
+            } else if(fmt == 'M') {
+                p = (SAVEDptr *)&scratchMap;
+            } else {
+                p = (SAVEDptr *)scratch;
+            }
+
+            switch(fmt) {
+                case 'S': p->S() = r->String();                         break;
+                case 'b': p->b() = (r->U8() != 0);                      break;
+                case 'c': p->c() = RgbaColor::FromPackedInt(r->U32());  break;
+                case 'd': p->d() = (int)r->U32();                       break;
+                case 'f': p->f() = r->Double();                         break;
+                case 'x': p->x() = r->U32();                            break;
+
+                case 'P': {
+                    Platform::Path path = Platform::Path::FromPortable(r->String());
+                    if(!path.IsEmpty()) {
+                        p->P() = filename.Parent().Join(path).Expand();
+                    }
+                    break;
+                }
+
+                case 'M': {
+                    // As with the text format, don't clear this list; the
+                    // group that gets added takes it over.
+                    p->M() = {};
+                    uint32_t entries = r->U32();
+                    for(uint32_t k = 0; k < entries && r->ok; k++) {
+                        EntityMap em;
+                        em.h.v         = r->U32();
+                        em.input.v     = r->U32();
+                        em.copyNumber  = (int)r->U32();
+                        p->M().Add(&em);
+                    }
+                    break;
+                }
+            }
+            scratchMap.Clear();
+        }
+        if(r->ok) add();
+    }
+    return r->ok;
+}
+
+void WriteMesh(BinaryWriter *w, SMesh *m) {
+    w->U32((uint32_t)m->l.n);
+    for(STriangle &tr : m->l) {
+        w->U32(tr.meta.face);
+        w->U32(tr.meta.color.ToPackedInt());
+        w->Point(tr.a);
+        w->Point(tr.b);
+        w->Point(tr.c);
+    }
+}
+
+bool ReadMesh(BinaryReader *r, SMesh *m) {
+    uint32_t count = r->U32();
+    for(uint32_t i = 0; i < count && r->ok; i++) {
+        STriangle tr = {};
+        tr.meta.face  = r->U32();
+        tr.meta.color = RgbaColor::FromPackedInt(r->U32());
+        tr.a = r->Point();
+        tr.b = r->Point();
+        tr.c = r->Point();
+        m->AddTriangle(&tr);
+    }
+    return r->ok;
+}
+
+void WriteShell(BinaryWriter *w, SShell *sh) {
+    w->U32((uint32_t)sh->surface.n);
+    for(int k = 0; k < sh->surface.n; k++) {
+        SSurface *srf = &sh->surface.elem[sh->surface.iti[k].i];
+        w->U32(srf->h.v);
+        w->U32(srf->color.ToPackedInt());
+        w->U32(srf->face);
+        w->U32((uint32_t)srf->degm);
+        w->U32((uint32_t)srf->degn);
+        for(int i = 0; i <= srf->degm; i++) {
+            for(int j = 0; j <= srf->degn; j++) {
+                w->Point(srf->ctrl[i][j]);
+                w->Double(srf->weight[i][j]);
+            }
+        }
+        w->U32((uint32_t)srf->trim.n);
+        for(STrimBy &stb : srf->trim) {
+            w->U32(stb.curve.v);
+            w->U8(stb.backwards ? 1 : 0);
+            w->Point(stb.start);
+            w->Point(stb.finish);
+        }
+    }
+
+    w->U32((uint32_t)sh->curve.n);
+    for(int k = 0; k < sh->curve.n; k++) {
+        SCurve *sc = &sh->curve.elem[sh->curve.iti[k].i];
+        w->U32(sc->h.v);
+        w->U8(sc->isExact ? 1 : 0);
+        w->U32((uint32_t)sc->exact.deg);
+        w->U32(sc->surfA.v);
+        w->U32(sc->surfB.v);
+        if(sc->isExact) {
+            for(int i = 0; i <= sc->exact.deg; i++) {
+                w->Point(sc->exact.ctrl[i]);
+                w->Double(sc->exact.weight[i]);
+            }
+        }
+        w->U32((uint32_t)sc->pts.n);
+        for(SCurvePt &scpt : sc->pts) {
+            w->U8(scpt.vertex ? 1 : 0);
+            w->Point(scpt.p);
+        }
+    }
+}
+
+bool ReadShell(BinaryReader *r, SShell *sh) {
+    uint32_t surfaces = r->U32();
+    for(uint32_t k = 0; k < surfaces && r->ok; k++) {
+        SSurface srf = {};
+        srf.h.v   = r->U32();
+        srf.color = RgbaColor::FromPackedInt(r->U32());
+        srf.face  = r->U32();
+        srf.degm  = (int)r->U32();
+        srf.degn  = (int)r->U32();
+        if(srf.degm < 0 || srf.degm > 3 || srf.degn < 0 || srf.degn > 3) return false;
+        for(int i = 0; i <= srf.degm; i++) {
+            for(int j = 0; j <= srf.degn; j++) {
+                srf.ctrl[i][j]   = r->Point();
+                srf.weight[i][j] = r->Double();
+            }
+        }
+        uint32_t trims = r->U32();
+        for(uint32_t i = 0; i < trims && r->ok; i++) {
             STrimBy stb = {};
-            int backwards;
-            if(sscanf(line, "TrimBy %x %d  %lf %lf %lf  %lf %lf %lf",
-                &(stb.curve.v), &backwards,
-                &(stb.start.x), &(stb.start.y), &(stb.start.z),
-                &(stb.finish.x), &(stb.finish.y), &(stb.finish.z)) != 8)
-            {
-                ssassert(false, "Unexpected TrimBy format");
-            }
-            stb.backwards = (backwards != 0);
+            stb.curve.v   = r->U32();
+            stb.backwards = (r->U8() != 0);
+            stb.start     = r->Point();
+            stb.finish    = r->Point();
             srf.trim.Add(&stb);
-        } else if(strcmp(line, "AddSurface")==0) {
-            sh->surface.Add(&srf);
-            srf = {};
-        } else if(StrStartsWith(line, "Curve ")) {
-            int isExact;
-            if(sscanf(line, "Curve %x %d %d %x %x",
-                &(crv.h.v),
-                &(isExact),
-                &(crv.exact.deg),
-                &(crv.surfA.v), &(crv.surfB.v)) != 5)
-            {
-                ssassert(false, "Unexpected Curve format");
-            }
-            crv.isExact = (isExact != 0);
-        } else if(StrStartsWith(line, "CCtrl ")) {
-            int i;
-            Vector c;
-            double w;
-            if(sscanf(line, "CCtrl %d %lf %lf %lf Weight %lf",
-                                &i, &(c.x), &(c.y), &(c.z), &w) != 5)
-            {
-                ssassert(false, "Unexpected CCtrl format");
-            }
-            crv.exact.ctrl[i] = c;
-            crv.exact.weight[i] = w;
-        } else if(StrStartsWith(line, "CurvePt ")) {
+        }
+        sh->surface.Add(&srf);
+    }
+
+    uint32_t curves = r->U32();
+    for(uint32_t k = 0; k < curves && r->ok; k++) {
+        SCurve crv = {};
+        crv.h.v       = r->U32();
+        crv.isExact   = (r->U8() != 0);
+        crv.exact.deg = (int)r->U32();
+        crv.surfA.v   = r->U32();
+        crv.surfB.v   = r->U32();
+        if(crv.isExact) {
+            if(crv.exact.deg < 0 || crv.exact.deg > 3) return false;
+            for(int i = 0; i <= crv.exact.deg; i++) {
+                crv.exact.ctrl[i]   = r->Point();
+                crv.exact.weight[i] = r->Double();
+            }
+        }
+        uint32_t pts = r->U32();
+        for(uint32_t i = 0; i < pts && r->ok; i++) {
             SCurvePt scpt;
-            int vertex;
-            if(sscanf(line, "CurvePt %d %lf %lf %lf",
-                &vertex,
-                &(scpt.p.x), &(scpt.p.y), &(scpt.p.z)) != 4)
-            {
-                ssassert(false, "Unexpected CurvePt format");
-            }
-            scpt.vertex = (vertex != 0);
+            scpt.vertex = (r->U8() != 0);
+            scpt.p      = r->Point();
             crv.pts.Add(&scpt);
-        } else if(strcmp(line, "AddCurve")==0) {
-            sh->curve.Add(&crv);
-            crv = {};
-        } else ssassert(false, "Unexpected operation");
+        }
+        sh->curve.Add(&crv);
     }
+    return r->ok;
+}
 
-    fclose(fh);
+// Call back for each section in a binary file, with a reader for just that
+// section; or return false if the file is damaged, or from a newer version.
+// Sets *unknown if any of the sections had fields that we don't know.
+bool ForEachSection(const char *data, size_t size,
+                    const std::function<bool(const char *tag, BinaryReader *r)> &fn,
+                    bool *unknown) {
+    BinaryReader file = {};
+    file.p   = (const uint8_t *)data + strlen(BINARY_MAGIC);
+    file.end = (const uint8_t *)data + size;
+    file.ok  = true;
+    if(file.U32() > BINARY_VERSION) return false;
+
+    while(file.ok && file.p < file.end) {
+        char tag[5] = {};
+        if(!file.Have(4)) break;
+        memcpy(tag, file.p, 4);
+        file.p += 4;
+        uint64_t length = file.U64();
+        if(!file.Have(length)) break;
+
+        BinaryReader section = {};
+        section.p   = file.p;
+        section.end = file.p + length;
+        section.ok  = true;
+        file.p += length;
+        if(!fn(tag, &section)) return false;
+        if(section.unknown) *unknown = true;
+    }
+    return file.ok;
+}
+}
+
+bool SolveSpaceUI::IsBinaryFile(const char *data, size_t size) {
+    size_t length = strlen(BINARY_MAGIC);
+    return size >= length && memcmp(data, BINARY_MAGIC, length) == 0;
+}
+
+void SolveSpaceUI::SaveBinaryTo(const Platform::Path &filename) {
+    BinaryWriter w = {};
+    w.data = BINARY_MAGIC;
+    w.U32(BINARY_VERSION);
+    fwrite(w.data.data(), 1, w.data.size(), fh);
+    w.data.clear();
+
+    WriteTable(&w, filename, 'g', SK.group.n, [&](size_t i) {
+        sv.g = SK.group.elem[i];
+    });
+    w.WriteSection(fh, "GRUP");
+    WriteTable(&w, filename, 'p', SK.param.n, [&](size_t i) {
+        sv.p = SK.param.elem[SK.param.iti[i].i];
+    });
+    w.WriteSection(fh, "PARM");
+    WriteTable(&w, filename, 'r', SK.request.n, [&](size_t i) {
+        sv.r = SK.request.elem[SK.request.iti[i].i];
+    });
+    w.WriteSection(fh, "REQS");
+    WriteTable(&w, filename, 'c', SK.constraint.n, [&](size_t i) {
+        sv.c = SK.constraint.elem[SK.constraint.iti[i].i];
+    });
+    w.WriteSection(fh, "CONS");
+
+    std::vector<Style *> styles;
+    for(int i = 0; i < SK.style.n; i++) {
+        Style *s = &SK.style.elem[SK.style.iti[i].i];
+        if(s->h.v >= Style::FIRST_CUSTOM) styles.push_back(s);
+    }
+    WriteTable(&w, filename, 's', styles.size(), [&](size_t i) {
+        sv.s = *styles[i];
+    });
+    w.WriteSection(fh, "STYL");
+
+    // The entities are regenerated on load, and only needed by sketches that
+    // link this one; the same goes for the geometry, unless it's hashed.
+    WriteTable(&w, filename, 'e', SK.entity.n, [&](size_t i) {
+        Entity *e = &SK.entity.elem[SK.entity.iti[i].i];
+        e->CalculateNumerical(/*forExport=*/true);
+        sv.e = *e;
+    });
+    w.WriteSection(fh, "ENTS");
+
+    if(saveRegenCache) {
+        std::vector<std::pair<hGroup, uint64_t>> hash;
+        CalculateRegenHashes(&hash);
+        w.U32((uint32_t)hash.size());
+        for(const auto &gh : hash) {
+            w.U32(gh.first.v);
+            w.U64(gh.second);
+        }
+        w.WriteSection(fh, "HASH");
+    }
+
+    Group *g = SK.GetGroup(SK.groupOrder.elem[SK.groupOrder.n - 1]);
+    WriteMesh(&w, &g->runningMesh);
+    w.WriteSection(fh, "MESH");
+    WriteShell(&w, &g->runningShell);
+    w.WriteSection(fh, "SHEL");
+}
+
+void SolveSpaceUI::ParseBinary(const Platform::Path &filename, const char *data, size_t size) {
+    bool unknown = false;
+    bool ok = ForEachSection(data, size, [&](const char *tag, BinaryReader *r) {
+        if(!strcmp(tag, "GRUP")) {
+            return ReadTable(r, filename, &sv,
+                [&]() { sv.g = {}; sv.g.scale = 1; },
+                [&]() { SK.group.Add(&sv.g); });
+        } else if(!strcmp(tag, "PARM")) {
+            return ReadTable(r, filename, &sv,
+                [&]() { sv.p = {}; },
+                [&]() { SK.param.Add(&sv.p); });
+        } else if(!strcmp(tag, "REQS")) {
+            return ReadTable(r, filename, &sv,
+                [&]() { sv.r = {}; },
+                [&]() { SK.request.Add(&sv.r); });
+        } else if(!strcmp(tag, "CONS")) {
+            return ReadTable(r, filename, &sv,
+                [&]() { sv.c = {}; },
+                [&]() { SK.constraint.Add(&sv.c); });
+        } else if(!strcmp(tag, "STYL")) {
+            return ReadTable(r, filename, &sv,
+                [&]() { sv.s = {}; Style::FillDefaultStyle(&sv.s); },
+                [&]() { SK.style.Add(&sv.s); });
+        } else if(!strcmp(tag, "HASH")) {
+            uint32_t count = r->U32();
+            for(uint32_t i = 0; i < count && r->ok; i++) {
+                hGroup hg;
+                hg.v = r->U32();
+                regenCache.hash.emplace_back(hg, r->U64());
+            }
+            return r->ok;
+        } else if(!strcmp(tag, "MESH")) {
+            return regenCache.hash.empty() || ReadMesh(r, &regenCache.mesh);
+        } else if(!strcmp(tag, "SHEL")) {
+            return regenCache.hash.empty() || ReadShell(r, &regenCache.shell);
+        } else if(!strcmp(tag, "ENTS")) {
+            // entities are regenerated
+            return true;
+        } else {
+            fileLoadError = true;
+            return true;
+        }
+    }, &unknown);
+    if(!ok || unknown) fileLoadError = true;
+}
+
+bool SolveSpaceUI::LoadEntitiesFromBinary(const Platform::Path &filename,
+                                          const char *data, size_t size, SaveVars *vars,
+                                          EntityList *le, SMesh *m, SShell *sh) {
+    bool unknown = false;
+    return ForEachSection(data, size, [&](const char *tag, BinaryReader *r) {
+        if(!strcmp(tag, "ENTS")) {
+            return ReadTable(r, filename, vars,
+                [&]() { vars->e = {}; },
+                [&]() { le->Add(&vars->e); });
+        } else if(!strcmp(tag, "MESH")) {
+            return ReadMesh(r, m);
+        } else if(!strcmp(tag, "SHEL")) {
+            return ReadShell(r, sh);
+        } else {
+            return true;
+        }
+    }, &unknown);
+}
+
+//-----------------------------------------------------------------------------
+// Linked files are read once, and then taken from memory for as long as they
+// stay the same on disk; and the ones that a sketch links get read all at
+// once, each on its own thread.
+//-----------------------------------------------------------------------------
+
+// A sketch linked for its mesh only still brings in its faces, so that they
+// can be constrained against, and whatever this sketch already refers to;
+// along with the entities that those are built from.
+static void PruneLinkedEntities(EntityList *le, const std::set<uint32_t> &keep) {
+    std::vector<hEntity> tokeep;
+    for(Entity &e : *le) {
+        if(e.IsFace() || keep.count(e.h.v)) tokeep.push_back(e.h);
+    }
+
+    le->ClearTags();
+    for(size_t i = 0; i < tokeep.size(); i++) {
+        Entity *e = le->FindByIdNoOops(tokeep[i]);
+        if(e == NULL || e->tag) continue;
+        e->tag = 1;
+        for(hEntity hp : e->point) {
+            if(hp.v != 0) tokeep.push_back(hp);
+        }
+        if(e->normal.v != 0)   tokeep.push_back(e->normal);
+        if(e->distance.v != 0) tokeep.push_back(e->distance);
+    }
+    for(Entity &e : *le) {
+        e.tag = !e.tag;
+    }
+    le->RemoveTagged();
+}
+
+// Whether a loaded file has everything that this use of it needs.
+static bool LinkedFileHas(const SolveSpaceUI::LinkedFileUse &loaded,
+                          const SolveSpaceUI::LinkedFileUse &use) {
+    if(!loaded.meshOnly) return true;
+    if(!use.meshOnly) return false;
+    return std::includes(loaded.keep.begin(), loaded.keep.end(),
+                         use.keep.begin(), use.keep.end());
+}
+
+SolveSpaceUI::LinkedFileUse SolveSpaceUI::LinkedFileUseOf(Group *g) {
+    LinkedFileUse use = {};
+    use.filename = g->linkFile;
+    if(!g->linkMeshOnly) return use;
+    // Copies of this group's entities need all of them.
+    for(Group &og : SK.group) {
+        if(og.opA.v == g->h.v) return use;
+    }
+    use.meshOnly = true;
+
+    std::vector<hEntity> refs;
+    for(Group &og : SK.group) {
+        refs.push_back(og.activeWorkplane);
+        refs.push_back(og.predef.origin);
+        refs.push_back(og.predef.entityB);
+        refs.push_back(og.predef.entityC);
+    }
+    for(Request &r : SK.request) {
+        refs.push_back(r.workplane);
+    }
+    for(Constraint &c : SK.constraint) {
+        refs.push_back(c.workplane);
+        refs.push_back(c.ptA);
+        refs.push_back(c.ptB);
+        refs.push_back(c.entityA);
+        refs.push_back(c.entityB);
+        refs.push_back(c.entityC);
+        refs.push_back(c.entityD);
+    }
+    for(hEntity he : refs) {
+        if(he.isFromRequest() || he.group().v != g->h.v) continue;
+        EntityId id;
+        id.v = he.v & 0xffff;
+        EntityMap *em = g->remap.FindByIdNoOops(id);
+        if(em) use.keep.insert(em->input.v);
+    }
+    return use;
+}
+
+void SolveSpaceUI::LoadLinkedFiles(const std::vector<LinkedFileUse> &uses) {
+    // Every group that links the same file shares what's loaded from it.
+    std::map<Platform::Path, LinkedFileUse, Platform::PathLess> merged;
+    for(const LinkedFileUse &use : uses) {
+        auto it = merged.find(use.filename);
+        if(it == merged.end()) {
+            merged[use.filename] = use;
+        } else if(!use.meshOnly) {
+            it->second.meshOnly = false;
+            it->second.keep.clear();
+        } else if(it->second.meshOnly) {
+            it->second.keep.insert(use.keep.begin(), use.keep.end());
+        }
+    }
+
+    struct Load {
+        LinkedFile      file;
+        bool            loaded;
+    };
+    std::vector<Load> loads;
+    for(auto &it : merged) {
+        const Platform::Path &filename = it.first;
+
+        Load load = {};
+        load.file.use = it.second;
+        if(!GetFileStatus(filename, &load.file.size, &load.file.mtime)) continue;
+        auto cached = linkedFiles.find(filename);
+        if(cached != linkedFiles.end() && cached->second.size == load.file.size &&
+           cached->second.mtime == load.file.mtime &&
+           LinkedFileHas(cached->second.use, load.file.use)) {
+            continue;
+        }
+        loads.push_back(load);
+    }
+
+    ParallelFor(loads.size(), [&](size_t i) {
+        LinkedFile *file = &loads[i].file;
+        loads[i].loaded = LoadEntitiesFromFile(file->use.filename, &file->entity,
+                                               &file->mesh, &file->shell);
+        // Don't hold on to the entities that no one needs.
+        if(loads[i].loaded && file->use.meshOnly) {
+            PruneLinkedEntities(&file->entity, file->use.keep);
+        }
+    });
+
+    for(Load &load : loads) {
+        const Platform::Path &filename = load.file.use.filename;
+        ForgetLinkedFile(filename);
+        if(load.loaded) {
+            linkedFiles[filename] = load.file;
+        } else {
+            load.file.entity.Clear();
+            load.file.mesh.Clear();
+            load.file.shell.Clear();
+        }
+    }
+}
+
+bool SolveSpaceUI::LoadLinkedFile(const LinkedFileUse &use, EntityList *le,
+                                  SMesh *m, SShell *sh) {
+    LoadLinkedFiles({ use });
+    auto it = linkedFiles.find(use.filename);
+    if(it == linkedFiles.end()) return false;
+
+    LinkedFile *file = &it->second;
+    le->ReserveMore(file->entity.n);
+    for(Entity &e : file->entity) {
+        le->Add(&e);
+    }
+    // Other groups linking the same file may have needed more of it.
+    if(use.meshOnly && !(file->use.meshOnly && file->use.keep == use.keep)) {
+        PruneLinkedEntities(le, use.keep);
+    }
+    m->MakeFromCopyOf(&file->mesh);
+    sh->MakeFromCopyOf(&file->shell);
     return true;
 }
 
+void SolveSpaceUI::ForgetLinkedFile(const Platform::Path &filename) {
+    auto it = linkedFiles.find(filename);
+    if(it == linkedFiles.end()) return;
+
+    it->second.entity.Clear();
+    it->second.mesh.Clear();
+    it->second.shell.Clear();
+    linkedFiles.erase(it);
+}
+
 bool SolveSpaceUI::ReloadAllLinked(const Platform::Path &saveFile, bool canCancel) {
     std::map<Platform::Path, Platform::Path, Platform::PathLess> linkMap;
 
     allConsistent = false;
 
+    std::vector<LinkedFileUse> linkUses;
+    for(Group &g : SK.group) {
+        if(g.type != Group::Type::LINKED) continue;
+        linkUses.push_back(LinkedFileUseOf(&g));
+    }
+    LoadLinkedFiles(linkUses);
+
     for(Group &g : SK.group) {
         if(g.type != Group::Type::LINKED) continue;
 
@@ -849,7 +2216,7 @@ bool SolveSpaceUI::ReloadAllLinked(const Platform::Path &saveFile, bool canCance
         }
 
 try_again:
-        if(LoadEntitiesFromFile(g.linkFile, &g.impEntity, &g.impMesh, &g.impShell)) {
+        if(LoadLinkedFile(LinkedFileUseOf(&g), &g.impEntity, &g.impMesh, &g.impShell)) {
             // We loaded the data, good. Now import its dependencies as well.
             for(Entity &e : g.impEntity) {
                 if(e.type != Entity::Type::IMAGE) continue;
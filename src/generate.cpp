@@ -26,6 +26,7 @@ void SolveSpaceUI::MarkGroupDirty(hGroup hg, bool onlyThis) {
             if(onlyThis) break;
         }
     }
+    DiscardRegenCache();
     unsaved = true;
     ScheduleGenerateAll();
 }
@@ -143,6 +144,9 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
 
     uint64_t startMillis = GetMilliseconds(),
              endMillis;
+    generateMillis = {};
+    SSurface::closestPointQueries   = 0;
+    SSurface::closestPointCacheHits = 0;
 
     SK.groupOrder.Clear();
     for(int i = 0; i < SK.group.n; i++)
@@ -152,6 +156,17 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
             return SK.GetGroup(ha)->order < SK.GetGroup(hb)->order;
         });
 
+    // The regeneration cache has only the last group's geometry, so it's of no
+    // use once an earlier group is shown, or the tolerances differ.
+    if(regenCache.group.v != 0 && !genForBBox) {
+        bool untilLast = (type == Generate::ALL || type == Generate::REGEN ||
+                          GW.activeGroup.v == SK.groupOrder.elem[SK.groupOrder.n - 1].v);
+        if(!untilLast || exportMode || chordTol != regenCache.chordTol ||
+           maxSegments != regenCache.maxSegments) {
+            DiscardRegenCache();
+        }
+    }
+
     switch(type) {
         case Generate::DIRTY: {
             first = INT_MAX;
@@ -276,6 +291,9 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
                 if(genForBBox) {
                     SolveGroupAndReport(g->h, andFindFree);
                     g->GenerateLoops();
+                } else if(g->regenCached) {
+                    // Unchanged since it was loaded, so the cache has it.
+                    g->clean = true;
                 } else {
                     g->GenerateShellAndMesh();
                     g->clean = true;
@@ -372,10 +390,17 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
             case Generate::UNTIL_ACTIVE:    typeStr = "UNTIL_ACTIVE"; break;
         }
         if(endMillis)
-        dbp("Generate::%s%s took %lld ms",
+        dbp("Generate::%s%s took %lld ms (merging surfaces %lld ms)",
             typeStr,
             (genForBBox ? " (for bounding box)" : ""),
-            GetMilliseconds() - startMillis);
+            GetMilliseconds() - startMillis,
+            generateMillis.mergeSurfaces);
+        uint64_t queries = SSurface::closestPointQueries,
+                 hits    = SSurface::closestPointCacheHits;
+        if(queries > 0) {
+            dbp("    projected %llu points into surfaces, %.1f%% from "
+                "cached guess", queries, 100.0*(double)hits/(double)queries);
+        }
     }
 
     return;
@@ -388,6 +413,22 @@ pruned:
     GenerateAll(type, andFindFree, genForBBox);
 }
 
+//-----------------------------------------------------------------------------
+// Groups taken from the regeneration cache have no shells or meshes of their
+// own, except for the last one; so as soon as anything changes, or needs any
+// of the others, mark them all to be generated for real.
+//-----------------------------------------------------------------------------
+void SolveSpaceUI::DiscardRegenCache() {
+    if(regenCache.group.v == 0) return;
+
+    for(Group &g : SK.group) {
+        if(!g.regenCached) continue;
+        g.regenCached = false;
+        g.clean = false;
+    }
+    regenCache.group = {};
+}
+
 void SolveSpaceUI::ForceReferences() {
     // Force the values of the parameters that define the three reference
     // coordinate systems.
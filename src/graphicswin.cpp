@@ -954,6 +954,7 @@ void GraphicsWindow::MenuEdit(Command id) {
 
         case Command::REGEN_ALL:
             SS.images.clear();
+            SS.DiscardRegenCache();
             SS.ReloadAllLinked(SS.saveFile);
             SS.GenerateAll(SolveSpaceUI::Generate::UNTIL_ACTIVE);
             SS.ScheduleShowTW();
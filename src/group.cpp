@@ -27,6 +27,7 @@ void Group::Clear() {
     runningShell.Clear();
     displayMesh.Clear();
     displayOutlines.Clear();
+    ClearDisplayLods();
     impMesh.Clear();
     impShell.Clear();
     impEntity.Clear();
@@ -350,7 +351,9 @@ void Group::Activate() {
     } else {
         SS.GW.showFaces = false;
     }
-    SS.MarkGroupDirty(h); // for good measure; shouldn't be needed
+    // For good measure; shouldn't be needed. Except that geometry taken from
+    // the regeneration cache is up to date, and that would discard it.
+    if(!regenCached) SS.MarkGroupDirty(h);
     SS.ScheduleShowTW();
 }
 
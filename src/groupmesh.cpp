@@ -314,7 +314,9 @@ void Group::GenerateShellAndMesh() {
     }
 
     if(srcg->meshCombine != CombineAs::ASSEMBLE) {
+        int64_t startMillis = GetMilliseconds();
         thisShell.MergeCoincidentSurfaces();
+        SS.generateMillis.mergeSurfaces += GetMilliseconds() - startMillis;
     }
 
     // So now we've got the mesh or shell for this group. Combine it with
@@ -329,7 +331,9 @@ void Group::GenerateShellAndMesh() {
             srcg->meshCombine);
 
         if(srcg->meshCombine != CombineAs::ASSEMBLE) {
+            int64_t startMillis = GetMilliseconds();
             runningShell.MergeCoincidentSurfaces();
+            SS.generateMillis.mergeSurfaces += GetMilliseconds() - startMillis;
         }
 
         // If the Boolean failed, then we should note that in the text screen
@@ -352,16 +356,14 @@ void Group::GenerateShellAndMesh() {
         SMesh outm = {};
         GenerateForBoolean<SMesh>(&prevm, &thism, &outm, srcg->meshCombine);
 
-        // Remove degenerate triangles; if we don't, they'll get split in SnapToMesh
-        // in every generated group, resulting in polynomial increase in triangle count,
-        // and corresponding slowdown.
+        // Remove degenerate triangles; if we don't, they'll get split when we make
+        // the mesh vertex-to-vertex in every generated group, resulting in polynomial
+        // increase in triangle count, and corresponding slowdown.
         outm.RemoveDegenerateTriangles();
 
         if(srcg->meshCombine != CombineAs::ASSEMBLE) {
             // And make sure that the output mesh is vertex-to-vertex.
-            SKdNode *root = SKdNode::From(&outm);
-            root->SnapToMesh(&outm);
-            root->MakeMeshInto(&runningMesh);
+            outm.MakeVertexToVertexInto(&runningMesh);
         } else {
             runningMesh.MakeFromCopyOf(&outm);
         }
@@ -374,13 +376,17 @@ void Group::GenerateShellAndMesh() {
     displayDirty = true;
 }
 
+static uint64_t HashForDisplayLods(const SMesh &m);
+
 void Group::GenerateDisplayItems() {
     // This is potentially slow (since we've got to triangulate a shell, or
     // to find the emphasized edges for a mesh), so we will run it only
     // if its inputs have changed.
     if(displayDirty) {
         Group *pg = RunningMeshGroup();
-        if(pg && thisMesh.IsEmpty() && thisShell.IsEmpty()) {
+        bool sameAsPrevious =
+            (pg && thisMesh.IsEmpty() && thisShell.IsEmpty() && !regenCached);
+        if(sameAsPrevious) {
             // We don't contribute any new solid model in this group, so our
             // display items are identical to the previous group's; which means
             // that we can just display those, and stop ourselves from
@@ -436,6 +442,21 @@ void Group::GenerateDisplayItems() {
         // work correctly.
         displayMesh.PrecomputeTransparency();
 
+        // The decimated copies stay good for as long as the mesh is the same;
+        // and if it's the previous group's, so are its copies.
+        uint64_t lodHash = HashForDisplayLods(displayMesh);
+        if(lodHash != displayLodHash) {
+            ClearDisplayLods();
+            displayLodHash = lodHash;
+            if(sameAsPrevious && pg->displayLodBuilt && pg->displayLodHash == lodHash) {
+                for(int i = 0; i < DISPLAY_LOD_LEVELS; i++) {
+                    displayLodMesh[i].MakeFromCopyOf(&(pg->displayLodMesh[i]));
+                    displayLodError[i] = pg->displayLodError[i];
+                }
+                displayLodBuilt = true;
+            }
+        }
+
         // Recalculate mass center if needed
         if(SS.centerOfMass.draw && SS.centerOfMass.dirty && h.v == SS.GW.activeGroup.v) {
             SS.UpdateCenterOfMass();
@@ -475,6 +496,92 @@ bool Group::IsMeshGroup() {
     }
 }
 
+//-----------------------------------------------------------------------------
+// Large models seen from far away are tessellated much more finely than a
+// pixel, so we also keep decimated copies of the display mesh, with the error
+// doubling from one level to the next. Each level is decimated from the one
+// before, so its error bound is the sum of the errors so far. They're only
+// built once the model is first drawn small enough to use one, and then kept
+// until the display mesh changes.
+//-----------------------------------------------------------------------------
+static const int LOD_MIN_TRIANGLES = 10000;
+
+static uint64_t HashForDisplayLods(const SMesh &m) {
+    if(m.l.n < LOD_MIN_TRIANGLES || m.isTransparent) return 0;
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto add = [&](const void *data, size_t length) {
+        uint64_t v;
+        for(size_t i = 0; i < length; i += sizeof(v)) {
+            memcpy(&v, (const char *)data + i, sizeof(v));
+            hash = (hash ^ v) * 0x100000001b3ULL;
+        }
+    };
+    // The levels are decimated with errors relative to the chord tolerance.
+    add(&SS.chordTolCalculated, sizeof(double));
+    for(const STriangle &tr : m.l) {
+        uint64_t meta = ((uint64_t)tr.meta.face << 32) | tr.meta.color.ToPackedInt();
+        add(&meta, sizeof(meta));
+        add(tr.vertices, sizeof(tr.vertices));
+    }
+    // Never zero, so that it can't be mistaken for a mesh without levels.
+    return hash | 1;
+}
+
+void Group::ClearDisplayLods() {
+    for(int i = 0; i < DISPLAY_LOD_LEVELS; i++) {
+        displayLodMesh[i].Clear();
+        displayLodError[i] = 0.0;
+    }
+    displayLodHash = 0;
+    displayLodBuilt = false;
+}
+
+void Group::GenerateDisplayLods() {
+    displayLodBuilt = true;
+    double error = SS.chordTolCalculated;
+    if(displayLodHash == 0 || error <= 0.0) return;
+
+    // A level that doesn't remove at least a tenth of the triangles isn't
+    // worth keeping, but a coarser one might still be.
+    const SMesh *prev = &displayMesh;
+    double bound = 0.0;
+    int levels = 0;
+    for(int i = 0; i < 2 * DISPLAY_LOD_LEVELS && levels < DISPLAY_LOD_LEVELS; i++) {
+        error *= 2;
+        SMesh *m = &displayLodMesh[levels];
+        prev->MakeDecimatedInto(m, 0, error);
+        if(m->l.n > prev->l.n * 9 / 10) {
+            m->Clear();
+            continue;
+        }
+        m->PrecomputeTransparency();
+        bound += error;
+        displayLodError[levels++] = bound;
+        prev = m;
+        if(m->l.n < LOD_MIN_TRIANGLES / 10) break;
+    }
+}
+
+const SMesh *Group::DisplayMeshFor(const Camera &camera) {
+    if(!camera.hasPixels || camera.IsPerspective() || displayLodHash == 0) {
+        return &displayMesh;
+    }
+
+    // Keep the error under half a pixel; the first level has at least twice
+    // the chord tolerance.
+    double pixelError = 0.5 / camera.scale;
+    if(pixelError < 2 * SS.chordTolCalculated) return &displayMesh;
+    if(!displayLodBuilt) GenerateDisplayLods();
+
+    const SMesh *mesh = &displayMesh;
+    for(int i = 0; i < DISPLAY_LOD_LEVELS; i++) {
+        if(displayLodMesh[i].IsEmpty() || displayLodError[i] > pixelError) break;
+        mesh = &displayLodMesh[i];
+    }
+    return mesh;
+}
+
 void Group::DrawMesh(DrawMeshAs how, Canvas *canvas) {
     if(!(SS.GW.showShaded ||
          SS.GW.drawOccludedAs != GraphicsWindow::DrawOccludedAs::VISIBLE)) return;
@@ -506,7 +613,7 @@ void Group::DrawMesh(DrawMeshAs how, Canvas *canvas) {
 
             // Draw the shaded solid into the depth buffer for hidden line removal,
             // and if we're actually going to display it, to the color buffer too.
-            canvas->DrawMesh(displayMesh, hcfFront, hcfBack);
+            canvas->DrawMesh(*DisplayMeshFor(canvas->GetCamera()), hcfFront, hcfBack);
 
             // Draw mesh edges, for debugging.
             if(SS.GW.showMesh) {
@@ -6,6 +6,7 @@
 //-----------------------------------------------------------------------------
 #include "solvespace.h"
 
+#include <queue>
 #include <set>
 
 void SMesh::Clear() {
@@ -82,17 +83,20 @@ void SMesh::MakeEdgesInPlaneInto(SEdgeList *sel, Vector n, double d) {
     m.l.RemoveTagged();
 
     // Select the naked edges in our resulting open mesh.
-    SKdNode *root = SKdNode::From(&m);
-    root->SnapToMesh(&m);
+    SMesh vm = {};
+    m.MakeVertexToVertexInto(&vm);
+    SKdNode *root = SKdNode::From(&vm);
     root->MakeCertainEdgesInto(sel, EdgeKind::NAKED_OR_SELF_INTER,
                                /*coplanarIsInter=*/false, NULL, NULL);
 
+    vm.Clear();
     m.Clear();
 }
 
 void SMesh::MakeOutlinesInto(SOutlineList *sol, EdgeKind edgeKind) {
-    SKdNode *root = SKdNode::From(this);
-    root->MakeOutlinesInto(sol, edgeKind);
+    SIndexedTriMesh im = {};
+    im.MakeFromMesh(this);
+    im.MakeOutlinesInto(sol, edgeKind);
 }
 
 //-----------------------------------------------------------------------------
@@ -115,6 +119,7 @@ void SMesh::Simplify(int start) {
 
     Vector n = Vector::From(0, 0, 0);
     Vector *conv = (Vector *)AllocTemporary(maxTriangles*3*sizeof(*conv));
+    int *convId = (int *)AllocTemporary(maxTriangles*3*sizeof(*convId));
     int convc = 0;
 
     int start0 = start;
@@ -129,6 +134,47 @@ void SMesh::Simplify(int start) {
         }
     }
 
+    // Weld the vertices, so that the triangle across an edge of the polygon
+    // can be looked up by its endpoints instead of searched for. Each vertex
+    // joins the first one before it that it Equals().
+    int tn = l.n - start0;
+    std::vector<Vector> vertex;
+    std::vector<int> vertexId(3*tn);
+    VertexGrid weld = {};
+    weld.size = 4*LENGTH_EPS;
+    std::vector<int> near;
+    for(i = 0; i < 3*tn; i++) {
+        Vector p = l.elem[start0 + i/3].vertices[i%3];
+        Vector r = Vector::From(LENGTH_EPS, LENGTH_EPS, LENGTH_EPS);
+        near.clear();
+        weld.FindInBox(p.Minus(r), p.Plus(r), &near);
+        int found = -1;
+        for(int k : near) {
+            if((found < 0 || k < found) && vertex[k].Equals(p)) found = k;
+        }
+        if(found < 0) {
+            found = (int)vertex.size();
+            vertex.push_back(p);
+            weld.Add(p, found);
+        }
+        vertexId[i] = found;
+    }
+
+    // The half-edge from vertex k to k+1 of triangle t is numbered 3*t+k.
+    // Half-edges with the same endpoints are chained in increasing order, so
+    // that candidates get tried in the same order as a scan would.
+    std::unordered_map<uint64_t, int> edgeHead;
+    std::vector<int> edgeNext(3*tn);
+    auto EdgeKey = [](int from, int to) {
+        return ((uint64_t)(uint32_t)from << 32) | (uint32_t)to;
+    };
+    for(i = 3*tn - 1; i >= 0; i--) {
+        int to = vertexId[3*(i/3) + (i%3 + 1)%3];
+        int &head = edgeHead.emplace(EdgeKey(vertexId[i], to), -1).first->second;
+        edgeNext[i] = head;
+        head = i;
+    }
+
     for(;;) {
         bool didAdd;
         convc = 0;
@@ -138,9 +184,11 @@ void SMesh::Simplify(int start) {
 
             tr->tag = 1;
             n = (tr->Normal()).WithMagnitude(1);
-            conv[convc++] = tr->a;
-            conv[convc++] = tr->b;
-            conv[convc++] = tr->c;
+            for(int k = 0; k < 3; k++) {
+                conv[convc] = tr->vertices[k];
+                convId[convc] = vertexId[3*(i - start0) + k];
+                convc++;
+            }
 
             start = i+1;
             break;
@@ -156,20 +204,18 @@ void SMesh::Simplify(int start) {
                        d = conv[WRAP((j+1), convc)],
                        e = conv[WRAP((j+2), convc)];
 
-                Vector c;
-                for(i = start; i < l.n; i++) {
-                    STriangle *tr = &(l.elem[i]);
+                // Look for a triangle that has the edge from d to b, which
+                // is the other half of our edge from b to d.
+                auto it = edgeHead.find(EdgeKey(convId[WRAP((j+1), convc)],
+                                                convId[j]));
+                if(it == edgeHead.end()) continue;
+
+                for(int he = it->second; he >= 0; he = edgeNext[he]) {
+                    STriangle *tr = &(l.elem[start0 + he/3]);
                     if(tr->tag) continue;
 
-                    if((tr->a).Equals(d) && (tr->b).Equals(b)) {
-                        c = tr->c;
-                    } else if((tr->b).Equals(d) && (tr->c).Equals(b)) {
-                        c = tr->a;
-                    } else if((tr->c).Equals(d) && (tr->a).Equals(b)) {
-                        c = tr->b;
-                    } else {
-                        continue;
-                    }
+                    int ci = 3*(he/3) + (he%3 + 2)%3;
+                    Vector c = tr->vertices[ci%3];
                     // The vertex at C must be convex; but the others must
                     // be tested
                     Vector ab = b.Minus(a);
@@ -185,19 +231,27 @@ void SMesh::Simplify(int start) {
 
                     if(fabs(bDot) < LENGTH_EPS && fabs(dDot) < LENGTH_EPS) {
                         conv[WRAP((j+1), convc)] = c;
+                        convId[WRAP((j+1), convc)] = vertexId[ci];
                         // and remove the vertex at j, which is a dup
                         memmove(conv+j, conv+j+1,
                                           (convc - j - 1)*sizeof(conv[0]));
+                        memmove(convId+j, convId+j+1,
+                                          (convc - j - 1)*sizeof(convId[0]));
                         convc--;
                     } else if(fabs(bDot) < LENGTH_EPS && dDot > 0) {
                         conv[j] = c;
+                        convId[j] = vertexId[ci];
                     } else if(fabs(dDot) < LENGTH_EPS && bDot > 0) {
                         conv[WRAP((j+1), convc)] = c;
+                        convId[WRAP((j+1), convc)] = vertexId[ci];
                     } else if(bDot > 0 && dDot > 0) {
                         // conv[j] is unchanged, conv[j+1] goes to [j+2]
                         memmove(conv+j+2, conv+j+1,
                                             (convc - j - 1)*sizeof(conv[0]));
+                        memmove(convId+j+2, convId+j+1,
+                                            (convc - j - 1)*sizeof(convId[0]));
                         conv[j+1] = c;
+                        convId[j+1] = vertexId[ci];
                         convc++;
                     } else {
                         continue;
@@ -238,30 +292,63 @@ void SMesh::Simplify(int start) {
     }
     FreeTemporary(tout);
     FreeTemporary(conv);
+    FreeTemporary(convId);
 }
 
-void SMesh::AddAgainstBsp(SMesh *srcm, SBsp3 *bsp3) {
-    int i;
-
-    for(i = 0; i < srcm->l.n; i++) {
-        STriangle *st = &(srcm->l.elem[i]);
-        int pn = l.n;
-        atLeastOneDiscarded = false;
-        SBsp3::InsertOrCreate(bsp3, st, this);
-        if(!atLeastOneDiscarded && (l.n != (pn+1))) {
-            l.n = pn;
-            if(flipNormal) {
-                AddTriangle(st->meta, st->c, st->b, st->a);
+namespace {
+
+void AddRangeAgainstBsp(SMesh *dest, const SMesh *srcm, int start, int end,
+                        SBsp3 *bsp3) {
+    for(int i = start; i < end; i++) {
+        STriangle st = srcm->l.elem[i];
+        int pn = dest->l.n;
+        dest->atLeastOneDiscarded = false;
+        SBsp3::InsertOrCreate(bsp3, &st, dest);
+        if(!dest->atLeastOneDiscarded && (dest->l.n != (pn+1))) {
+            dest->l.n = pn;
+            if(dest->flipNormal) {
+                dest->AddTriangle(st.meta, st.c, st.b, st.a);
             } else {
-                AddTriangle(st->meta, st->a, st->b, st->c);
+                dest->AddTriangle(st.meta, st.a, st.b, st.c);
             }
         }
-        if(l.n - pn > 1) {
-            Simplify(pn);
+        if(dest->l.n - pn > 1) {
+            dest->Simplify(pn);
         }
     }
 }
 
+}
+
+//-----------------------------------------------------------------------------
+// Classify the triangles of srcm against the finished tree of the other mesh,
+// adding the parts that we keep to ourselves. The tree is only read when we
+// do that, so the triangles can be split into chunks that go in parallel, each
+// into a mesh of its own; appending those in order gives exactly the same
+// result as doing it serially.
+//-----------------------------------------------------------------------------
+void SMesh::AddAgainstBsp(SMesh *srcm, SBsp3 *bsp3, bool parallel) {
+    const int CHUNK = 256;
+    int chunks = (srcm->l.n + CHUNK - 1) / CHUNK;
+    if(!parallel || chunks < 2 || std::thread::hardware_concurrency() < 2) {
+        AddRangeAgainstBsp(this, srcm, 0, srcm->l.n, bsp3);
+        return;
+    }
+
+    std::vector<SMesh> out(chunks);
+    ParallelFor(chunks, [&](size_t c) {
+        SMesh *m = &out[c];
+        m->flipNormal   = flipNormal;
+        m->keepCoplanar = keepCoplanar;
+        AddRangeAgainstBsp(m, srcm, (int)c*CHUNK, min((int)(c+1)*CHUNK, srcm->l.n),
+                           bsp3);
+    });
+    for(SMesh &m : out) {
+        MakeFromCopyOf(&m);
+        m.Clear();
+    }
+}
+
 void SMesh::MakeFromUnionOf(SMesh *a, SMesh *b) {
     SBsp3 *bspa = SBsp3::FromMesh(a);
     SBsp3 *bspb = SBsp3::FromMesh(b);
@@ -362,31 +449,196 @@ STriangleLl *STriangleLl::Alloc()
 SKdNode *SKdNode::Alloc()
     { return (SKdNode *)AllocTemporary(sizeof(SKdNode)); }
 
+//-----------------------------------------------------------------------------
+// Build the tree by the surface area heuristic. A line through a node passes
+// through each child with probability roughly proportional to the child's
+// surface area, so the expected cost of a query after splitting is the cost
+// of the traversal, plus that chance times the count of triangles on each
+// side. We try a few planes along each axis, keep the cheapest, and make a
+// leaf when no split beats just testing every triangle. The top of the tree
+// gets built first, and then the subtrees below it in parallel; the result
+// doesn't depend on the number of threads.
+//-----------------------------------------------------------------------------
+namespace {
+
+struct KdItem {
+    STriangle  *tr;
+    double      min[3];
+    double      max[3];
+};
+
+class KdBuilder {
+public:
+    enum {
+        BINS        = 16,
+        MAX_DEPTH   = 48,
+        // Past this many triangles, we split even if the heuristic says not
+        // to. Our queries are mostly short edges, and long thin triangles
+        // that span the node would otherwise keep many small ones together.
+        MAX_LEAF    = 16,
+    };
+    // The cost of visiting a node, relative to testing one triangle.
+    static constexpr double TRAVERSAL_COST = 0.5;
+
+    struct Task {
+        SKdNode             *node;
+        std::vector<KdItem>  items;
+        int                  depth;
+    };
+
+    std::vector<Task>   *deferred   = NULL;
+    int                  deferDepth = 0;
+
+    static double HalfArea(const double *lo, const double *hi) {
+        double dx = hi[0] - lo[0] + LENGTH_EPS,
+               dy = hi[1] - lo[1] + LENGTH_EPS,
+               dz = hi[2] - lo[2] + LENGTH_EPS;
+        return dx*dy + dy*dz + dz*dx;
+    }
+
+    static void MakeLeaf(SKdNode *node, const std::vector<KdItem> &items) {
+        if(items.empty()) return;
+
+        STriangleLl *ll =
+            (STriangleLl *)AllocTemporary(items.size() * sizeof(STriangleLl));
+        for(size_t i = 0; i < items.size(); i++) {
+            ll[i].tri  = items[i].tr;
+            ll[i].next = (i + 1 < items.size()) ? &ll[i + 1] : NULL;
+        }
+        node->tris = ll;
+    }
+
+    void Build(SKdNode *node, std::vector<KdItem> *items, int depth) {
+        size_t n = items->size();
+        if(n < 3 || depth >= MAX_DEPTH) {
+            MakeLeaf(node, *items);
+            return;
+        }
+        if(deferred && depth == deferDepth) {
+            deferred->push_back({ node, std::move(*items), depth });
+            return;
+        }
+
+        double lo[3] = {  VERY_POSITIVE,  VERY_POSITIVE,  VERY_POSITIVE },
+               hi[3] = {  VERY_NEGATIVE,  VERY_NEGATIVE,  VERY_NEGATIVE };
+        for(const KdItem &it : *items) {
+            for(int a = 0; a < 3; a++) {
+                lo[a] = min(lo[a], it.min[a]);
+                hi[a] = max(hi[a], it.max[a]);
+            }
+        }
+
+        double area = HalfArea(lo, hi);
+        double bestCost = VERY_POSITIVE, bestC = 0;
+        int bestAxis = -1;
+        for(int a = 0; a < 3; a++) {
+            double ext = hi[a] - lo[a];
+            // A plane within KDTREE_EPS of everything separates nothing.
+            if(ext < 4*KDTREE_EPS) continue;
+
+            // Bin with the same tolerance that we'll partition with, since
+            // our vertices often lie exactly on the candidate planes.
+            size_t minCount[BINS] = {}, maxCount[BINS] = {};
+            for(const KdItem &it : *items) {
+                int bmin = (int)floor((it.min[a] - KDTREE_EPS - lo[a]) / ext * BINS),
+                    bmax = (int)floor((it.max[a] + KDTREE_EPS - lo[a]) / ext * BINS);
+                minCount[max(0, min((int)BINS - 1, bmin))]++;
+                maxCount[max(0, min((int)BINS - 1, bmax))]++;
+            }
+
+            // Triangles that start below a plane go less than it, and those
+            // that end above it go greater; the ones that span it go both.
+            size_t nlt[BINS], ngt[BINS];
+            nlt[0] = 0;
+            for(int k = 1; k < BINS; k++) nlt[k] = nlt[k - 1] + minCount[k - 1];
+            ngt[BINS - 1] = maxCount[BINS - 1];
+            for(int k = BINS - 2; k >= 1; k--) ngt[k] = ngt[k + 1] + maxCount[k];
+
+            for(int k = 1; k < BINS; k++) {
+                if(nlt[k] == n || ngt[k] == n) continue;
+
+                double c = lo[a] + ext * k / BINS;
+                double loGt[3] = { lo[0], lo[1], lo[2] },
+                       hiLt[3] = { hi[0], hi[1], hi[2] };
+                loGt[a] = c;
+                hiLt[a] = c;
+                double cost = TRAVERSAL_COST +
+                    (HalfArea(lo, hiLt) * (double)nlt[k] +
+                     HalfArea(loGt, hi) * (double)ngt[k]) / area;
+                if(cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = a;
+                    bestC    = c;
+                }
+            }
+        }
+        if(bestAxis < 0 || (bestCost >= (double)n && n <= MAX_LEAF)) {
+            MakeLeaf(node, *items);
+            return;
+        }
+
+        std::vector<KdItem> lt, gt;
+        for(const KdItem &it : *items) {
+            if(it.min[bestAxis] < bestC + KDTREE_EPS) lt.push_back(it);
+            if(it.max[bestAxis] > bestC - KDTREE_EPS) gt.push_back(it);
+        }
+        if(lt.size() == n || gt.size() == n) {
+            MakeLeaf(node, *items);
+            return;
+        }
+        items->clear();
+        items->shrink_to_fit();
+
+        node->which = bestAxis;
+        node->c     = bestC;
+        node->gt    = SKdNode::Alloc();
+        node->lt    = SKdNode::Alloc();
+        Build(node->gt, &gt, depth + 1);
+        Build(node->lt, &lt, depth + 1);
+    }
+};
+
+}
+
 SKdNode *SKdNode::From(SMesh *m) {
-    int i;
     STriangle *tra = (STriangle *)AllocTemporary((m->l.n) * sizeof(*tra));
 
-    for(i = 0; i < m->l.n; i++) {
+    std::vector<KdItem> items;
+    items.reserve(m->l.n);
+    for(int i = 0; i < m->l.n; i++) {
         tra[i] = m->l.elem[i];
-    }
 
-    srand(0);
-    int n = m->l.n;
-    while(n > 1) {
-        int k = rand() % n;
-        n--;
-        swap(tra[k], tra[n]);
+        KdItem it;
+        it.tr = &tra[i];
+        for(int a = 0; a < 3; a++) {
+            double ea = tra[i].a.Element(a),
+                   eb = tra[i].b.Element(a),
+                   ec = tra[i].c.Element(a);
+            it.min[a] = min(ea, min(eb, ec));
+            it.max[a] = max(ea, max(eb, ec));
+        }
+        items.push_back(it);
     }
 
-    STriangleLl *tll = NULL;
-    for(i = 0; i < m->l.n; i++) {
-        STriangleLl *tn = STriangleLl::Alloc();
-        tn->tri = &(tra[i]);
-        tn->next = tll;
-        tll = tn;
+    // Enough subtrees to keep every thread busy, if there are enough
+    // triangles to make that worthwhile.
+    std::vector<KdBuilder::Task> deferred;
+    KdBuilder builder;
+    unsigned threads = std::thread::hardware_concurrency();
+    if(threads > 1 && m->l.n > 4096) {
+        builder.deferred   = &deferred;
+        builder.deferDepth = 2;
+        while((1u << builder.deferDepth) < 4*threads) builder.deferDepth++;
     }
 
-    return SKdNode::From(tll);
+    SKdNode *root = Alloc();
+    builder.Build(root, &items, 0);
+
+    ParallelFor(deferred.size(), [&](size_t i) {
+        KdBuilder sub;
+        sub.Build(deferred[i].node, &deferred[i].items, deferred[i].depth);
+    });
+    return root;
 }
 
 SKdNode *SKdNode::From(STriangleLl *tll) {
@@ -551,6 +803,38 @@ void SKdNode::ListTrianglesInto(std::vector<STriangle *> *tl) const {
     }
 }
 
+//-----------------------------------------------------------------------------
+// Measure the shape of the tree, to see how well it was built.
+//-----------------------------------------------------------------------------
+void SKdNode::AddStatsTo(Stats *stats, std::unordered_set<STriangle *> *seen,
+                         int depth) const {
+    stats->nodes++;
+    stats->maxDepth = max(stats->maxDepth, depth);
+    if(gt && lt) {
+        gt->AddStatsTo(stats, seen, depth + 1);
+        lt->AddStatsTo(stats, seen, depth + 1);
+        return;
+    }
+
+    int count = 0;
+    for(STriangleLl *ll = tris; ll; ll = ll->next) {
+        seen->insert(ll->tri);
+        count++;
+    }
+    stats->leaves++;
+    if(count == 0) stats->emptyLeaves++;
+    stats->references  += count;
+    stats->maxLeafSize  = max(stats->maxLeafSize, count);
+}
+
+SKdNode::Stats SKdNode::GetStats() const {
+    Stats stats = {};
+    std::unordered_set<STriangle *> seen;
+    AddStatsTo(&stats, &seen, 0);
+    stats.triangles = (int)seen.size();
+    return stats;
+}
+
 //-----------------------------------------------------------------------------
 // If any triangles in the mesh have an edge that goes through v (but not
 // a vertex at v), then split those triangles so that they now have a vertex
@@ -626,7 +910,8 @@ void SKdNode::SnapToVertex(Vector v, SMesh *extras) {
 //-----------------------------------------------------------------------------
 // Snap to each vertex of each triangle of the given mesh. If the given mesh
 // is identical to the mesh used to make this kd tree, then the result should
-// be a vertex-to-vertex mesh.
+// be a vertex-to-vertex mesh. SMesh::MakeVertexToVertexInto does that faster;
+// this is kept as the reference to check it against.
 //-----------------------------------------------------------------------------
 void SKdNode::SnapToMesh(SMesh *m) {
     int i, j, k;
@@ -648,6 +933,661 @@ void SKdNode::SnapToMesh(SMesh *m) {
     }
 }
 
+//-----------------------------------------------------------------------------
+// Make an indexed copy of a mesh. Each vertex joins the first one before it
+// that it Equals(), which is what an SPointList would give, but found on a
+// hash grid instead of by a linear search. Normals are shared only when
+// they're exactly equal.
+//-----------------------------------------------------------------------------
+namespace {
+
+struct ExactVectorHash {
+    size_t operator()(const Vector &v) const {
+        std::hash<double> h;
+        size_t r = h(v.x);
+        r ^= h(v.y) + 0x9E3779B97F4A7C15ull + (r << 6) + (r >> 2);
+        r ^= h(v.z) + 0x9E3779B97F4A7C15ull + (r << 6) + (r >> 2);
+        return r;
+    }
+};
+
+struct ExactVectorPred {
+    bool operator()(const Vector &a, const Vector &b) const {
+        return a.EqualsExactly(b);
+    }
+};
+
+}
+
+void SIndexedTriMesh::Clear() {
+    vertex.clear();
+    normal.clear();
+    index.clear();
+    normalIndex.clear();
+    meta.clear();
+}
+
+void SIndexedTriMesh::MakeFromMesh(const SMesh *m) {
+    Clear();
+    index.reserve(3*m->l.n);
+    normalIndex.reserve(3*m->l.n);
+    meta.reserve(m->l.n);
+
+    VertexGrid weld = {};
+    weld.size = 4*LENGTH_EPS;
+    std::unordered_map<Vector, uint32_t, ExactVectorHash, ExactVectorPred> normalMap;
+    std::vector<int> near;
+    for(int i = 0; i < m->l.n; i++) {
+        const STriangle *tr = &(m->l.elem[i]);
+        for(int j = 0; j < 3; j++) {
+            Vector p = tr->vertices[j];
+            Vector r = Vector::From(LENGTH_EPS, LENGTH_EPS, LENGTH_EPS);
+            near.clear();
+            weld.FindInBox(p.Minus(r), p.Plus(r), &near);
+            int found = -1;
+            for(int k : near) {
+                if((found < 0 || k < found) && vertex[k].Equals(p)) found = k;
+            }
+            if(found < 0) {
+                found = (int)vertex.size();
+                vertex.push_back(p);
+                weld.Add(p, found);
+            }
+            index.push_back((uint32_t)found);
+
+            auto it = normalMap.find(tr->normals[j]);
+            if(it == normalMap.end()) {
+                it = normalMap.emplace(tr->normals[j], (uint32_t)normal.size()).first;
+                normal.push_back(tr->normals[j]);
+            }
+            normalIndex.push_back(it->second);
+        }
+        meta.push_back(tr->meta);
+    }
+}
+
+STriangle SIndexedTriMesh::Triangle(size_t i) const {
+    STriangle tr = {};
+    tr.meta = meta[i];
+    for(int j = 0; j < 3; j++) {
+        tr.vertices[j] = vertex[index[3*i + j]];
+        tr.normals[j]  = normal[normalIndex[3*i + j]];
+    }
+    return tr;
+}
+
+Vector SIndexedTriMesh::FaceNormal(size_t i) const {
+    Vector a = vertex[index[3*i + 0]],
+           b = vertex[index[3*i + 1]],
+           c = vertex[index[3*i + 2]];
+    return (b.Minus(a)).Cross(c.Minus(b));
+}
+
+void SIndexedTriMesh::MakeMeshInto(SMesh *m) const {
+    for(size_t i = 0; i < TriangleCount(); i++) {
+        STriangle tr = Triangle(i);
+        m->AddTriangle(&tr);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Find the edges where two triangles meet, with one triangle on each side,
+// and report them as outlines. Since the vertices are shared, the mate of an
+// edge is found by its indices, without any search through the mesh.
+//-----------------------------------------------------------------------------
+void SIndexedTriMesh::MakeOutlinesInto(SOutlineList *sol, EdgeKind edgeKind) const {
+    auto edgeKey = [](uint32_t a, uint32_t b) {
+        return ((uint64_t)a << 32) | (uint64_t)b;
+    };
+
+    // For each directed edge, the first corner where it starts, and the
+    // number of triangles that contain it.
+    struct EdgeUse {
+        uint32_t corner;
+        uint32_t count;
+    };
+    std::unordered_map<uint64_t, EdgeUse> edgeUse;
+    edgeUse.reserve(index.size());
+    for(uint32_t i = 0; i < index.size(); i++) {
+        uint32_t a = index[i], b = index[3*(i/3) + (i + 1)%3];
+        if(a == b) continue;
+        auto it = edgeUse.find(edgeKey(a, b));
+        if(it == edgeUse.end()) {
+            edgeUse.emplace(edgeKey(a, b), EdgeUse { i, 1 });
+        } else {
+            it->second.count++;
+        }
+    }
+
+    std::unordered_set<uint64_t> edgeTris;
+    for(uint32_t i = 0; i < index.size(); i++) {
+        uint32_t t = i/3, j = i%3;
+        uint32_t a = index[i], b = index[3*t + (j + 1)%3];
+        if(a == b) continue;
+
+        auto it = edgeUse.find(edgeKey(b, a));
+        if(it == edgeUse.end() || it->second.count != 1) continue;
+        uint32_t mt = it->second.corner/3,
+                 bi = it->second.corner%3,
+                 ai = (bi + 1)%3;
+        if(!edgeTris.insert(edgeKey(min(t, mt), max(t, mt))).second) continue;
+
+        int tag = 0;
+        switch(edgeKind) {
+            case EdgeKind::EMPHASIZED:
+                if(meta[t].face != meta[mt].face) {
+                    tag = 1;
+                }
+                break;
+
+            case EdgeKind::SHARP: {
+                    Vector na0 = normal[normalIndex[i]].WithMagnitude(1.0);
+                    Vector nb0 = normal[normalIndex[3*t + (j + 1)%3]].WithMagnitude(1.0);
+                    Vector na1 = normal[normalIndex[3*mt + ai]].WithMagnitude(1.0);
+                    Vector nb1 = normal[normalIndex[3*mt + bi]].WithMagnitude(1.0);
+                    if(!((na0.Equals(na1) && nb0.Equals(nb1)) ||
+                         (na0.Equals(nb1) && nb0.Equals(na1)))) {
+                        tag = 1;
+                    }
+                }
+                break;
+
+            default:
+                ssassert(false, "Unexpected edge kind");
+        }
+
+        Vector nl = FaceNormal(t).WithMagnitude(1.0);
+        Vector nr = FaceNormal(mt).WithMagnitude(1.0);
+
+        // We don't add edges with the same left and right
+        // normals because they can't produce outlines.
+        if(tag == 0 && nl.Equals(nr)) continue;
+        sol->AddEdge(vertex[a], vertex[b], nl, nr, tag);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Simplify the mesh by collapsing edges, cheapest first. The cost is the
+// quadric error metric (Garland and Heckbert): the sum of squared distances
+// from the vertex's new position to the planes of the triangles that were
+// merged into it. We collapse each edge onto one of its own endpoints, so the
+// surviving vertices and their normals are all original ones, still exactly
+// on the surface. Feature edges are kept: those on the boundary of the mesh,
+// and those between faces, colors, or discontinuous normals. A vertex on one
+// feature line may slide only along that line, and a vertex where feature
+// lines meet can't move at all. We stop at targetTriangles, or before any
+// collapse that would cost more than maxError (roughly, a distance); zero
+// means no limit for either.
+//-----------------------------------------------------------------------------
+namespace {
+
+// The symmetric 4x4 matrix of a quadric, in the order xx xy xz xw yy yz yw
+// zz zw ww.
+struct Quadric {
+    double m[10];
+
+    static Quadric FromPlane(Vector n, double d) {
+        double w = -d;
+        return { { n.x*n.x, n.x*n.y, n.x*n.z, n.x*w,
+                            n.y*n.y, n.y*n.z, n.y*w,
+                                     n.z*n.z, n.z*w,
+                                              w*w } };
+    }
+
+    void Add(const Quadric &q) {
+        for(int i = 0; i < 10; i++) m[i] += q.m[i];
+    }
+
+    double Evaluate(Vector p) const {
+        double x = p.x, y = p.y, z = p.z;
+        return     m[0]*x*x + 2*m[1]*x*y + 2*m[2]*x*z + 2*m[3]*x
+                 +            m[4]*y*y   + 2*m[5]*y*z + 2*m[6]*y
+                 +                         m[7]*z*z   + 2*m[8]*z
+                 +                                      m[9];
+    }
+};
+
+struct Collapse {
+    double   cost;
+    uint32_t from, to;
+    uint32_t fromStamp, toStamp;
+
+    bool operator<(const Collapse &c) const {
+        // The priority queue gives us the largest first, so reverse this.
+        if(cost != c.cost) return cost > c.cost;
+        if(from != c.from) return from > c.from;
+        return to > c.to;
+    }
+};
+
+}
+
+void SIndexedTriMesh::Decimate(size_t targetTriangles, double maxError) {
+    size_t nv = vertex.size(), nt = TriangleCount();
+    auto edgeKey = [](uint32_t a, uint32_t b) {
+        return ((uint64_t)min(a, b) << 32) | (uint64_t)max(a, b);
+    };
+
+    std::vector<std::vector<uint32_t>> trisAt(nv);
+    for(uint32_t t = 0; t < nt; t++) {
+        for(int j = 0; j < 3; j++) trisAt[index[3*t + j]].push_back(t);
+    }
+
+    // Find the feature edges; an edge that's used other than once in each
+    // direction is on the boundary, or worse, so keep it too.
+    std::unordered_map<uint64_t, std::vector<uint32_t>> edgeCorners;
+    for(uint32_t i = 0; i < 3*nt; i++) {
+        uint32_t a = index[i], b = index[3*(i/3) + (i + 1)%3];
+        edgeCorners[edgeKey(a, b)].push_back(i);
+    }
+    std::unordered_set<uint64_t> feature;
+    for(const auto &it : edgeCorners) {
+        const std::vector<uint32_t> &c = it.second;
+        bool isFeature;
+        if(c.size() != 2 || index[c[0]] == index[c[1]]) {
+            isFeature = true;
+        } else {
+            uint32_t t0 = c[0]/3, t1 = c[1]/3;
+            uint32_t a0 = c[0], b0 = 3*t0 + (c[0] + 1)%3,
+                     a1 = 3*t1 + (c[1] + 1)%3, b1 = c[1];
+            Vector na0 = normal[normalIndex[a0]], nb0 = normal[normalIndex[b0]],
+                   na1 = normal[normalIndex[a1]], nb1 = normal[normalIndex[b1]];
+            isFeature = meta[t0].face != meta[t1].face ||
+                        !meta[t0].color.Equals(meta[t1].color) ||
+                        !(na0.WithMagnitude(1).Equals(na1.WithMagnitude(1)) &&
+                          nb0.WithMagnitude(1).Equals(nb1.WithMagnitude(1)));
+        }
+        if(isFeature) feature.insert(it.first);
+    }
+    edgeCorners.clear();
+    auto isFeature = [&](uint32_t a, uint32_t b) {
+        return feature.find(edgeKey(a, b)) != feature.end();
+    };
+
+    // The quadrics start as the planes of the triangles around each vertex,
+    // plus planes through each feature edge, to keep feature lines in place.
+    std::vector<Quadric> quadric(nv, Quadric {});
+    for(uint32_t t = 0; t < nt; t++) {
+        Vector n = FaceNormal(t);
+        if(n.Magnitude() < LENGTH_EPS*LENGTH_EPS) continue;
+        n = n.WithMagnitude(1);
+        Quadric q = Quadric::FromPlane(n, n.Dot(vertex[index[3*t]]));
+        for(int j = 0; j < 3; j++) {
+            uint32_t a = index[3*t + j], b = index[3*t + (j + 1)%3];
+            quadric[a].Add(q);
+            if(a == b || !isFeature(a, b)) continue;
+            Vector m = (vertex[b].Minus(vertex[a])).Cross(n);
+            if(m.Magnitude() < LENGTH_EPS) continue;
+            m = m.WithMagnitude(1);
+            Quadric qf = Quadric::FromPlane(m, m.Dot(vertex[a]));
+            quadric[a].Add(qf);
+            quadric[b].Add(qf);
+        }
+    }
+
+    std::vector<bool> dead(nt, false);
+    std::vector<uint32_t> stamp(nv, 0);
+    size_t alive = nt;
+
+    auto neighborsOf = [&](uint32_t v, std::vector<uint32_t> *out) {
+        out->clear();
+        for(uint32_t t : trisAt[v]) {
+            for(int j = 0; j < 3; j++) {
+                uint32_t w = index[3*t + j];
+                if(w != v) out->push_back(w);
+            }
+        }
+        std::sort(out->begin(), out->end());
+        out->erase(std::unique(out->begin(), out->end()), out->end());
+    };
+
+    std::priority_queue<Collapse> heap;
+    auto push = [&](uint32_t from, uint32_t to) {
+        Quadric q = quadric[from];
+        q.Add(quadric[to]);
+        heap.push({ max(0.0, q.Evaluate(vertex[to])), from, to, stamp[from], stamp[to] });
+    };
+    std::vector<uint32_t> nu, nw;
+    for(uint32_t v = 0; v < nv; v++) {
+        neighborsOf(v, &nu);
+        for(uint32_t w : nu) push(v, w);
+    }
+
+    // Whether we can collapse from onto to, without moving a feature or
+    // making the mesh non-manifold or folding it over.
+    auto canCollapse = [&](uint32_t from, uint32_t to) {
+        neighborsOf(from, &nu);
+        int featureCount = 0;
+        for(uint32_t w : nu) {
+            if(isFeature(from, w)) featureCount++;
+        }
+        if(featureCount != 0 && !(featureCount == 2 && isFeature(from, to))) {
+            return false;
+        }
+
+        // The vertices that both ends share must be exactly those of the
+        // triangles on the edge, which will go away.
+        neighborsOf(to, &nw);
+        size_t shared = 0, onEdge = 0;
+        for(uint32_t w : nu) {
+            if(std::binary_search(nw.begin(), nw.end(), w)) shared++;
+        }
+        for(uint32_t t : trisAt[from]) {
+            for(int j = 0; j < 3; j++) {
+                if(index[3*t + j] == to) onEdge++;
+            }
+        }
+        if(onEdge == 0 || shared != onEdge) return false;
+
+        for(uint32_t t : trisAt[from]) {
+            Vector p[3];
+            bool hasTo = false;
+            for(int j = 0; j < 3; j++) {
+                uint32_t w = index[3*t + j];
+                if(w == to) hasTo = true;
+                p[j] = (w == from) ? vertex[to] : vertex[w];
+            }
+            if(hasTo) continue;
+            Vector n0 = FaceNormal(t),
+                   n1 = (p[1].Minus(p[0])).Cross(p[2].Minus(p[1]));
+            if(n1.Magnitude() < LENGTH_EPS*LENGTH_EPS) return false;
+            if(n0.WithMagnitude(1).Dot(n1.WithMagnitude(1)) < 0.2) return false;
+        }
+        return true;
+    };
+
+    while(!heap.empty()) {
+        if(targetTriangles > 0 && alive <= targetTriangles) break;
+
+        Collapse c = heap.top();
+        heap.pop();
+        if(c.fromStamp != stamp[c.from] || c.toStamp != stamp[c.to]) continue;
+        if(maxError > 0 && c.cost > maxError*maxError) break;
+        if(!canCollapse(c.from, c.to)) continue;
+
+        uint32_t from = c.from, to = c.to;
+        // Remove the triangles on the edge, and move the others onto to.
+        std::vector<uint32_t> removed;
+        for(uint32_t t : trisAt[from]) {
+            for(int j = 0; j < 3; j++) {
+                if(index[3*t + j] == to) {
+                    dead[t] = true;
+                    removed.push_back(t);
+                    alive--;
+                    break;
+                }
+            }
+        }
+        for(uint32_t t : trisAt[from]) {
+            if(dead[t]) continue;
+            for(int j = 0; j < 3; j++) {
+                if(index[3*t + j] != from) continue;
+                index[3*t + j] = to;
+
+                // Take the normal of to that's closest to the old one, from
+                // a triangle on the same face; that picks the right side of
+                // any sharp edge.
+                Vector n0 = normal[normalIndex[3*t + j]];
+                if(n0.Equals(Vector::From(0, 0, 0))) continue;
+                n0 = n0.WithMagnitude(1);
+                double best = VERY_NEGATIVE;
+                uint32_t bestNormal = normalIndex[3*t + j];
+                for(uint32_t tt : trisAt[to]) {
+                    if(meta[tt].face != meta[t].face) continue;
+                    for(int k = 0; k < 3; k++) {
+                        if(index[3*tt + k] != to) continue;
+                        Vector n = normal[normalIndex[3*tt + k]];
+                        if(n.Equals(Vector::From(0, 0, 0))) continue;
+                        double dot = n.WithMagnitude(1).Dot(n0);
+                        if(dot > best) {
+                            best = dot;
+                            bestNormal = normalIndex[3*tt + k];
+                        }
+                    }
+                }
+                normalIndex[3*t + j] = bestNormal;
+            }
+        }
+        for(uint32_t t : removed) {
+            for(int j = 0; j < 3; j++) {
+                std::vector<uint32_t> &tl = trisAt[index[3*t + j]];
+                tl.erase(std::remove(tl.begin(), tl.end(), t), tl.end());
+            }
+        }
+        for(uint32_t t : trisAt[from]) {
+            if(!dead[t]) trisAt[to].push_back(t);
+        }
+        trisAt[from].clear();
+
+        neighborsOf(to, &nw);
+        for(uint32_t w : nw) {
+            if(isFeature(from, w)) feature.insert(edgeKey(to, w));
+        }
+        quadric[to].Add(quadric[from]);
+        stamp[from]++;
+        stamp[to]++;
+        for(uint32_t w : nw) {
+            push(to, w);
+            push(w, to);
+        }
+    }
+
+    // And drop the dead triangles, and the vertices and normals that are
+    // no longer used.
+    std::vector<uint32_t> vertexMap(nv, UINT32_MAX), normalMap(normal.size(), UINT32_MAX);
+    std::vector<Vector> newVertex, newNormal;
+    std::vector<uint32_t> newIndex, newNormalIndex;
+    std::vector<STriMeta> newMeta;
+    for(uint32_t t = 0; t < nt; t++) {
+        if(dead[t]) continue;
+        for(int j = 0; j < 3; j++) {
+            uint32_t &v = vertexMap[index[3*t + j]];
+            if(v == UINT32_MAX) {
+                v = (uint32_t)newVertex.size();
+                newVertex.push_back(vertex[index[3*t + j]]);
+            }
+            newIndex.push_back(v);
+
+            uint32_t &n = normalMap[normalIndex[3*t + j]];
+            if(n == UINT32_MAX) {
+                n = (uint32_t)newNormal.size();
+                newNormal.push_back(normal[normalIndex[3*t + j]]);
+            }
+            newNormalIndex.push_back(n);
+        }
+        newMeta.push_back(meta[t]);
+    }
+    vertex      = std::move(newVertex);
+    normal      = std::move(newNormal);
+    index       = std::move(newIndex);
+    normalIndex = std::move(newNormalIndex);
+    meta        = std::move(newMeta);
+}
+
+void SMesh::MakeDecimatedInto(SMesh *dest, size_t targetTriangles, double maxError) const {
+    SIndexedTriMesh im = {};
+    im.MakeFromMesh(this);
+    im.Decimate(targetTriangles, maxError);
+    im.MakeMeshInto(dest);
+}
+
+//-----------------------------------------------------------------------------
+// The same thing as building a kd tree from our mesh and snapping that to our
+// mesh, but faster; the kd tree version is kept as the reference. First, weld
+// together vertices that are equal (to within LENGTH_EPS), by making an
+// indexed copy of the mesh. Then, for each distinct edge, find the vertices
+// that lie on it, using a coarser grid. Then split each triangle at the
+// vertices on its edges. Finding and splitting can happen in parallel, and
+// the triangles come out in the order of the triangles that they came from.
+//-----------------------------------------------------------------------------
+namespace {
+
+// A vertex and its normal, as we subdivide a triangle.
+struct Corner {
+    Vector p, n;
+};
+
+// Split the triangle abc at the points on its edges, given in order from the
+// first vertex of each edge to the second. We split the longest edge that
+// has points on it at its middle point, and recurse; that keeps the pieces
+// better shaped than fanning every point from the opposite vertex.
+void SplitTriangleAt(STriMeta meta, Corner a, Corner b, Corner c,
+                     const Corner *ab, int abn, const Corner *bc, int bcn,
+                     const Corner *ca, int can, std::vector<STriangle> *out)
+{
+    double lab = (abn > 0) ? (b.p.Minus(a.p)).MagSquared() : -1,
+           lbc = (bcn > 0) ? (c.p.Minus(b.p)).MagSquared() : -1,
+           lca = (can > 0) ? (a.p.Minus(c.p)).MagSquared() : -1;
+    if(lab < 0 && lbc < 0 && lca < 0) {
+        STriangle tr = STriangle::From(meta, a.p, b.p, c.p);
+        tr.an = a.n;
+        tr.bn = b.n;
+        tr.cn = c.n;
+        out->push_back(tr);
+        return;
+    }
+
+    // Rotate so that we're splitting ab.
+    if(lbc > lab && lbc >= lca) {
+        SplitTriangleAt(meta, b, c, a, bc, bcn, ca, can, ab, abn, out);
+        return;
+    } else if(lca > lab && lca > lbc) {
+        SplitTriangleAt(meta, c, a, b, ca, can, ab, abn, bc, bcn, out);
+        return;
+    }
+
+    int m = abn/2;
+    Corner v = ab[m];
+    SplitTriangleAt(meta, a, v, c, ab, m, NULL, 0, ca, can, out);
+    SplitTriangleAt(meta, v, b, c, ab + m + 1, abn - m - 1, bc, bcn, NULL, 0, out);
+}
+
+}
+
+void SMesh::MakeVertexToVertexInto(SMesh *dest, bool parallel) const {
+    auto forEach = [&](size_t n, const std::function<void(size_t)> &fn) {
+        if(parallel) {
+            ParallelFor(n, fn);
+        } else {
+            for(size_t i = 0; i < n; i++) fn(i);
+        }
+    };
+
+    // Weld the vertices; each one joins the first vertex that it equals.
+    SIndexedTriMesh im = {};
+    im.MakeFromMesh(this);
+    std::vector<Vector> &pt = im.vertex;
+    const std::vector<uint32_t> &vertexOf = im.index;
+    // And move each group of welded vertices to the last one of them, since
+    // that's where snapping to each vertex in turn would leave it.
+    for(int i = 0; i < 3*l.n; i++) {
+        pt[vertexOf[i]] = l.elem[i/3].vertices[i%3];
+    }
+
+    // Then find the distinct edges, and the vertices that lie on them.
+    std::unordered_map<uint64_t, int> edgeIndex;
+    std::vector<std::pair<int, int>> edges;
+    std::vector<int> edgeOf(3*l.n, -1);
+    double totalLength = 0;
+    for(int i = 0; i < 3*l.n; i++) {
+        int va = vertexOf[i], vb = vertexOf[3*(i/3) + (i + 1)%3];
+        if(va == vb) continue;
+        uint64_t key = ((uint64_t)min(va, vb) << 32) | (uint64_t)max(va, vb);
+        auto it = edgeIndex.find(key);
+        if(it == edgeIndex.end()) {
+            it = edgeIndex.emplace(key, (int)edges.size()).first;
+            edges.push_back({ min(va, vb), max(va, vb) });
+            totalLength += (pt[va].Minus(pt[vb])).Magnitude();
+        }
+        edgeOf[i] = it->second;
+    }
+    if(edges.empty()) {
+        for(int i = 0; i < l.n; i++) dest->AddTriangle(&(l.elem[i]));
+        return;
+    }
+
+    VertexGrid grid = {};
+    grid.size = max(totalLength / edges.size(), 10*LENGTH_EPS);
+    for(int i = 0; i < (int)pt.size(); i++) {
+        grid.Add(pt[i], i);
+    }
+    std::vector<std::vector<int>> onEdge(edges.size());
+    forEach(edges.size(), [&](size_t e) {
+        Vector a = pt[edges[e].first], b = pt[edges[e].second];
+        Vector d = b.Minus(a);
+        // Look at pieces of the edge that are no longer than a grid cell,
+        // with their bounding boxes grown by our tolerance.
+        int pieces = (int)ceil(d.Magnitude() / grid.size);
+        Vector r = Vector::From(2*LENGTH_EPS, 2*LENGTH_EPS, 2*LENGTH_EPS);
+        std::vector<int> found;
+        for(int k = 0; k < pieces; k++) {
+            Vector p0 = a.Plus(d.ScaledBy((double)k/pieces)),
+                   p1 = a.Plus(d.ScaledBy((double)(k + 1)/pieces));
+            Vector pmax = p0, pmin = p0;
+            p1.MakeMaxMin(&pmax, &pmin);
+            grid.FindInBox(pmin.Minus(r), pmax.Plus(r), &found);
+        }
+        std::sort(found.begin(), found.end());
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+
+        std::vector<std::pair<double, int>> on;
+        for(int j : found) {
+            Vector p = pt[j];
+            if(p.Equals(a) || p.Equals(b)) continue;
+            if(!p.OnLineSegment(a, b)) continue;
+            on.push_back({ (p.Minus(a)).DivPivoting(d), j });
+        }
+        std::sort(on.begin(), on.end());
+        for(const auto &o : on) {
+            onEdge[e].push_back(o.second);
+        }
+    });
+
+    // And split each triangle at the vertices on its edges.
+    std::vector<std::vector<STriangle>> split(l.n);
+    forEach(l.n, [&](size_t i) {
+        const STriangle *tr = &(l.elem[i]);
+        Corner v[3], *on[3];
+        std::vector<Corner> onList[3];
+        int onn[3];
+        for(int j = 0; j < 3; j++) {
+            v[j] = { pt[vertexOf[3*i + j]], tr->normals[j] };
+        }
+        for(int j = 0; j < 3; j++) {
+            int e = edgeOf[3*i + j];
+            if(e >= 0) {
+                // Interpolate the normals along the edge.
+                Corner a = v[j], b = v[(j + 1)%3];
+                Vector d = b.p.Minus(a.p);
+                for(int k : onEdge[e]) {
+                    double t = (pt[k].Minus(a.p)).DivPivoting(d);
+                    Vector n = a.n.Plus((b.n.Minus(a.n)).ScaledBy(t));
+                    onList[j].push_back({ pt[k], n });
+                }
+                if(edges[e].first != (int)vertexOf[3*i + j]) {
+                    std::reverse(onList[j].begin(), onList[j].end());
+                }
+            }
+            onn[j] = (int)onList[j].size();
+            on[j]  = onn[j] > 0 ? &onList[j][0] : NULL;
+        }
+        if(onn[0] + onn[1] + onn[2] == 0) {
+            STriangle trw = *tr;
+            for(int j = 0; j < 3; j++) trw.vertices[j] = v[j].p;
+            split[i].push_back(trw);
+            return;
+        }
+        SplitTriangleAt(tr->meta, v[0], v[1], v[2],
+                        on[0], onn[0], on[1], onn[1], on[2], onn[2], &split[i]);
+    });
+
+    for(const std::vector<STriangle> &trs : split) {
+        for(const STriangle &tr : trs) {
+            dest->AddTriangle(&tr);
+        }
+    }
+}
+
 //-----------------------------------------------------------------------------
 // For all the edges in sel, split them against the given triangle, and test
 // them for occlusion. sel is both our input and our output. tag indicates
@@ -764,11 +1704,56 @@ void SKdNode::SplitLinesAgainstTriangle(SEdgeList *sel, STriangle *tr) const {
     }
 }
 
+//-----------------------------------------------------------------------------
+// The visited triangles are kept in an open-addressed hash table, where a
+// slot is in use only if it's stamped with the current query; so starting a
+// new query just moves to the next stamp.
+//-----------------------------------------------------------------------------
+void SKdNode::VisitStamps::Begin() {
+    current++;
+    count = 0;
+    if(current == 0) {
+        // Wrapped around, so the old stamps could be mistaken for ours.
+        std::fill(stamp.begin(), stamp.end(), 0);
+        current = 1;
+    }
+}
+
+bool SKdNode::VisitStamps::Visit(const STriangle *tr) {
+    ssassert(current != 0, "Visit() without Begin()");
+    if(2*(count + 1) > tri.size()) {
+        std::vector<const STriangle *> oldTri;
+        std::vector<uint32_t> oldStamp;
+        std::swap(oldTri, tri);
+        std::swap(oldStamp, stamp);
+        tri.resize(max((size_t)64, 2*oldTri.size()));
+        stamp.resize(tri.size());
+        count = 0;
+        for(size_t i = 0; i < oldTri.size(); i++) {
+            if(oldStamp[i] == current) Visit(oldTri[i]);
+        }
+    }
+
+    size_t mask = tri.size() - 1;
+    uint64_t h = (uint64_t)(uintptr_t)tr * 0x9E3779B97F4A7C15ull;
+    for(size_t i = (size_t)(h >> 32) & mask;; i = (i + 1) & mask) {
+        if(stamp[i] != current) {
+            stamp[i] = current;
+            tri[i]   = tr;
+            count++;
+            return true;
+        }
+        if(tri[i] == tr) return false;
+    }
+}
+
 //-----------------------------------------------------------------------------
 // Given an edge orig, occlusion test it against our mesh. We output an edge
-// list in sel, where only invisible portions of the edge are tagged.
+// list in sel, where only invisible portions of the edge are tagged. The
+// caller must Begin() a new query in visited for each edge; nothing in the
+// tree is written, so different edges can be tested concurrently.
 //-----------------------------------------------------------------------------
-void SKdNode::OcclusionTestLine(SEdge orig, SEdgeList *sel, int cnt) const {
+void SKdNode::OcclusionTestLine(SEdge orig, SEdgeList *sel, VisitStamps *visited) const {
     if(gt && lt) {
         double ac = (orig.a).Element(which),
                bc = (orig.b).Element(which);
@@ -778,23 +1763,22 @@ void SKdNode::OcclusionTestLine(SEdge orig, SEdgeList *sel, int cnt) const {
            bc < c + KDTREE_EPS ||
            which == 2)
         {
-            lt->OcclusionTestLine(orig, sel, cnt);
+            lt->OcclusionTestLine(orig, sel, visited);
         }
         if(ac > c - KDTREE_EPS ||
            bc > c - KDTREE_EPS ||
            which == 2)
         {
-            gt->OcclusionTestLine(orig, sel, cnt);
+            gt->OcclusionTestLine(orig, sel, visited);
         }
     } else {
         STriangleLl *ll;
         for(ll = tris; ll; ll = ll->next) {
             STriangle *tr = ll->tri;
 
-            if(tr->tag == cnt) continue;
+            if(!visited->Visit(tr)) continue;
 
             SplitLinesAgainstTriangle(sel, tr);
-            tr->tag = cnt;
         }
     }
 }
@@ -42,12 +42,19 @@ Commands:
     export-wireframe --output <pattern> [--chord-tol <tolerance>]
         Exports a wireframe of the sketch, in a 3d vector format.
     export-mesh --output <pattern> [--chord-tol <tolerance>]
+                [--decimate <triangles>] [--max-error <error>]
         Exports a triangle mesh of solids in the sketch, with exact surfaces
-        being triangulated first.
+        being triangulated first. With --decimate, the mesh is simplified
+        down to at most <triangles> triangles; with --max-error, as far as
+        possible without moving the surface by more than <error> mm. Faces
+        and sharp edges are preserved either way.
     export-surfaces --output <pattern>
         Exports exact surfaces of solids in the sketch, if any.
-    regenerate
-        Reloads all imported files, regenerates the sketch, and saves it.
+    regenerate [--output <pattern>]
+        Reloads all imported files, regenerates the sketch, and saves it;
+        by default, over the input file. The format of the output file
+        follows its extension, so this also converts between the text
+        and binary formats.
 )");
 
     auto FormatListFromFileFilter = [](const FileFilter *filter) {
@@ -76,11 +83,13 @@ File formats:
     export-wireframe:%s
     export-mesh:%s
     export-surfaces:%s
+    regenerate:%s
 )", FormatListFromFileFilter(RasterFileFilter).c_str(),
     FormatListFromFileFilter(VectorFileFilter).c_str(),
     FormatListFromFileFilter(Vector3dFileFilter).c_str(),
     FormatListFromFileFilter(MeshFileFilter).c_str(),
-    FormatListFromFileFilter(SurfaceFileFilter).c_str());
+    FormatListFromFileFilter(SurfaceFileFilter).c_str(),
+    FormatListFromFileFilter(SlvsFileFilter).c_str());
 }
 
 static bool RunCommand(const std::vector<std::string> args) {
@@ -159,6 +168,8 @@ static bool RunCommand(const std::vector<std::string> args) {
     };
 
     unsigned width = 0, height = 0;
+    int decimateTriangles = 0;
+    double decimateError = 0.0;
     if(args[1] == "thumbnail") {
         auto ParseSize = [&](size_t &argn) {
             if(argn + 1 < args.size() && args[argn] == "--size") {
@@ -241,17 +252,34 @@ static bool RunCommand(const std::vector<std::string> args) {
             SS.ExportViewOrWireframeTo(output, /*exportWireframe=*/true);
         };
     } else if(args[1] == "export-mesh") {
+        auto ParseDecimation = [&](size_t &argn) {
+            if(argn + 1 < args.size() && args[argn] == "--decimate") {
+                argn++;
+                if(sscanf(args[argn].c_str(), "%d", &decimateTriangles) == 1) {
+                    return true;
+                } else return false;
+            } else if(argn + 1 < args.size() && args[argn] == "--max-error") {
+                argn++;
+                if(sscanf(args[argn].c_str(), "%lf", &decimateError) == 1) {
+                    return true;
+                } else return false;
+            } else return false;
+        };
+
         for(size_t argn = 2; argn < args.size(); argn++) {
             if(!(ParseInputFile(argn) ||
                  ParseOutputPattern(argn) ||
-                 ParseChordTolerance(argn))) {
+                 ParseChordTolerance(argn) ||
+                 ParseDecimation(argn))) {
                 fprintf(stderr, "Unrecognized option '%s'.\n", args[argn].c_str());
                 return false;
             }
         }
 
         runner = [&](const Platform::Path &output) {
-            SS.exportChordTol = chordTol;
+            SS.exportChordTol          = chordTol;
+            SS.exportDecimateTriangles = decimateTriangles;
+            SS.exportDecimateError     = decimateError;
 
             SS.ExportMeshTo(output);
         };
@@ -269,15 +297,16 @@ static bool RunCommand(const std::vector<std::string> args) {
             sfw.ExportSurfacesTo(output);
         };
     } else if(args[1] == "regenerate") {
+        outputPattern = "%.slvs";
+
         for(size_t argn = 2; argn < args.size(); argn++) {
-            if(!(ParseInputFile(argn))) {
+            if(!(ParseInputFile(argn) ||
+                 ParseOutputPattern(argn))) {
                 fprintf(stderr, "Unrecognized option '%s'.\n", args[argn].c_str());
                 return false;
             }
         }
 
-        outputPattern = "%.slvs";
-
         runner = [&](const Platform::Path &output) {
             SS.SaveToFile(output);
         };
@@ -16,7 +16,9 @@
 #   include <windows.h>
 #else
 #   include <unistd.h>
+#   include <fcntl.h>
 #   include <sys/stat.h>
+#   include <sys/mman.h>
 #endif
 
 namespace SolveSpace {
@@ -415,6 +417,43 @@ void RemoveFile(const Platform::Path &filename) {
 #endif
 }
 
+bool RenameFile(const Platform::Path &from, const Platform::Path &to) {
+    ssassert(from.raw.length() == strlen(from.raw.c_str()) &&
+             to.raw.length() == strlen(to.raw.c_str()),
+             "Unexpected null byte in middle of a path");
+#if defined(WIN32)
+    return MoveFileExW(Widen(from.Expand().raw).c_str(), Widen(to.Expand().raw).c_str(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from.raw.c_str(), to.raw.c_str()) == 0;
+#endif
+}
+
+bool GetFileStatus(const Platform::Path &filename, uint64_t *size, int64_t *mtime) {
+    ssassert(filename.raw.length() == strlen(filename.raw.c_str()),
+             "Unexpected null byte in middle of a path");
+#if defined(WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA attrs;
+    if(!GetFileAttributesExW(Widen(filename.Expand().raw).c_str(),
+                             GetFileExInfoStandard, &attrs)) {
+        return false;
+    }
+    *size  = ((uint64_t)attrs.nFileSizeHigh << 32) | attrs.nFileSizeLow;
+    *mtime = (int64_t)(((uint64_t)attrs.ftLastWriteTime.dwHighDateTime << 32) |
+                       attrs.ftLastWriteTime.dwLowDateTime);
+#else
+    struct stat st;
+    if(stat(filename.raw.c_str(), &st) != 0) return false;
+    *size  = (uint64_t)st.st_size;
+#if defined(__APPLE__)
+    *mtime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    *mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+    return true;
+}
+
 bool ReadFile(const Platform::Path &filename, std::string *data) {
     FILE *f = OpenFile(filename, "rb");
     if(f == NULL) return false;
@@ -438,6 +477,77 @@ bool WriteFile(const Platform::Path &filename, const std::string &data) {
     return true;
 }
 
+bool MappedFile::Map(const Platform::Path &filename) {
+    ssassert(filename.raw.length() == strlen(filename.raw.c_str()),
+             "Unexpected null byte in middle of a path");
+    data = NULL;
+    size = 0;
+#if defined(WIN32)
+    HANDLE file = CreateFileW(Widen(filename.Expand().raw).c_str(), GENERIC_READ,
+                              FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+    size = (size_t)fileSize.QuadPart;
+    if(size == 0) {
+        // Empty files can't be mapped.
+        CloseHandle(file);
+        data = "";
+        return true;
+    }
+
+    // The view keeps the file open by itself.
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if(mapping == NULL) return false;
+    data = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+#else
+    int fd = open(filename.raw.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    size = (size_t)st.st_size;
+    if(size == 0) {
+        // Empty files can't be mapped.
+        close(fd);
+        data = "";
+        return true;
+    }
+
+    // The mapping keeps the file open by itself.
+    void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    data = (mapping != MAP_FAILED) ? (const char *)mapping : NULL;
+#endif
+    if(data == NULL) {
+        size = 0;
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::Unmap() {
+    if(size > 0) {
+#if defined(WIN32)
+        UnmapViewOfFile(data);
+#else
+        munmap((void *)data, size);
+#endif
+    }
+    data = NULL;
+    size = 0;
+}
+
 //-----------------------------------------------------------------------------
 // Loading resources, on Windows.
 //-----------------------------------------------------------------------------
@@ -59,6 +59,22 @@ FILE *OpenFile(const Platform::Path &filename, const char *mode);
 bool ReadFile(const Platform::Path &filename, std::string *data);
 bool WriteFile(const Platform::Path &filename, const std::string &data);
 void RemoveFile(const Platform::Path &filename);
+// Replaces the destination, if any, in a single step.
+bool RenameFile(const Platform::Path &from, const Platform::Path &to);
+// The size and modification time of a file, the time being as precise as the
+// file system keeps it; it's only good for comparing against another time
+// from this function.
+bool GetFileStatus(const Platform::Path &filename, uint64_t *size, int64_t *mtime);
+
+// A whole file, memory-mapped read-only.
+class MappedFile {
+public:
+    const char *data;
+    size_t      size;
+
+    bool Map(const Platform::Path &filename);
+    void Unmap();
+};
 
 // Resource loading function.
 const void *LoadResource(const std::string &name, size_t *size);
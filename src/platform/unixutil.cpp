@@ -64,21 +64,25 @@ typedef struct _AllocTempHeader {
 } AllocTempHeader;
 
 static AllocTempHeader *Head = NULL;
+static std::mutex HeadMutex;
 
 void *AllocTemporary(size_t n)
 {
     AllocTempHeader *h =
         (AllocTempHeader *)malloc(n + sizeof(AllocTempHeader));
+    memset(&h[1], 0, n);
+
+    std::lock_guard<std::mutex> lock(HeadMutex);
     h->prev = NULL;
     h->next = Head;
     if(Head) Head->prev = h;
     Head = h;
-    memset(&h[1], 0, n);
     return (void *)&h[1];
 }
 
 void FreeTemporary(void *p)
 {
+    std::lock_guard<std::mutex> lock(HeadMutex);
     AllocTempHeader *h = (AllocTempHeader *)p - 1;
     if(h->prev) {
         h->prev->next = h->next;
@@ -91,6 +95,7 @@ void FreeTemporary(void *p)
 
 void FreeAllTemporary(void)
 {
+    std::lock_guard<std::mutex> lock(HeadMutex);
     AllocTempHeader *h = Head;
     while(h) {
         AllocTempHeader *f = h;
@@ -120,6 +120,15 @@ SEdge SEdge::From(Vector a, Vector b) {
 }
 
 bool SEdge::EdgeCrosses(Vector ea, Vector eb, Vector *ppi, SPointList *spl) const {
+    // Any intersection found below lies within LENGTH_EPS of both edges, so
+    // edges with well-separated bounding boxes can be rejected cheaply.
+    for(int i = 0; i < 3; i++) {
+        double e0 = ea.Element(i), e1 = eb.Element(i),
+               t0 = a.Element(i),  t1 = b.Element(i);
+        if(max(e0, e1) < min(t0, t1) - 4*LENGTH_EPS) return false;
+        if(min(e0, e1) > max(t0, t1) + 4*LENGTH_EPS) return false;
+    }
+
     Vector d = eb.Minus(ea);
     double t_eps = LENGTH_EPS/d.Magnitude();
 
@@ -307,8 +316,27 @@ int SEdgeList::AnyEdgeCrossings(Vector a, Vector b,
 // an endpoint with one of our edges.
 //-----------------------------------------------------------------------------
 bool SEdgeList::ContainsEdgeFrom(const SEdgeList *sel) const {
+    // Sort the other edges by the lesser x coordinate of their endpoints, so
+    // that we need only test the few with an x coordinate close to ours.
+    std::vector<std::pair<double, const SEdge *>> sorted;
+    for(const SEdge &se : sel->l) {
+        sorted.emplace_back(min(se.a.x, se.b.x), &se);
+    }
+    auto byX = [](const std::pair<double, const SEdge *> &a,
+                  const std::pair<double, const SEdge *> &b) {
+        return a.first < b.first;
+    };
+    std::sort(sorted.begin(), sorted.end(), byX);
+
     for(const SEdge *se = l.First(); se; se = l.NextAfter(se)) {
-        if(sel->ContainsEdge(se)) return true;
+        double x = min(se->a.x, se->b.x);
+        auto it = std::lower_bound(sorted.begin(), sorted.end(),
+            std::make_pair(x - 2*LENGTH_EPS, se), byX);
+        for(; it != sorted.end() && it->first <= x + 2*LENGTH_EPS; ++it) {
+            const SEdge *set = it->second;
+            if((se->a).Equals(set->a) && (se->b).Equals(set->b)) return true;
+            if((se->b).Equals(set->a) && (se->a).Equals(set->b)) return true;
+        }
     }
     return false;
 }
@@ -481,21 +509,13 @@ int SKdNodeEdges::AnyEdgeCrossings(Vector a, Vector b, int cnt,
 // We have an edge list that contains only collinear edges, maybe with more
 // splits than necessary. Merge any collinear segments that join.
 //-----------------------------------------------------------------------------
-static Vector LineStart, LineDirection;
-static int ByTAlongLine(const void *av, const void *bv)
-{
-    SEdge *a = (SEdge *)av,
-          *b = (SEdge *)bv;
-
-    double ta = (a->a.Minus(LineStart)).DivPivoting(LineDirection),
-           tb = (b->a.Minus(LineStart)).DivPivoting(LineDirection);
-
-    return (ta > tb) ? 1 : -1;
-}
 void SEdgeList::MergeCollinearSegments(Vector a, Vector b) {
-    LineStart = a;
-    LineDirection = b.Minus(a);
-    qsort(l.elem, l.n, sizeof(l.elem[0]), ByTAlongLine);
+    Vector lineDirection = b.Minus(a);
+    std::stable_sort(l.begin(), l.end(), [&](const SEdge &ea, const SEdge &eb) {
+        double ta = (ea.a.Minus(a)).DivPivoting(lineDirection),
+               tb = (eb.a.Minus(a)).DivPivoting(lineDirection);
+        return ta < tb;
+    });
 
     l.ClearTags();
     int i;
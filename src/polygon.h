@@ -35,6 +35,53 @@ enum class EdgeKind : uint32_t {
     SHARP                = 500,
 };
 
+// Points hashed into a grid of cubes, to find the ones near a given point.
+class VertexGrid {
+public:
+    struct Cell {
+        int64_t x, y, z;
+
+        bool operator==(const Cell &c) const {
+            return x == c.x && y == c.y && z == c.z;
+        }
+    };
+    struct CellHash {
+        size_t operator()(const Cell &c) const {
+            uint64_t h = (uint64_t)c.x * 0x9E3779B97F4A7C15ull;
+            h ^= (uint64_t)c.y + 0x7F4A7C159E3779B9ull + (h << 6) + (h >> 2);
+            h ^= (uint64_t)c.z + 0x94D049BB133111EBull + (h << 6) + (h >> 2);
+            return (size_t)h;
+        }
+    };
+
+    double                                               size;
+    std::unordered_map<Cell, std::vector<int>, CellHash> cells;
+
+    Cell CellFor(Vector p) const {
+        return { (int64_t)floor(p.x/size),
+                 (int64_t)floor(p.y/size),
+                 (int64_t)floor(p.z/size) };
+    }
+
+    void Add(Vector p, int i) {
+        cells[CellFor(p)].push_back(i);
+    }
+
+    // Everything in the cells that touch the box from pmin to pmax.
+    void FindInBox(Vector pmin, Vector pmax, std::vector<int> *out) const {
+        Cell cmin = CellFor(pmin), cmax = CellFor(pmax);
+        for(int64_t x = cmin.x; x <= cmax.x; x++) {
+            for(int64_t y = cmin.y; y <= cmax.y; y++) {
+                for(int64_t z = cmin.z; z <= cmax.z; z++) {
+                    auto it = cells.find({ x, y, z });
+                    if(it == cells.end()) continue;
+                    out->insert(out->end(), it->second.begin(), it->second.end());
+                }
+            }
+        }
+    }
+};
+
 class SEdge {
 public:
     int    tag;
@@ -132,7 +179,9 @@ public:
     Vector AnyEdgeMidpoint() const;
 
     bool IsEar(int bp, double scaledEps) const;
-    bool BridgeToContour(SContour *sc, SEdgeList *el, List<Vector> *vl);
+    bool SharesPointWith(const SContour *sc) const;
+    bool BridgeToContour(SContour *sc, SKdNodeEdges *kd, int *kdCnt,
+                         SEdgeList *el, List<Vector> *vl);
     void ClipEarInto(SMesh *m, int bp, double scaledEps);
     void UvTriangulateInto(SMesh *m, SSurface *srf);
 };
@@ -229,7 +278,7 @@ public:
     SBsp2       *edges;
 
     static SBsp3 *Alloc();
-    static SBsp3 *FromMesh(const SMesh *m);
+    static SBsp3 *FromMesh(const SMesh *m, bool ordered = true);
 
     Vector IntersectionWith(Vector a, Vector b) const;
 
@@ -265,7 +314,7 @@ public:
 
     void Simplify(int start);
 
-    void AddAgainstBsp(SMesh *srcm, SBsp3 *bsp3);
+    void AddAgainstBsp(SMesh *srcm, SBsp3 *bsp3, bool parallel = true);
     void MakeFromUnionOf(SMesh *a, SMesh *b);
     void MakeFromDifferenceOf(SMesh *a, SMesh *b);
 
@@ -279,6 +328,8 @@ public:
 
     void PrecomputeTransparency();
     void RemoveDegenerateTriangles();
+    void MakeVertexToVertexInto(SMesh *dest, bool parallel = true) const;
+    void MakeDecimatedInto(SMesh *dest, size_t targetTriangles, double maxError) const;
 
     bool IsEmpty() const;
     void RemapFaces(Group *g, int remap);
@@ -288,6 +339,30 @@ public:
     Vector GetCenterOfMass() const;
 };
 
+// The same triangles as an SMesh, but with each distinct vertex (to within
+// LENGTH_EPS) and each distinct normal stored once, and referenced by index
+// from the triangles. The vertices come in the order that they first appear,
+// at the position where they first appear.
+class SIndexedTriMesh {
+public:
+    std::vector<Vector>     vertex;
+    std::vector<Vector>     normal;
+    std::vector<uint32_t>   index;          // three vertices per triangle
+    std::vector<uint32_t>   normalIndex;    // three normals per triangle
+    std::vector<STriMeta>   meta;           // one per triangle
+
+    void Clear();
+    void MakeFromMesh(const SMesh *m);
+    void MakeMeshInto(SMesh *m) const;
+
+    size_t TriangleCount() const { return meta.size(); }
+    STriangle Triangle(size_t i) const;
+    Vector FaceNormal(size_t i) const;
+
+    void MakeOutlinesInto(SOutlineList *sol, EdgeKind type) const;
+    void Decimate(size_t targetTriangles, double maxError);
+};
+
 // A linked list of triangles
 class STriangleLl {
 public:
@@ -328,6 +403,31 @@ public:
         int        bi;
     };
 
+    struct Stats {
+        int        nodes;
+        int        leaves;
+        int        emptyLeaves;
+        int        maxDepth;
+        int        maxLeafSize;
+        int        triangles;   // distinct triangles in the tree
+        int        references;  // triangles in all leaves, with duplicates
+    };
+
+    // The triangles that a query has visited so far, since a triangle can
+    // be in more than one leaf. Each query keeps its own, so that queries can
+    // run concurrently without tagging the tree's triangles. Begin() starts a
+    // new query; the stamps mean that nothing needs to be cleared for that.
+    class VisitStamps {
+    public:
+        std::vector<const STriangle *> tri;
+        std::vector<uint32_t>          stamp;
+        uint32_t                       current;
+        size_t                         count;
+
+        void Begin();
+        bool Visit(const STriangle *tr);
+    };
+
     int which;  // whether c is x, y, or z
     double c;
 
@@ -344,13 +444,15 @@ public:
     void MakeMeshInto(SMesh *m) const;
     void ListTrianglesInto(std::vector<STriangle *> *tl) const;
     void ClearTags() const;
+    Stats GetStats() const;
+    void AddStatsTo(Stats *stats, std::unordered_set<STriangle *> *seen, int depth) const;
 
     void FindEdgeOn(Vector a, Vector b, int cnt, bool coplanarIsInter, EdgeOnInfo *info) const;
     void MakeCertainEdgesInto(SEdgeList *sel, EdgeKind how, bool coplanarIsInter,
                               bool *inter, bool *leaky, int auxA = 0) const;
     void MakeOutlinesInto(SOutlineList *sel, EdgeKind tagKind) const;
 
-    void OcclusionTestLine(SEdge orig, SEdgeList *sel, int cnt) const;
+    void OcclusionTestLine(SEdge orig, SEdgeList *sel, VisitStamps *visited) const;
     void SplitLinesAgainstTriangle(SEdgeList *sel, STriangle *tr) const;
 
     void SnapToMesh(SMesh *m);
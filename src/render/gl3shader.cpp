@@ -223,6 +223,14 @@ void MeshRenderer::Init() {
     fillShader.SetUniformTextureUnit("texture", 0);
 
     selectedShader = &lightShader;
+
+    // GLES2 only has 16-bit indices, unless this extension is there.
+#if defined(HAVE_GLES)
+    const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+    wideIndices = extensions && strstr(extensions, "GL_OES_element_index_uint");
+#else
+    wideIndices = true;
+#endif
 }
 
 void MeshRenderer::Clear() {
@@ -231,43 +239,98 @@ void MeshRenderer::Clear() {
 }
 
 MeshRenderer::Handle MeshRenderer::Add(const SMesh &m, bool dynamic) {
-    Handle handle;
-    glGenBuffers(1, &handle.vertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, handle.vertexBuffer);
-
-    MeshVertex *vertices = new MeshVertex[m.l.n * 3];
-    for(int i = 0; i < m.l.n; i++) {
-        const STriangle &t = m.l.elem[i];
-        vertices[i * 3 + 0].pos = Vector3f::From(t.a);
-        vertices[i * 3 + 1].pos = Vector3f::From(t.b);
-        vertices[i * 3 + 2].pos = Vector3f::From(t.c);
-
-        if(t.an.EqualsExactly(Vector::From(0, 0, 0))) {
-            Vector3f normal = Vector3f::From(t.Normal());
-            vertices[i * 3 + 0].nor = normal;
-            vertices[i * 3 + 1].nor = normal;
-            vertices[i * 3 + 2].nor = normal;
-        } else {
-            vertices[i * 3 + 0].nor = Vector3f::From(t.an);
-            vertices[i * 3 + 1].nor = Vector3f::From(t.bn);
-            vertices[i * 3 + 2].nor = Vector3f::From(t.cn);
+    // Triangles share a vertex wherever its position, normal and color all
+    // match; triangles without vertex normals get their own vertices, with
+    // the normal of the face.
+    SIndexedTriMesh im = {};
+    im.MakeFromMesh(&m);
+
+    struct VertexKey {
+        uint32_t vertex;
+        uint32_t normal;
+        uint32_t color;
+        uint32_t triangle;
+
+        bool operator==(const VertexKey &k) const {
+            return vertex == k.vertex && normal == k.normal &&
+                   color == k.color && triangle == k.triangle;
         }
-
+    };
+    struct VertexKeyHash {
+        size_t operator()(const VertexKey &k) const {
+            uint64_t h = (uint64_t)k.vertex * 0x9E3779B97F4A7C15ull;
+            h ^= (uint64_t)k.normal   + 0x7F4A7C159E3779B9ull + (h << 6) + (h >> 2);
+            h ^= (uint64_t)k.color    + 0x94D049BB133111EBull + (h << 6) + (h >> 2);
+            h ^= (uint64_t)k.triangle + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+            return (size_t)h;
+        }
+    };
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertexFor;
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    vertexFor.reserve(im.vertex.size());
+    vertices.reserve(im.vertex.size());
+    indices.reserve(im.index.size());
+    for(size_t i = 0; i < im.TriangleCount(); i++) {
+        bool flat = im.normal[im.normalIndex[3*i]].EqualsExactly(Vector::From(0, 0, 0));
+        RgbaColor color = im.meta[i].color;
         for(int j = 0; j < 3; j++) {
-            vertices[i * 3 + j].col = Vector4f::From(t.meta.color);
+            VertexKey key = { im.index[3*i + j], im.normalIndex[3*i + j],
+                              color.ToPackedInt(), flat ? (uint32_t)i : UINT32_MAX };
+            auto it = vertexFor.find(key);
+            if(it == vertexFor.end()) {
+                MeshVertex mv;
+                mv.pos = Vector3f::From(im.vertex[key.vertex]);
+                mv.nor = Vector3f::From(flat ? im.FaceNormal(i) : im.normal[key.normal]);
+                mv.col = Vector4f::From(color);
+                it = vertexFor.emplace(key, (uint32_t)vertices.size()).first;
+                vertices.push_back(mv);
+            }
+            indices.push_back(it->second);
         }
+    }
 
+    Handle handle = {};
+    glGenBuffers(1, &handle.vertexBuffer);
+    handle.size = indices.size();
+
+    GLenum mode = dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
+    glBindBuffer(GL_ARRAY_BUFFER, handle.vertexBuffer);
+    if(vertices.size() > 0x10000 && !wideIndices) {
+        // Too many vertices to index with 16 bits, and that's all we have;
+        // so give each triangle its own vertices, as without indices.
+        std::vector<MeshVertex> unshared;
+        unshared.reserve(indices.size());
+        for(uint32_t i : indices) {
+            unshared.push_back(vertices[i]);
+        }
+        glBufferData(GL_ARRAY_BUFFER, unshared.size() * sizeof(MeshVertex),
+                     unshared.data(), mode);
+        return handle;
     }
-    glBufferData(GL_ARRAY_BUFFER, m.l.n * 3 * sizeof(MeshVertex),
-                 vertices, dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
-    handle.size = m.l.n * 3;
-    delete []vertices;
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex),
+                 vertices.data(), mode);
 
+    glGenBuffers(1, &handle.indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, handle.indexBuffer);
+    if(vertices.size() <= 0x10000) {
+        std::vector<uint16_t> narrow(indices.begin(), indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, narrow.size() * sizeof(uint16_t),
+                     narrow.data(), mode);
+        handle.indexType = GL_UNSIGNED_SHORT;
+    } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t),
+                     indices.data(), mode);
+        handle.indexType = GL_UNSIGNED_INT;
+    }
     return handle;
 }
 
 void MeshRenderer::Remove(const MeshRenderer::Handle &handle) {
     glDeleteBuffers(1, &handle.vertexBuffer);
+    if(handle.indexBuffer != 0) {
+        glDeleteBuffers(1, &handle.indexBuffer);
+    }
 }
 
 void MeshRenderer::Draw(const MeshRenderer::Handle &handle,
@@ -293,7 +356,12 @@ void MeshRenderer::Draw(const MeshRenderer::Handle &handle,
         }
     }
 
-    glDrawArrays(GL_TRIANGLES, 0, handle.size);
+    if(handle.indexBuffer != 0) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, handle.indexBuffer);
+        glDrawElements(GL_TRIANGLES, handle.size, handle.indexType, NULL);
+    } else {
+        glDrawArrays(GL_TRIANGLES, 0, handle.size);
+    }
 
     glDisableVertexAttribArray(ATTRIB_POS);
     if(selectedShader == &lightShader) {
@@ -302,6 +370,7 @@ void MeshRenderer::Draw(const MeshRenderer::Handle &handle,
     }
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
     selectedShader->Disable();
 }
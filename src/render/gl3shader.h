@@ -99,12 +99,15 @@ public:
 
     struct Handle {
         GLuint      vertexBuffer;
+        GLuint      indexBuffer; // or 0, when the vertices aren't shared
+        GLenum      indexType;
         GLsizei     size;
     };
 
     Shader  lightShader;
     Shader  fillShader;
     Shader *selectedShader;
+    bool    wideIndices;
 
     void Init();
     void Clear();
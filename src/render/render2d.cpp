@@ -262,9 +262,8 @@ void SurfaceRenderer::CullOccludedStrokes() {
 
     // Remove hidden lines (on NORMAL layers), or remove visible lines (on OCCLUDED layers).
     SKdNode *root = SKdNode::From(&mesh);
-    root->ClearTags();
 
-    int cnt = 1234;
+    SKdNode::VisitStamps visited = {};
     for(auto &eit : edges) {
         hStroke hcs = eit.first;
         SEdgeList &el = eit.second;
@@ -277,7 +276,8 @@ void SurfaceRenderer::CullOccludedStrokes() {
         for(const SEdge &e : el.l) {
             SEdgeList oel = {};
             oel.AddEdge(e.a, e.b);
-            root->OcclusionTestLine(e, &oel, cnt);
+            visited.Begin();
+            root->OcclusionTestLine(e, &oel, &visited);
 
             if(stroke->layer == Layer::OCCLUDED) {
                 for(SEdge &oe : oel.l) {
@@ -292,7 +292,6 @@ void SurfaceRenderer::CullOccludedStrokes() {
             }
 
             oel.Clear();
-            cnt++;
         }
 
         el.l.Clear();
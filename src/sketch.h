@@ -195,6 +195,8 @@ public:
     }               polyError;
 
     bool            booleanFailed;
+    // Taken from the file's regeneration cache, instead of generated.
+    bool            regenCached;
 
     SShell          thisShell;
     SShell          runningShell;
@@ -205,6 +207,12 @@ public:
     bool            displayDirty;
     SMesh           displayMesh;
     SOutlineList    displayOutlines;
+    enum { DISPLAY_LOD_LEVELS = 8 };
+    // Built the first time they're needed, for the display mesh with this hash.
+    uint64_t        displayLodHash;
+    bool            displayLodBuilt;
+    SMesh           displayLodMesh[DISPLAY_LOD_LEVELS];
+    double          displayLodError[DISPLAY_LOD_LEVELS];
 
     enum class CombineAs : uint32_t {
         UNION           = 0,
@@ -213,13 +221,15 @@ public:
     };
     CombineAs meshCombine;
 
-    bool forceToMesh;
+    // Saved as an integer, so it has to be as wide as one.
+    int forceToMesh;
 
     IdList<EntityMap,EntityId> remap;
     enum { REMAP_PRIME = 19477 };
     int remapCache[REMAP_PRIME];
 
     Platform::Path linkFile;
+    int         linkMeshOnly; // and faces, and the entities in use
     SMesh       impMesh;
     SShell      impShell;
     EntityList  impEntity;
@@ -282,9 +292,12 @@ public:
     template<class T> void GenerateForStepAndRepeat(T *steps, T *outs, Group::CombineAs forWhat);
     template<class T> void GenerateForBoolean(T *a, T *b, T *o, Group::CombineAs how);
     void GenerateDisplayItems();
+    void GenerateDisplayLods();
+    void ClearDisplayLods();
 
     enum class DrawMeshAs { DEFAULT, HOVERED, SELECTED };
     void DrawMesh(DrawMeshAs how, Canvas *canvas);
+    const SMesh *DisplayMeshFor(const Camera &camera);
     void Draw(Canvas *canvas);
     void DrawPolyError(Canvas *canvas);
     void DrawFilledPaths(Canvas *canvas);
@@ -73,6 +73,8 @@ void SolveSpaceUI::Init() {
     checkClosedContour = CnfThawBool(true, "CheckClosedContour");
     // Draw closed polygons areas
     showContourAreas = CnfThawBool(false, "ShowContourAreas");
+    // Save the last group's geometry with hashes, to skip regenerating on load
+    saveRegenCache = CnfThawBool(false, "SaveRegenCache");
     // Export shaded triangles in a 2d view
     exportShadedTriangles = CnfThawBool(true, "ExportShadedTriangles");
     // Export pwl curves (instead of exact) always
@@ -153,6 +155,8 @@ bool SolveSpaceUI::Load(const Platform::Path &filename) {
 }
 
 void SolveSpaceUI::Exit() {
+    WaitForAutosave();
+
     // Recent files
     for(size_t i = 0; i < MAX_RECENT; i++)
         CnfFreezeString(RecentFile[i].raw, "RecentFile_" + std::to_string(i));
@@ -199,6 +203,8 @@ void SolveSpaceUI::Exit() {
     CnfFreezeBool(showContourAreas, "ShowContourAreas");
     // Check that contours are closed and not self-intersecting
     CnfFreezeBool(checkClosedContour, "CheckClosedContour");
+    // Save the last group's geometry with hashes, to skip regenerating on load
+    CnfFreezeBool(saveRegenCache, "SaveRegenCache");
     // Export shaded triangles in a 2d view
     CnfFreezeBool(exportShadedTriangles, "ExportShadedTriangles");
     // Export pwl curves (instead of exact) always
@@ -442,14 +448,37 @@ bool SolveSpaceUI::Autosave()
 {
     SetAutosaveTimerFor(autosaveInterval);
 
-    if(!saveFile.IsEmpty() && unsaved)
-        return SaveToFile(saveFile.WithExtension(AUTOSAVE_EXT));
+    if(saveFile.IsEmpty() || !unsaved)
+        return false;
 
-    return false;
+    Platform::Path autosaveFile = saveFile.WithExtension(AUTOSAVE_EXT);
+    for(Group &g : SK.group) {
+        if(g.type != Group::Type::LINKED) continue;
+        if(g.linkFile.RelativeTo(autosaveFile).IsEmpty()) return false;
+    }
+
+    // Take a snapshot of the sketch, which shares nearly everything with the
+    // undo history and so is cheap, and write it out in the background,
+    // without regenerating anything first.
+    WaitForAutosave();
+    std::shared_ptr<UndoState> ut = std::make_shared<UndoState>();
+    UndoRememberState(ut.get());
+    autosaveThread = std::thread([=] {
+        SaveStateTo(*ut, autosaveFile);
+    });
+    return true;
+}
+
+void SolveSpaceUI::WaitForAutosave()
+{
+    if(autosaveThread.joinable()) {
+        autosaveThread.join();
+    }
 }
 
 void SolveSpaceUI::RemoveAutosave()
 {
+    WaitForAutosave();
     Platform::Path autosaveFile = saveFile.WithExtension(AUTOSAVE_EXT);
     RemoveFile(autosaveFile);
 }
@@ -919,10 +948,16 @@ void SolveSpaceUI::MenuHelp(Command id) {
 
 void SolveSpaceUI::Clear() {
     sys.Clear();
+    WaitForAutosave();
+    while(!linkedFiles.empty()) {
+        ForgetLinkedFile(linkedFiles.begin()->first);
+    }
     for(int i = 0; i < MAX_UNDO; i++) {
         if(i < undo.cnt) undo.d[i].Clear();
         if(i < redo.cnt) redo.d[i].Clear();
     }
+    undoLast.Clear();
+    SSurface::ClearTriangulationCache();
 }
 
 void Sketch::Clear() {
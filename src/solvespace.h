@@ -30,6 +30,10 @@
 #include <set>
 #include <chrono>
 #include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 #define EIGEN_NO_DEBUG
 #include "SparseCore"
@@ -94,6 +98,8 @@ void assert_failure(const char *file, unsigned line, const char *function,
 __attribute__((__format__ (__printf__, 1, 2)))
 #endif
 std::string ssprintf(const char *fmt, ...);
+void FormatFixedInto(std::string *dest, double v, int precision);
+void FormatUnsignedInto(std::string *dest, uint64_t v);
 
 inline int WRAP(int v, int n) {
     // Clamp it to the range [0, n)
@@ -197,6 +203,7 @@ void GetGraphicsWindowSize(int *w, int *h);
 void GetTextWindowSize(int *w, int *h);
 double GetScreenDpi();
 int64_t GetMilliseconds();
+void ParallelFor(size_t n, const std::function<void(size_t)> &fn);
 
 void dbp(const char *str, ...);
 #define DBPTRI(tri) \
@@ -410,16 +417,45 @@ public:
     void ExportSurfacesTo(const Platform::Path &filename);
     void WriteHeader();
 	void WriteProductHeader();
+    int ExportPoint(Vector p);
+    int ExportVertex(Vector p);
     int ExportCurve(SBezier *sb);
+    int ExportEdge(SBezier *sb, int start, int finish, bool *backwards);
     int ExportCurveLoop(SBezierLoop *loop, bool inner);
-    void ExportSurface(SSurface *ss, SBezierList *sbl);
+    void ExportSurface(SSurface *ss, SBezierLoopSetSet *sblss);
     void WriteWireframe();
     void WriteFooter();
 
+    void Write(const char *str);
+    void Printf(const char *fmt, ...);
+    void WriteId(int v);
+    void WriteNumber(double v);
+    void Flush();
+
+    struct WrittenVertex {
+        Vector  p;
+        int     id;
+    };
+    struct WrittenEdge {
+        SBezier curve;
+        int     id;
+    };
+    static uint64_t EdgeKey(int start, int finish) {
+        return ((uint64_t)(uint32_t)start << 32) | (uint32_t)finish;
+    }
+
     List<int> curves;
     List<int> advancedFaces;
     FILE *f;
     int id;
+    std::string out; // not yet written to f
+    // What was written already: the points by the bytes of their
+    // coordinates, the vertices in a grid, and the edges by the ids of their
+    // start and finish vertices.
+    std::unordered_map<std::string, int>            pointIds;
+    std::vector<WrittenVertex>                      vertices;
+    VertexGrid                                      vertexGrid;
+    std::unordered_multimap<uint64_t, WrittenEdge>  edges;
 };
 
 class VectorFileWriter {
@@ -616,22 +652,24 @@ public:
     TextWindow                 &TW;
     GraphicsWindow              GW;
 
-    // The state for undo/redo
+    // The state for undo/redo. Items are shared between states for as long
+    // as they don't change, so a state only costs memory for what changed
+    // since the one recorded before it; nothing shared is ever modified.
+    typedef IdList<EntityMap,EntityId> EntityRemap;
+    template<class T>
+    using UndoItems = std::vector<std::shared_ptr<const T>>;
     typedef struct {
-        IdList<Group,hGroup>            group;
-        List<hGroup>                    groupOrder;
-        IdList<Request,hRequest>        request;
-        IdList<Constraint,hConstraint>  constraint;
-        IdList<Param,hParam>            param;
-        IdList<Style,hStyle>            style;
+        UndoItems<Group>                group;  // without their remap,
+        std::vector<std::shared_ptr<EntityRemap>> remap; // which is kept here
+        std::vector<hGroup>             groupOrder;
+        UndoItems<Request>              request;
+        UndoItems<Constraint>           constraint;
+        UndoItems<Param>                param;
+        UndoItems<Style>                style;
         hGroup                          activeGroup;
 
         void Clear() {
-            group.Clear();
-            request.Clear();
-            constraint.Clear();
-            param.Clear();
-            style.Clear();
+            *this = {};
         }
     } UndoState;
     enum { MAX_UNDO = 16 };
@@ -642,6 +680,9 @@ public:
     } UndoStack;
     UndoStack   undo;
     UndoStack   redo;
+    // The state that was recorded or restored last; new states share with it.
+    UndoState   undoLast;
+    size_t UndoMemoryUsed();
 
     std::map<Platform::Path, std::shared_ptr<Pixmap>, Platform::PathLess> images;
     bool ReloadLinkedImage(const Platform::Path &saveFile, Platform::Path *filename,
@@ -652,6 +693,7 @@ public:
     void UndoUndo();
     void UndoRedo();
     void PushFromCurrentOnto(UndoStack *uk);
+    void UndoRememberState(UndoState *ut);
     void PopOntoCurrentFrom(UndoStack *uk);
     void UndoClearState(UndoState *ut);
     void UndoClearStack(UndoStack *uk);
@@ -667,6 +709,8 @@ public:
     int      maxSegments;
     double   exportChordTol;
     int      exportMaxSegments;
+    int      exportDecimateTriangles;
+    double   exportDecimateError;
     double   cameraTangent;
     float    gridSpacing;
     float    exportScale;
@@ -675,6 +719,7 @@ public:
     bool     drawBackFaces;
     bool     showContourAreas;
     bool     checkClosedContour;
+    bool     saveRegenCache;
     bool     showToolbar;
     Platform::Path screenshotFile;
     RgbaColor backgroundColor;
@@ -750,17 +795,43 @@ public:
     } SaveTable;
     static const SaveTable SAVED[];
     void SaveUsingTable(const Platform::Path &filename, int type);
-    void LoadUsingTable(const Platform::Path &filename, char *key, char *val);
-    struct {
+    uint64_t HashUsingTable(int type, uint64_t hash);
+    bool SameUsingTable(int type, const void *a, const void *b);
+    // A file being loaded, read line by line straight out of its mapping;
+    // fields are parsed in place, skipping any blanks before them.
+    class LoadCursor {
+    public:
+        const char *next, *end;     // the rest of the file
+        const char *line, *lineEnd; // the current line, without the newline
+        const char *field;          // the parse position within the line
+
+        bool NextLine();
+        bool LineIs(const char *str) const;
+        bool LineStartsWith(const char *str) const;
+
+        bool Word(const char *str);
+        bool Int(int *v);
+        bool Hex(uint32_t *v);
+        bool Double(double *v);
+    };
+    typedef struct {
         Group        g;
         Request      r;
         Entity       e;
         Param        p;
         Constraint   c;
         Style        s;
-    } sv;
+    } SaveVars;
+    SaveVars    sv;
+    static void SaveUsingTable(FILE *fh, const Platform::Path &filename, int type,
+                               SaveVars *vars);
+    bool LoadUsingTable(const Platform::Path &filename, LoadCursor *cursor,
+                        const char *key, size_t keyLength, SaveVars *vars);
     static void MenuFile(Command id);
 	bool Autosave();
+    // Autosaves are written on this thread, from a snapshot of the sketch.
+    std::thread autosaveThread;
+    void WaitForAutosave();
     void RemoveAutosave();
     bool GetFilenameAndSave(bool saveAs);
     bool OkayToStartNewFile();
@@ -769,12 +840,54 @@ public:
     void ClearExisting();
     void NewFile();
     bool SaveToFile(const Platform::Path &filename);
+    static bool SaveStateTo(const UndoState &ut, const Platform::Path &filename);
     bool LoadAutosaveFor(const Platform::Path &filename);
     bool LoadFromFile(const Platform::Path &filename, bool canCancel = false);
+    bool ParseFile(const Platform::Path &filename);
     void UpgradeLegacyData();
     bool LoadEntitiesFromFile(const Platform::Path &filename, EntityList *le,
                               SMesh *m, SShell *sh);
+    static bool IsBinaryFile(const char *data, size_t size);
+    void SaveBinaryTo(const Platform::Path &filename);
+    void ParseBinary(const Platform::Path &filename, const char *data, size_t size);
+    bool LoadEntitiesFromBinary(const Platform::Path &filename, const char *data, size_t size,
+                                SaveVars *vars, EntityList *le, SMesh *m, SShell *sh);
     bool ReloadAllLinked(const Platform::Path &filename, bool canCancel = false);
+    // What a linked file is needed for. If only for its mesh, then just its
+    // faces, the entities in keep (by handle), and what those are built from.
+    typedef struct {
+        Platform::Path      filename;
+        bool                meshOnly;
+        std::set<uint32_t>  keep;
+    } LinkedFileUse;
+    // The contents of each linked file, for as long as the file is unchanged.
+    typedef struct {
+        uint64_t        size;
+        int64_t         mtime;
+        LinkedFileUse   use;
+        EntityList      entity;
+        SMesh           mesh;
+        SShell          shell;
+    } LinkedFile;
+    std::map<Platform::Path, LinkedFile, Platform::PathLess> linkedFiles;
+    LinkedFileUse LinkedFileUseOf(Group *g);
+    void LoadLinkedFiles(const std::vector<LinkedFileUse> &uses);
+    bool LoadLinkedFile(const LinkedFileUse &use, EntityList *le, SMesh *m, SShell *sh);
+    void ForgetLinkedFile(const Platform::Path &filename);
+    // The last group's shell and mesh, as read from a file saved with the
+    // hashes of every group's inputs; while those still match, this stands
+    // in for regenerating all of the groups.
+    struct {
+        std::vector<std::pair<hGroup, uint64_t>> hash;
+        SShell      shell;
+        SMesh       mesh;
+        hGroup      group;
+        double      chordTol;
+        int         maxSegments;
+    } regenCache;
+    void CalculateRegenHashes(std::vector<std::pair<hGroup, uint64_t>> *hash);
+    void ApplyRegenCache();
+    void DiscardRegenCache();
     // And the various export options
     void ExportAsPngTo(const Platform::Path &filename);
     void ExportMeshTo(const Platform::Path &filename);
@@ -782,6 +895,7 @@ public:
     void ExportMeshAsObjTo(FILE *fObj, FILE *fMtl, SMesh *sm);
     void ExportMeshAsThreeJsTo(FILE *f, const Platform::Path &filename,
                                SMesh *sm, SOutlineList *sol);
+    void ExportMeshAsGltfTo(FILE *f, SMesh *sm, SOutlineList *sol);
     void ExportViewOrWireframeTo(const Platform::Path &filename, bool exportWireframe);
     void ExportSectionTo(const Platform::Path &filename);
     void ExportWireframeCurves(SEdgeList *sel, SBezierList *sbl,
@@ -855,6 +969,10 @@ public:
 
     void GenerateAll(Generate type = Generate::DIRTY, bool andFindFree = false,
                      bool genForBBox = false);
+    // Where the time went during the last GenerateAll, for profiling.
+    struct {
+        int64_t     mergeSurfaces;
+    } generateMillis;
     void SolveGroup(hGroup hg, bool andFindFree);
     void SolveGroupAndReport(hGroup hg, bool andFindFree);
     SolveResult TestRankForGroup(hGroup hg);
@@ -24,7 +24,7 @@ void SShell::MakeFromDifferenceOf(SShell *a, SShell *b) {
 // the intersection of srfA and srfB.) Return a new pwl curve with everything
 // split.
 //-----------------------------------------------------------------------------
-static Vector LineStart, LineDirection;
+static thread_local Vector LineStart, LineDirection;
 static int ByTAlongLine(const void *av, const void *bv)
 {
     SInter *a = (SInter *)av,
@@ -77,8 +77,12 @@ SCurve SCurve::MakeCopySplitAgainst(SShell *agnstA, SShell *agnstB,
                     continue;
                 }
 
+                // The surfaces may be shared with other threads splitting
+                // other curves, so don't touch their cached guesses.
                 Point2d puv;
-                (pi->srf)->ClosestPointTo(pi->p, &puv, /*mustConverge=*/false);
+                (pi->srf)->ClosestPointTo(pi->p, &puv.x, &puv.y,
+                                          /*mustConverge=*/false,
+                                          /*useCachedGuess=*/false);
 
                 // Split the edge if the intersection lies within the surface's
                 // trim curves, or within the chord tol of the trim curve; want
@@ -96,7 +100,8 @@ SCurve SCurve::MakeCopySplitAgainst(SShell *agnstA, SShell *agnstB,
                 }
 
                 // We're keeping the intersection, so actually refine it.
-                (pi->srf)->PointOnSurfaces(srfA, srfB, &(puv.x), &(puv.y));
+                (pi->srf)->PointOnSurfaces(srfA, srfB, &(puv.x), &(puv.y),
+                                           /*useCachedGuess=*/false);
                 pi->p = (pi->srf)->PointAt(puv);
             }
             il.RemoveTagged();
@@ -132,11 +137,23 @@ SCurve SCurve::MakeCopySplitAgainst(SShell *agnstA, SShell *agnstB,
 }
 
 void SShell::CopyCurvesSplitAgainst(bool opA, SShell *agnst, SShell *into) {
-    SCurve *sc;
-    for(sc = curve.First(); sc; sc = curve.NextAfter(sc)) {
-        SCurve scn = sc->MakeCopySplitAgainst(agnst, NULL,
+    // Each curve gets split independently, so do that in parallel. Both
+    // shells must already have their surfaces indexed, which builds the
+    // samples and splits that intersecting and projecting would otherwise
+    // build lazily; and MakeCopySplitAgainst() projects without the cached
+    // guess, so that the surfaces are only read.
+    ssassert(bvh && agnst->bvh, "Expected indexed shells");
+    std::vector<SCurve> split(curve.n);
+    ParallelFor(curve.n, [&](size_t i) {
+        SCurve *sc = &curve.elem[i];
+        split[i] = sc->MakeCopySplitAgainst(agnst, NULL,
                                 surface.FindById(sc->surfA),
                                 surface.FindById(sc->surfB));
+    });
+
+    for(int i = 0; i < curve.n; i++) {
+        SCurve *sc = &curve.elem[i];
+        SCurve scn = split[i];
         scn.source = opA ? SCurve::Source::A : SCurve::Source::B;
 
         hSCurve hsc = into->curve.AddAndAssignId(&scn);
@@ -704,6 +721,10 @@ void SShell::MakeFromBoolean(SShell *a, SShell *b, SSurface::CombineAs type) {
 
     a->MakeClassifyingBsps(NULL);
     b->MakeClassifyingBsps(NULL);
+    // We'll cast a lot of lines against both shells, so index their surfaces
+    // now; they don't move until we're done.
+    a->MakeSurfaceBvh();
+    b->MakeSurfaceBvh();
 
     // Copy over all the original curves, splitting them so that a
     // piecwise linear segment never crosses a surface from the other
@@ -748,6 +769,8 @@ void SShell::MakeFromBoolean(SShell *a, SShell *b, SSurface::CombineAs type) {
     // And clean up the piecewise linear things we made as a calculation aid
     a->CleanupAfterBoolean();
     b->CleanupAfterBoolean();
+    a->bvh.reset();
+    b->bvh.reset();
 }
 
 //-----------------------------------------------------------------------------
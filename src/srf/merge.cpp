@@ -6,12 +6,50 @@
 //-----------------------------------------------------------------------------
 #include "../solvespace.h"
 
+//-----------------------------------------------------------------------------
+// The offset from the origin of a planar surface's plane, as used by
+// SSurface::CoincidentWith. Also returns how far the offset of any surface
+// coincident with ours could differ from it; that's more than LENGTH_EPS,
+// since the other surface's normal may differ slightly from ours.
+//-----------------------------------------------------------------------------
+static double PlaneOffsetOf(const SSurface *srf, double *tol) {
+    Vector p  = srf->ctrl[0][0],
+           e1 = (srf->ctrl[1][0]).Minus(p),
+           e2 = (srf->ctrl[0][1]).Minus(p);
+    Vector n = srf->NormalAt(0, 0).WithMagnitude(1);
+
+    // The corners of our surface are within LENGTH_EPS of the other plane,
+    // which bounds how far the other normal can tilt away from ours.
+    double area = (e1.Cross(e2)).Magnitude();
+    if(area < LENGTH_EPS*LENGTH_EPS) {
+        *tol = VERY_POSITIVE;
+    } else {
+        double tilt = 2*LENGTH_EPS*(e1.Magnitude() + e2.Magnitude())/area;
+        tilt = min(2.0, 2*tilt);
+        // and be generous, since this is only a filter
+        *tol = 2*(LENGTH_EPS + tilt*p.Magnitude());
+    }
+    return n.Dot(p);
+}
+
 void SShell::MergeCoincidentSurfaces() {
     surface.ClearTags();
 
-    int i, j;
+    int i;
     SSurface *si, *sj;
 
+    // Rather than testing every pair of surfaces, sort the planes by their
+    // offset from the origin, and test only those close to ours.
+    std::vector<std::pair<double, int>> byOffset;
+    for(i = 0; i < surface.n; i++) {
+        si = &(surface.elem[i]);
+        if(si->degm != 1 || si->degn != 1) continue;
+        double tol;
+        byOffset.emplace_back(PlaneOffsetOf(si, &tol), i);
+    }
+    std::sort(byOffset.begin(), byOffset.end());
+
+    std::vector<int> candidates;
     for(i = 0; i < surface.n; i++) {
         si = &(surface.elem[i]);
         if(si->tag) continue;
@@ -22,14 +60,26 @@ void SShell::MergeCoincidentSurfaces() {
         // time on other surfaces.
         if(si->degm != 1 || si->degn != 1) continue;
 
+        double tol, d = PlaneOffsetOf(si, &tol);
+        auto it = std::lower_bound(byOffset.begin(), byOffset.end(),
+                                   std::make_pair(d - tol, -1));
+        candidates.clear();
+        for(; it != byOffset.end() && it->first <= d + tol; ++it) {
+            if(it->second > i) candidates.push_back(it->second);
+        }
+        // Try them in the same order as if we'd tested every surface.
+        std::sort(candidates.begin(), candidates.end());
+
+        // Our edges are built only once we find a coincident surface, since
+        // most surfaces don't have one.
         SEdgeList sel = {};
-        si->MakeEdgesInto(this, &sel, SSurface::MakeAs::XYZ);
+        bool haveEdges = false;
 
         bool mergedThisTime, merged = false;
         do {
             mergedThisTime = false;
 
-            for(j = i + 1; j < surface.n; j++) {
+            for(int j : candidates) {
                 sj = &(surface.elem[j]);
                 if(sj->tag) continue;
                 if(!sj->CoincidentWith(si, /*sameNormal=*/true)) continue;
@@ -41,6 +91,10 @@ void SShell::MergeCoincidentSurfaces() {
                 // surfaces if they contain disjoint contours; that just makes
                 // the bounding box tests less effective, and possibly things
                 // less robust.
+                if(!haveEdges) {
+                    si->MakeEdgesInto(this, &sel, SSurface::MakeAs::XYZ);
+                    haveEdges = true;
+                }
                 SEdgeList tel = {};
                 sj->MakeEdgesInto(this, &tel, SSurface::MakeAs::XYZ);
                 if(!sel.ContainsEdgeFrom(&tel)) {
@@ -93,6 +93,85 @@ double SolveSpace::BernsteinDerivative(int k, int deg, double t)
     ssassert(false, "Unexpected degree of spline");
 }
 
+//-----------------------------------------------------------------------------
+// The Bernstein basis of degree deg, at BEZIER_LANES parameter values at
+// once. This is the same arithmetic as Bernstein(), so batched evaluation
+// gives exactly the same points as evaluation one at a time.
+//-----------------------------------------------------------------------------
+static void BernsteinLanes(int deg, const double *t, double B[4][BEZIER_LANES]) {
+    int k;
+    switch(deg) {
+        case 0:
+            for(k = 0; k < BEZIER_LANES; k++) {
+                B[0][k] = 1;
+            }
+            return;
+
+        case 1:
+            for(k = 0; k < BEZIER_LANES; k++) {
+                B[0][k] = (1 - t[k]);
+                B[1][k] = t[k];
+            }
+            return;
+
+        case 2:
+            for(k = 0; k < BEZIER_LANES; k++) {
+                B[0][k] = (1 - t[k])*(1 - t[k]);
+                B[1][k] = 2*(1 - t[k])*t[k];
+                B[2][k] = t[k]*t[k];
+            }
+            return;
+
+        case 3:
+            for(k = 0; k < BEZIER_LANES; k++) {
+                B[0][k] = (1 - t[k])*(1 - t[k])*(1 - t[k]);
+                B[1][k] = 3*(1 - t[k])*(1 - t[k])*t[k];
+                B[2][k] = 3*(1 - t[k])*t[k]*t[k];
+                B[3][k] = t[k]*t[k]*t[k];
+            }
+            return;
+    }
+    ssassert(false, "Unexpected degree of spline");
+}
+
+// Copy up to BEZIER_LANES parameter values into a full batch, repeating the
+// last one to fill any unused lanes.
+static size_t FillLanes(const double *t, size_t n, double *lanes) {
+    size_t m = min(n, (size_t)BEZIER_LANES);
+    for(size_t k = 0; k < BEZIER_LANES; k++) {
+        lanes[k] = t[min(k, m - 1)];
+    }
+    return m;
+}
+
+void SBezier::PointsAt(const double *t, Vector *pt, size_t n) const {
+    for(size_t s = 0; s < n; s += BEZIER_LANES) {
+        double tl[BEZIER_LANES];
+        size_t m = FillLanes(t + s, n - s, tl);
+
+        double B[4][BEZIER_LANES];
+        BernsteinLanes(deg, tl, B);
+
+        double x[BEZIER_LANES] = {}, y[BEZIER_LANES] = {},
+               z[BEZIER_LANES] = {}, d[BEZIER_LANES] = {};
+        for(int i = 0; i <= deg; i++) {
+            Vector c = ctrl[i];
+            double w = weight[i];
+            for(size_t k = 0; k < BEZIER_LANES; k++) {
+                double Bw = B[i][k]*w;
+                x[k] += c.x*Bw;
+                y[k] += c.y*Bw;
+                z[k] += c.z*Bw;
+                d[k] += w*B[i][k];
+            }
+        }
+        for(size_t k = 0; k < m; k++) {
+            double r = 1.0/d[k];
+            pt[s + k] = Vector::From(x[k]*r, y[k]*r, z[k]*r);
+        }
+    }
+}
+
 Vector SBezier::PointAt(double t) const {
     Vector pt = Vector::From(0, 0, 0);
     double d = 0;
@@ -265,60 +344,89 @@ void SBezier::MakePwlInto(List<Vector> *l, double chordTol) const {
     l->Add(&(ctrl[0]));
     if(deg == 1) {
         l->Add(&(ctrl[1]));
-    } else {
-        // Never do fewer than one intermediate point; people seem to get
-        // unhappy when their circles turn into squares, but maybe less
-        // unhappy with octagons.
-        MakePwlInitialWorker(l, 0.0, 0.5, chordTol);
-        MakePwlInitialWorker(l, 0.5, 1.0, chordTol);
+        return;
     }
-}
-void SBezier::MakePwlWorker(List<Vector> *l, double ta, double tb, double chordTol) const
-{
-    Vector pa = PointAt(ta);
-    Vector pb = PointAt(tb);
-
-    Vector pm = PointAt((ta + tb) / 2.0);
-    double d = pm.DistanceToLine(pa, pb.Minus(pa));
 
+    // We subdivide until each span is within the chord tolerance, or
+    // shorter than our maximum number of segments permits. That's done
+    // breadth-first, so that we can evaluate all the new points at each
+    // level in a single batch.
+    struct Span {
+        double  ta, tb;
+        Vector  pa, pb;
+        bool    done;
+    };
     double step = 1.0/SS.GetMaxSegments();
-    if((tb - ta) < step || d < chordTol) {
-        // A previous call has already added the beginning of our interval.
-        l->Add(&pb);
-    } else {
-        double tm = (ta + tb) / 2;
-        MakePwlWorker(l, ta, tm, chordTol);
-        MakePwlWorker(l, tm, tb, chordTol);
+
+    // Never do fewer than one intermediate point; people seem to get
+    // unhappy when their circles turn into squares, but maybe less
+    // unhappy with octagons. So test the two halves at three points each.
+    double ti[9];
+    for(int i = 0; i < 9; i++) {
+        ti[i] = i/8.0;
+    }
+    Vector pi[9];
+    PointsAt(ti, pi, 9);
+
+    std::vector<Span> spans;
+    for(int h = 0; h < 2; h++) {
+        Vector *p = &pi[4*h];
+        Vector dir = p[4].Minus(p[0]);
+        double d = max({
+                       p[1].DistanceToLine(p[0], dir),
+                       p[2].DistanceToLine(p[0], dir),
+                       p[3].DistanceToLine(p[0], dir)
+                    });
+        double ta = ti[4*h], tb = ti[4*h + 4];
+        if((tb - ta) < step || d < chordTol) {
+            spans.push_back({ ta, tb, p[0], p[4], true });
+        } else {
+            spans.push_back({ ta, ti[4*h + 2], p[0], p[2], false });
+            spans.push_back({ ti[4*h + 2], tb, p[2], p[4], false });
+        }
     }
-}
-void SBezier::MakePwlInitialWorker(List<Vector> *l, double ta, double tb, double chordTol) const
-{
-    Vector pa = PointAt(ta);
-    Vector pb = PointAt(tb);
 
-    double tm1 = ta + (tb - ta) * 0.25;
-    double tm2 = ta + (tb - ta) * 0.5;
-    double tm3 = ta + (tb - ta) * 0.75;
+    std::vector<double> tm;
+    std::vector<Vector> pm;
+    std::vector<Span> next;
+    for(;;) {
+        tm.clear();
+        for(Span &sp : spans) {
+            if(sp.done) continue;
+            if((sp.tb - sp.ta) < step) {
+                sp.done = true;
+                continue;
+            }
+            tm.push_back((sp.ta + sp.tb) / 2.0);
+        }
+        if(tm.empty()) break;
 
-    Vector pm1 = PointAt(tm1);
-    Vector pm2 = PointAt(tm2);
-    Vector pm3 = PointAt(tm3);
-    Vector dir = pb.Minus(pa);
+        pm.resize(tm.size());
+        PointsAt(&tm[0], &pm[0], tm.size());
 
-    double d = max({
-                   pm1.DistanceToLine(pa, dir),
-                   pm2.DistanceToLine(pa, dir),
-                   pm3.DistanceToLine(pa, dir)
-                });
+        next.clear();
+        size_t i = 0;
+        for(Span &sp : spans) {
+            if(sp.done) {
+                next.push_back(sp);
+                continue;
+            }
+            double d = pm[i].DistanceToLine(sp.pa, sp.pb.Minus(sp.pa));
+            if(d < chordTol) {
+                sp.done = true;
+                next.push_back(sp);
+            } else {
+                next.push_back({ sp.ta, tm[i], sp.pa, pm[i], false });
+                next.push_back({ tm[i], sp.tb, pm[i], sp.pb, false });
+            }
+            i++;
+        }
+        std::swap(spans, next);
+    }
 
-    double step = 1.0/SS.GetMaxSegments();
-    if((tb - ta) < step || d < chordTol) {
-        // A previous call has already added the beginning of our interval.
-        l->Add(&pb);
-    } else {
-        double tm = (ta + tb) / 2;
-        MakePwlWorker(l, ta, tm, chordTol);
-        MakePwlWorker(l, tm, tb, chordTol);
+    // The beginning of each span is the end of the previous one.
+    for(const Span &sp : spans) {
+        l->Add(&sp.pb);
     }
 }
 
@@ -375,6 +483,40 @@ Vector SSurface::PointAt(double u, double v) const {
     return num;
 }
 
+void SSurface::PointsAt(const double *u, const double *v, Vector *pt,
+                        size_t n) const
+{
+    for(size_t s = 0; s < n; s += BEZIER_LANES) {
+        double ul[BEZIER_LANES], vl[BEZIER_LANES];
+        size_t m = FillLanes(u + s, n - s, ul);
+        FillLanes(v + s, n - s, vl);
+
+        double Bu[4][BEZIER_LANES], Bv[4][BEZIER_LANES];
+        BernsteinLanes(degm, ul, Bu);
+        BernsteinLanes(degn, vl, Bv);
+
+        double x[BEZIER_LANES] = {}, y[BEZIER_LANES] = {},
+               z[BEZIER_LANES] = {}, d[BEZIER_LANES] = {};
+        for(int i = 0; i <= degm; i++) {
+            for(int j = 0; j <= degn; j++) {
+                Vector c = ctrl[i][j];
+                double w = weight[i][j];
+                for(size_t k = 0; k < BEZIER_LANES; k++) {
+                    double Bw = Bu[i][k]*Bv[j][k]*w;
+                    x[k] += c.x*Bw;
+                    y[k] += c.y*Bw;
+                    z[k] += c.z*Bw;
+                    d[k] += w*Bu[i][k]*Bv[j][k];
+                }
+            }
+        }
+        for(size_t k = 0; k < m; k++) {
+            double r = 1.0/d[k];
+            pt[s + k] = Vector::From(x[k]*r, y[k]*r, z[k]*r);
+        }
+    }
+}
+
 void SSurface::TangentsAt(double u, double v, Vector *tu, Vector *tv) const {
     Vector num   = Vector::From(0, 0, 0),
            num_u = Vector::From(0, 0, 0),
@@ -419,11 +561,131 @@ Vector SSurface::NormalAt(double u, double v) const {
     return tu.Cross(tv);
 }
 
+//-----------------------------------------------------------------------------
+// Sample a surface on a grid of res by res points, and build a kd-tree over
+// those samples so that we can find the one nearest a given point quickly.
+//-----------------------------------------------------------------------------
+std::atomic<uint64_t> SSurface::closestPointQueries(0),
+                      SSurface::closestPointCacheHits(0);
+
+void SSurfaceCache::RecordFrom(const SSurface *srf) {
+    degm = srf->degm;
+    degn = srf->degn;
+    for(int i = 0; i <= degm; i++) {
+        for(int j = 0; j <= degn; j++) {
+            ctrl[i][j]   = srf->ctrl[i][j];
+            weight[i][j] = srf->weight[i][j];
+        }
+    }
+}
+
+bool SSurfaceCache::IsCacheOf(const SSurface *srf) const {
+    if(srf->degm != degm || srf->degn != degn) return false;
+    for(int i = 0; i <= degm; i++) {
+        for(int j = 0; j <= degn; j++) {
+            if(!srf->ctrl[i][j].EqualsExactly(ctrl[i][j])) return false;
+            if(!EXACT(srf->weight[i][j] == weight[i][j])) return false;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<SSurfaceSamples> SSurfaceSamples::From(const SSurface *srf,
+                                                       int res)
+{
+    std::shared_ptr<SSurfaceSamples> ss = std::make_shared<SSurfaceSamples>();
+    ss->RecordFrom(srf);
+
+    for(int i = 0; i < res; i++) {
+        for(int j = 0; j < res; j++) {
+            ss->u.push_back((i + 0.5)/res);
+            ss->v.push_back((j + 0.5)/res);
+        }
+    }
+    ss->pt.resize(ss->u.size());
+    srf->PointsAt(&ss->u[0], &ss->v[0], &ss->pt[0], ss->pt.size());
+
+    int n = (int)ss->pt.size();
+    for(int i = 0; i < n; i++) {
+        ss->order.push_back(i);
+    }
+    ss->axis.resize(n);
+    ss->BuildTree(0, n);
+    return ss;
+}
+
+void SSurfaceSamples::BuildTree(int lo, int hi) {
+    if(hi - lo <= 1) return;
+
+    // Split along whichever axis our points are most spread out.
+    Vector maxv = pt[order[lo]], minv = maxv;
+    for(int i = lo; i < hi; i++) {
+        pt[order[i]].MakeMaxMin(&maxv, &minv);
+    }
+    Vector extent = maxv.Minus(minv);
+    int a = 0;
+    if(extent.y > extent.Element(a)) a = 1;
+    if(extent.z > extent.Element(a)) a = 2;
+
+    int mid = (lo + hi)/2;
+    std::nth_element(&order[lo], &order[mid], &order[0] + hi, [&](int i, int j) {
+        return pt[i].Element(a) < pt[j].Element(a);
+    });
+    axis[mid] = a;
+    BuildTree(lo, mid);
+    BuildTree(mid + 1, hi);
+}
+
+void SSurfaceSamples::FindNearest(int lo, int hi, Vector p,
+                                  double *dmin, int *imin) const
+{
+    if(hi <= lo) return;
+
+    int mid = (lo + hi)/2, i = order[mid];
+    // Break ties toward the first sample, as a linear search would.
+    double d = (pt[i].Minus(p)).Magnitude();
+    if(d < *dmin || (EXACT(d == *dmin) && i < *imin)) {
+        *dmin = d;
+        *imin = i;
+    }
+    if(hi - lo == 1) return;
+
+    double delta = p.Element(axis[mid]) - pt[i].Element(axis[mid]);
+    bool lowFirst = (delta < 0);
+    FindNearest(lowFirst ? lo : mid + 1, lowFirst ? mid : hi, p, dmin, imin);
+    // Everything on the far side is at least |delta| away; allow some slop,
+    // so that rounding can't make us miss a tie.
+    if(fabs(delta) <= *dmin*(1 + 1e-9) + LENGTH_EPS) {
+        FindNearest(lowFirst ? mid + 1 : lo, lowFirst ? hi : mid, p, dmin, imin);
+    }
+}
+
+int SSurfaceSamples::Nearest(Vector p) const {
+    double dmin = VERY_POSITIVE;
+    int imin = -1;
+    FindNearest(0, (int)order.size(), p, &dmin, &imin);
+    return imin;
+}
+
 void SSurface::ClosestPointTo(Vector p, Point2d *puv, bool mustConverge) {
     ClosestPointTo(p, &(puv->x), &(puv->y), mustConverge);
 }
 
-void SSurface::ClosestPointTo(Vector p, double *u, double *v, bool mustConverge) {
+//-----------------------------------------------------------------------------
+// Make sure that our samples are current. Projecting points into the surface
+// would do this as needed, but that's not safe if several threads might
+// project into the same surface at once; so they must call this first.
+//-----------------------------------------------------------------------------
+void SSurface::MakeSamples() {
+    if(!samples || !samples->IsCacheOf(this)) {
+        int res = (max(degm, degn) == 2) ? 7 : 20;
+        samples = SSurfaceSamples::From(this, res);
+    }
+}
+
+void SSurface::ClosestPointTo(Vector p, double *u, double *v, bool mustConverge,
+                              bool useCachedGuess)
+{
     // A few special cases first; when control points are coincident the
     // derivative goes to zero at the conrol points, and would result in
     // nonconvergence. We avoid that here, and also guarantee a consistent
@@ -446,40 +708,38 @@ void SSurface::ClosestPointTo(Vector p, double *u, double *v, bool mustConverge)
         }
     }
 
+    closestPointQueries++;
+
     // Try whatever the previous guess was. This is likely to do something
     // good if we're working our way along a curve or something else where
     // we project successive points that are close to each other; something
-    // like a 20% speedup empirically.
-    if(mustConverge) {
+    // like a 20% speedup empirically. But that makes the result depend on
+    // what we projected before, so the caller may not want it.
+    if(mustConverge && useCachedGuess) {
         double ut = cached.x, vt = cached.y;
         if(ClosestPointNewton(p, &ut, &vt, mustConverge)) {
             cached.x = *u = ut;
             cached.y = *v = vt;
+            closestPointCacheHits++;
             return;
         }
     }
 
-    // Search for a reasonable initial guess
-    int i, j;
-    double minDist = VERY_POSITIVE;
-    int res = (max(degm, degn) == 2) ? 7 : 20;
-    for(i = 0; i < res; i++) {
-        for(j = 0; j < res; j++) {
-            double tryu = (i + 0.5)/res, tryv = (j + 0.5)/res;
-
-            Vector tryp = PointAt(tryu, tryv);
-            double d = (tryp.Minus(p)).Magnitude();
-            if(d < minDist) {
-                *u = tryu;
-                *v = tryv;
-                minDist = d;
-            }
-        }
+    // Search for a reasonable initial guess, among points sampled on a grid.
+    // Those are the same for every query, so keep them around; but check
+    // that they're still ours, since surfaces get copied and then modified.
+    MakeSamples();
+    int i = samples->Nearest(p);
+    if(i >= 0) {
+        *u = samples->u[i];
+        *v = samples->v[i];
     }
 
     if(ClosestPointNewton(p, u, v, mustConverge)) {
-        cached.x = *u;
-        cached.y = *v;
+        if(useCachedGuess) {
+            cached.x = *u;
+            cached.y = *v;
+        }
         return;
     }
 
@@ -598,15 +858,18 @@ Vector SSurface::ClosestPointOnThisAndSurface(SSurface *srf2, Vector p) {
            ((srf[1])->PointAt(puv[1]))).ScaledBy(0.5);
 }
 
-void SSurface::PointOnSurfaces(SSurface *s1, SSurface *s2, double *up, double *vp)
+void SSurface::PointOnSurfaces(SSurface *s1, SSurface *s2, double *up, double *vp,
+                               bool useCachedGuess)
 {
     double u[3] = { *up, 0, 0 }, v[3] = { *vp, 0, 0 };
     SSurface *srf[3] = { this, s1, s2 };
 
     // Get initial guesses for (u, v) in the other surfaces
     Vector p = PointAt(*u, *v);
-    (srf[1])->ClosestPointTo(p, &(u[1]), &(v[1]), /*mustConverge=*/false);
-    (srf[2])->ClosestPointTo(p, &(u[2]), &(v[2]), /*mustConverge=*/false);
+    (srf[1])->ClosestPointTo(p, &(u[1]), &(v[1]), /*mustConverge=*/false,
+                             useCachedGuess);
+    (srf[2])->ClosestPointTo(p, &(u[2]), &(v[2]), /*mustConverge=*/false,
+                             useCachedGuess);
 
     int i, j;
     for(i = 0; i < 20; i++) {
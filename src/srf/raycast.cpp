@@ -180,6 +180,27 @@ void SSurface::SplitInHalf(bool byU, SSurface *sa, SSurface *sb) {
     UnWeightControlPoints();
 }
 
+//-----------------------------------------------------------------------------
+// Intersect a line with a piece of sorig that's small enough to treat as flat;
+// so start Newton's method from the middle of that piece.
+//-----------------------------------------------------------------------------
+static void IntersectNearlyFlat(const SSurface *piece, Vector a, Vector b,
+                                List<SSurface::Inter> *l, SSurface *sorig)
+{
+    int degm = piece->degm, degn = piece->degn;
+    Vector p = (piece->ctrl[0   ][0   ]).Plus(
+                piece->ctrl[0   ][degn]).Plus(
+                piece->ctrl[degm][0   ]).Plus(
+                piece->ctrl[degm][degn]).ScaledBy(0.25);
+    SSurface::Inter inter;
+    sorig->ClosestPointTo(p, &(inter.p.x), &(inter.p.y), /*mustConverge=*/false);
+    if(sorig->PointIntersectingLine(a, b, &(inter.p.x), &(inter.p.y))) {
+        l->Add(&inter);
+    } else {
+        // Might not converge if line is almost tangent to surface...
+    }
+}
+
 //-----------------------------------------------------------------------------
 // Find all points where the indicated finite (if segment) or infinite (if not
 // segment) line intersects our surface. Report them in uv space in the list.
@@ -207,22 +228,7 @@ void SSurface::AllPointsIntersectingUntrimmed(Vector a, Vector b,
     // If we might intersect, and the surface is small, then switch to Newton
     // iterations.
     if(DepartureFromCoplanar() < 0.2*SS.ChordTolMm()) {
-        Vector p = (ctrl[0   ][0   ]).Plus(
-                    ctrl[0   ][degn]).Plus(
-                    ctrl[degm][0   ]).Plus(
-                    ctrl[degm][degn]).ScaledBy(0.25);
-        Inter inter;
-        sorig->ClosestPointTo(p, &(inter.p.x), &(inter.p.y), /*mustConverge=*/false);
-        if(sorig->PointIntersectingLine(a, b, &(inter.p.x), &(inter.p.y))) {
-            Vector p = sorig->PointAt(inter.p.x, inter.p.y);
-            // Debug check, verify that the point lies in both surfaces
-            // (which it ought to, since the surfaces should be coincident)
-            double u, v;
-            ClosestPointTo(p, &u, &v);
-            l->Add(&inter);
-        } else {
-            // Might not converge if line is almost tangent to surface...
-        }
+        IntersectNearlyFlat(this, a, b, l, sorig);
         return;
     }
 
@@ -237,6 +243,89 @@ void SSurface::AllPointsIntersectingUntrimmed(Vector a, Vector b,
     surf1.AllPointsIntersectingUntrimmed(a, b, cnt, level, l, asSegment, sorig);
 }
 
+//-----------------------------------------------------------------------------
+// The same, but remembering how we subdivided the surface, since we'll cast
+// many lines against it and they would otherwise all split it the same way.
+//-----------------------------------------------------------------------------
+void SSurface::MakeSplits() {
+    double chordTol = SS.ChordTolMm();
+    if(!splits || !splits->IsCacheOf(this) ||
+       !EXACT(splits->chordTol == chordTol))
+    {
+        splits = SSurfaceSplits::From(this, chordTol);
+    }
+}
+
+std::shared_ptr<SSurfaceSplits> SSurfaceSplits::From(const SSurface *srf,
+                                                     double chordTol)
+{
+    std::shared_ptr<SSurfaceSplits> ssp = std::make_shared<SSurfaceSplits>();
+    ssp->RecordFrom(srf);
+    ssp->chordTol = chordTol;
+    ssp->AddPiece(srf);
+    return ssp;
+}
+
+void SSurfaceSplits::AddPiece(const SSurface *srf) {
+    Piece p = {};
+    p.srf.degm = srf->degm;
+    p.srf.degn = srf->degn;
+    for(int i = 0; i <= srf->degm; i++) {
+        for(int j = 0; j <= srf->degn; j++) {
+            p.srf.ctrl[i][j]   = srf->ctrl[i][j];
+            p.srf.weight[i][j] = srf->weight[i][j];
+        }
+    }
+    p.flat  = (p.srf.DepartureFromCoplanar() < 0.2*chordTol);
+    p.child = -1;
+    piece.push_back(p);
+}
+
+void SSurfaceSplits::AllPointsIntersecting(int i, Vector a, Vector b,
+                                           int *cnt, int *level,
+                                           List<SSurface::Inter> *l,
+                                           bool asSegment, SSurface *sorig)
+{
+    if(piece[i].srf.LineEntirelyOutsideBbox(a, b, asSegment)) return;
+
+    if(*cnt > 2000) {
+        dbp("!!! too many subdivisions (level=%d)!", *level);
+        dbp("degm = %d degn = %d", degm, degn);
+        return;
+    }
+    (*cnt)++;
+
+    if(piece[i].flat) {
+        IntersectNearlyFlat(&piece[i].srf, a, b, l, sorig);
+        return;
+    }
+
+    // Splitting works in place on the weighted control points, so split a
+    // copy; the piece then stays bit-for-bit what we recorded.
+    SSurface parent = piece[i].srf, surf0, surf1;
+    int nextLevel = (*level) + 1;
+    if(piece[i].child < 0) {
+        parent.SplitInHalf((*level & 1) == 0, &surf0, &surf1);
+        if(piece.size() + 2 > MAX_PIECES) {
+            // We've already split plenty, so don't keep any more.
+            (*level) = nextLevel;
+            surf0.AllPointsIntersectingUntrimmed(a, b, cnt, level, l, asSegment, sorig);
+            (*level) = nextLevel;
+            surf1.AllPointsIntersectingUntrimmed(a, b, cnt, level, l, asSegment, sorig);
+            return;
+        }
+        piece[i].child = (int)piece.size();
+        AddPiece(&surf0);
+        AddPiece(&surf1);
+    }
+
+    int child = piece[i].child;
+    (*level) = nextLevel;
+    AllPointsIntersecting(child,     a, b, cnt, level, l, asSegment, sorig);
+    (*level) = nextLevel;
+    AllPointsIntersecting(child + 1, a, b, cnt, level, l, asSegment, sorig);
+}
+
 //-----------------------------------------------------------------------------
 // Find all points where a line through a and b intersects our surface, and
 // add them to the list. If seg is true then report only intersections that
@@ -244,6 +333,10 @@ void SSurface::AllPointsIntersectingUntrimmed(Vector a, Vector b,
 // we work along the infinite line. And we report either just intersections
 // inside the trim curve, or any intersection with u, v in [0, 1]. And we
 // either disregard or report tangent points.
+//
+// The result doesn't depend on any lines that we intersected before, so it's
+// safe to call this from several threads at once, once MakeSamples() and
+// MakeSplits() have been called.
 //-----------------------------------------------------------------------------
 void SSurface::AllPointsIntersecting(Vector a, Vector b,
                                      List<SInter> *l,
@@ -272,7 +365,8 @@ void SSurface::AllPointsIntersecting(Vector a, Vector b,
         {
             Vector p = Vector::AtIntersectionOfPlaneAndLine(n, d, a, b, NULL);
             Inter inter;
-            ClosestPointTo(p, &(inter.p.x), &(inter.p.y));
+            ClosestPointTo(p, &(inter.p.x), &(inter.p.y), /*mustConverge=*/true,
+                           /*useCachedGuess=*/false);
             inters.Add(&inter);
         }
     } else if(IsCylinder(&axis, &center, &radius, &start, &finish)) {
@@ -328,13 +422,16 @@ void SSurface::AllPointsIntersecting(Vector a, Vector b,
             Vector p = a.Plus((b.Minus(a)).ScaledBy(t));
 
             Inter inter;
-            ClosestPointTo(p, &(inter.p.x), &(inter.p.y));
+            ClosestPointTo(p, &(inter.p.x), &(inter.p.y), /*mustConverge=*/true,
+                           /*useCachedGuess=*/false);
             inters.Add(&inter);
         }
     } else {
         // General numerical solution by subdivision, fallback
+        MakeSplits();
+        std::lock_guard<std::mutex> lock(splits->mutex);
         int cnt = 0, level = 0;
-        AllPointsIntersectingUntrimmed(a, b, &cnt, &level, &inters, asSegment, this);
+        splits->AllPointsIntersecting(0, a, b, &cnt, &level, &inters, asSegment, this);
     }
 
     // Remove duplicate intersection points
@@ -379,12 +476,170 @@ void SSurface::AllPointsIntersecting(Vector a, Vector b,
     inters.Clear();
 }
 
+//-----------------------------------------------------------------------------
+// A bounding volume hierarchy over our surfaces, so that a line gets tested
+// against only the surfaces whose bounding boxes it comes near. Everything
+// that we find is returned in the order of our surface list, same as if we
+// had tested each surface in turn.
+//-----------------------------------------------------------------------------
+std::shared_ptr<SSurfaceBvh> SSurfaceBvh::From(SShell *shell) {
+    std::shared_ptr<SSurfaceBvh> bvh = std::make_shared<SSurfaceBvh>();
+    int n = shell->surface.n;
+    bvh->ptMax.resize(n);
+    bvh->ptMin.resize(n);
+    for(int i = 0; i < n; i++) {
+        shell->surface.elem[i].GetAxisAlignedBounding(&bvh->ptMax[i],
+                                                      &bvh->ptMin[i]);
+        bvh->index.push_back(i);
+    }
+    if(n > 0) bvh->Build(0, n);
+    return bvh;
+}
+
+void SSurfaceBvh::Build(int first, int n) {
+    Node nd = {};
+    nd.ptMax = Vector::From(VERY_NEGATIVE, VERY_NEGATIVE, VERY_NEGATIVE);
+    nd.ptMin = Vector::From(VERY_POSITIVE, VERY_POSITIVE, VERY_POSITIVE);
+    Vector cmax = nd.ptMax, cmin = nd.ptMin;
+    for(int i = first; i < first + n; i++) {
+        int j = index[i];
+        ptMax[j].MakeMaxMin(&nd.ptMax, &nd.ptMin);
+        ptMin[j].MakeMaxMin(&nd.ptMax, &nd.ptMin);
+        (ptMax[j].Plus(ptMin[j])).ScaledBy(0.5).MakeMaxMin(&cmax, &cmin);
+    }
+    int at = (int)node.size();
+    node.push_back(nd);
+    if(n <= LEAF_SURFACES) {
+        node[at].first = first;
+        node[at].n     = n;
+        node[at].right = -1;
+        return;
+    }
+
+    // Split at the median center, along whichever axis those are most
+    // spread out.
+    Vector extent = cmax.Minus(cmin);
+    int a = 0;
+    if(extent.y > extent.Element(a)) a = 1;
+    if(extent.z > extent.Element(a)) a = 2;
+    int mid = n/2;
+    std::nth_element(&index[first], &index[first + mid], &index[0] + first + n,
+        [&](int i, int j) {
+            return ptMax[i].Element(a) + ptMin[i].Element(a) <
+                   ptMax[j].Element(a) + ptMin[j].Element(a);
+        });
+
+    Build(first, mid);
+    node[at].right = (int)node.size();
+    Build(first + mid, n - mid);
+}
+
+// A conservative version of SSurface::LineEntirelyOutsideBbox; this one
+// returns true whenever that one would return false, and for boxes that
+// contain a surface's bounding box.
+bool SSurfaceBvh::LineMightIntersectBox(Vector amax, Vector amin,
+                                        Vector a, Vector b, bool asSegment)
+{
+    Vector dp = b.Minus(a);
+    double lp = dp.Magnitude();
+    if(!(lp > 0)) return true;
+
+    // Twice the tolerance used there, against roundoff.
+    double tol = 2*LENGTH_EPS;
+    double tmin = asSegment ? -tol/lp     : VERY_NEGATIVE,
+           tmax = asSegment ? 1 + tol/lp  : VERY_POSITIVE;
+    for(int i = 0; i < 3; i++) {
+        double lo = amin.Element(i) - tol,
+               hi = amax.Element(i) + tol,
+               p0 = a.Element(i),
+               d  = dp.Element(i);
+        if(d == 0) {
+            if(p0 < lo || p0 > hi) return false;
+            continue;
+        }
+        double t0 = (lo - p0)/d,
+               t1 = (hi - p0)/d;
+        if(t0 > t1) swap(t0, t1);
+        tmin = max(tmin, t0);
+        tmax = min(tmax, t1);
+        if(tmin > tmax) return false;
+    }
+    return true;
+}
+
+void SSurfaceBvh::SurfacesNearLine(Vector a, Vector b, bool asSegment,
+                                   std::vector<int> *out) const
+{
+    out->clear();
+    if(node.empty()) return;
+
+    std::vector<int> stack;
+    stack.push_back(0);
+    while(!stack.empty()) {
+        int i = stack.back();
+        stack.pop_back();
+        const Node *nd = &node[i];
+        if(!LineMightIntersectBox(nd->ptMax, nd->ptMin, a, b, asSegment)) {
+            continue;
+        }
+        if(nd->right < 0) {
+            for(int k = nd->first; k < nd->first + nd->n; k++) {
+                int j = index[k];
+                if(LineMightIntersectBox(ptMax[j], ptMin[j], a, b, asSegment)) {
+                    out->push_back(j);
+                }
+            }
+        } else {
+            stack.push_back(nd->right);
+            stack.push_back(i + 1);
+        }
+    }
+    std::sort(out->begin(), out->end());
+}
+
+void SShell::MakeSurfaceBvh() {
+    bvh = SSurfaceBvh::From(this);
+
+    // And make sure that every surface has the caches that intersecting a
+    // line might build, so that we can do that in parallel.
+    SSurface *ss;
+    for(ss = surface.First(); ss; ss = surface.NextAfter(ss)) {
+        ss->MakeSamples();
+        if(ss->degm == 1 && ss->degn == 1) continue;
+        Vector axis, center, start, finish;
+        double radius;
+        if(ss->IsCylinder(&axis, &center, &radius, &start, &finish)) continue;
+        ss->MakeSplits();
+    }
+}
+
+void SShell::SurfacesNearLine(Vector a, Vector b, bool asSegment,
+                              std::vector<SSurface *> *out)
+{
+    out->clear();
+    if(bvh) {
+        ssassert(bvh->index.size() == (size_t)surface.n,
+                 "Surfaces changed since building BVH");
+        std::vector<int> near;
+        bvh->SurfacesNearLine(a, b, asSegment, &near);
+        for(int i : near) {
+            out->push_back(&surface.elem[i]);
+        }
+    } else {
+        SSurface *ss;
+        for(ss = surface.First(); ss; ss = surface.NextAfter(ss)) {
+            out->push_back(ss);
+        }
+    }
+}
+
 void SShell::AllPointsIntersecting(Vector a, Vector b,
                                    List<SInter> *il,
                                    bool asSegment, bool trimmed, bool inclTangent)
 {
-    SSurface *ss;
-    for(ss = surface.First(); ss; ss = surface.NextAfter(ss)) {
+    std::vector<SSurface *> near;
+    SurfacesNearLine(a, b, asSegment, &near);
+    for(SSurface *ss : near) {
         ss->AllPointsIntersecting(a, b, il,
             asSegment, trimmed, inclTangent);
     }
@@ -433,8 +688,9 @@ bool SShell::ClassifyEdge(Class *indir, Class *outdir,
     // First, check for edge-on-edge
     int edge_inters = 0;
     Vector inter_surf_n[2], inter_edge_n[2];
-    SSurface *srf;
-    for(srf = surface.First(); srf; srf = surface.NextAfter(srf)) {
+    std::vector<SSurface *> near;
+    SurfacesNearLine(ea, eb, /*asSegment=*/true, &near);
+    for(SSurface *srf : near) {
         if(srf->LineEntirelyOutsideBbox(ea, eb, /*asSegment=*/true)) continue;
 
         SEdgeList *sel = &(srf->edges);
@@ -519,7 +775,7 @@ bool SShell::ClassifyEdge(Class *indir, Class *outdir,
     // are on surface) and for numerical stability, so we don't pick up
     // the additional error from the line intersection.
 
-    for(srf = surface.First(); srf; srf = surface.NextAfter(srf)) {
+    for(SSurface *srf : near) {
         if(srf->LineEntirelyOutsideBbox(ea, eb, /*asSegment=*/true)) continue;
 
         Point2d puv;
@@ -292,12 +292,17 @@ void SSurface::MakeEdgesInto(SShell *shell, SEdgeList *sel, MakeAs flags,
 // Compute the exact tangent to the intersection curve between two surfaces,
 // by taking the cross product of the surface normals. We choose the direction
 // of this tangent so that its dot product with dir is positive.
+//
+// This doesn't use (or update) the cached guesses of the two surfaces, so
+// once their samples are made it's safe to call from several threads.
 //-----------------------------------------------------------------------------
 Vector SSurface::ExactSurfaceTangentAt(Vector p, SSurface *srfA, SSurface *srfB, Vector dir)
 {
     Point2d puva, puvb;
-    srfA->ClosestPointTo(p, &puva);
-    srfB->ClosestPointTo(p, &puvb);
+    srfA->ClosestPointTo(p, &puva.x, &puva.y, /*mustConverge=*/true,
+                         /*useCachedGuess=*/false);
+    srfB->ClosestPointTo(p, &puvb.x, &puvb.y, /*mustConverge=*/true,
+                         /*useCachedGuess=*/false);
     Vector ts = (srfA->NormalAt(puva)).Cross(
                 (srfB->NormalAt(puvb)));
     ts = ts.WithMagnitude(1);
@@ -414,7 +419,151 @@ void SSurface::MakeSectionEdgesInto(SShell *shell, SEdgeList *sel, SBezierList *
     }
 }
 
+//-----------------------------------------------------------------------------
+// A cache of surface triangulations. Every regeneration builds its shells
+// from scratch, but most of the surfaces in them come out bit-identical to
+// the last time; so we key each triangulation on everything that it depends
+// on (the surface, its trim curves, and the chord tolerance) and reuse it
+// whenever that matches exactly.
+//-----------------------------------------------------------------------------
+namespace {
+struct CachedTriangulation {
+    std::vector<double>     key;
+    std::vector<STriangle>  tris;
+    uint64_t                lastUsed;
+};
+
+class TriangulationCache {
+public:
+    // Enough for the display mesh of a large model, without holding on to
+    // much memory for the rest of the session.
+    static const size_t MAX_BYTES = 16 << 20;
+
+    std::unordered_map<uint64_t, CachedTriangulation> entries;
+    size_t      byteCount = 0;
+    uint64_t    useCount = 0;
+    // Surfaces get triangulated from several threads at once.
+    std::mutex  mutex;
+
+    static size_t BytesFor(const CachedTriangulation &ct) {
+        return sizeof(ct) + ct.key.capacity() * sizeof(double) +
+               ct.tris.capacity() * sizeof(STriangle);
+    }
+
+    static uint64_t HashKey(const std::vector<double> &key) {
+        // FNV-1a, over the exact bit patterns of the key.
+        uint64_t hash = 14695981039346656037ULL;
+        for(double d : key) {
+            uint64_t bits;
+            memcpy(&bits, &d, sizeof(bits));
+            for(int i = 0; i < 8; i++) {
+                hash ^= (bits >> (8 * i)) & 0xff;
+                hash *= 1099511628211ULL;
+            }
+        }
+        return hash;
+    }
+
+    bool Find(uint64_t hash, const std::vector<double> &key, SMesh *sm) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(hash);
+        if(it == entries.end() || it->second.key != key) return false;
+
+        it->second.lastUsed = ++useCount;
+        for(const STriangle &st : it->second.tris) {
+            sm->AddTriangle(&st);
+        }
+        return true;
+    }
+
+    void Store(uint64_t hash, std::vector<double> &&key,
+               const STriangle *first, const STriangle *last) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(hash);
+        if(it != entries.end()) {
+            byteCount -= BytesFor(it->second);
+            entries.erase(it);
+        }
+
+        CachedTriangulation ct = {};
+        ct.key      = std::move(key);
+        ct.tris.assign(first, last);
+        ct.lastUsed = ++useCount;
+        byteCount += BytesFor(ct);
+        entries.emplace(hash, std::move(ct));
+
+        if(byteCount > MAX_BYTES) Evict();
+    }
+
+    void Evict() {
+        // Throw away the least recently used entries, until the cache is down
+        // to half its size.
+        std::vector<std::pair<uint64_t, uint64_t>> uses;
+        for(const auto &e : entries) uses.emplace_back(e.second.lastUsed, e.first);
+        std::sort(uses.begin(), uses.end());
+
+        for(const auto &use : uses) {
+            if(byteCount <= MAX_BYTES / 2) break;
+            auto it = entries.find(use.second);
+            byteCount -= BytesFor(it->second);
+            entries.erase(it);
+        }
+    }
+
+    void Clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        byteCount = 0;
+    }
+};
+
+TriangulationCache triangulationCache;
+}
+
+void SSurface::ClearTriangulationCache() {
+    triangulationCache.Clear();
+}
+
+void SSurface::MakeTriangulationKey(SShell *shell, std::vector<double> *key) const {
+    key->push_back(SS.ChordTolMm());
+    key->push_back((double)SS.GetMaxSegments());
+    key->push_back((double)face);
+    key->push_back((double)color.ToPackedInt());
+    key->push_back((double)degm);
+    key->push_back((double)degn);
+    for(int i = 0; i <= degm; i++) {
+        for(int j = 0; j <= degn; j++) {
+            key->push_back(ctrl[i][j].x);
+            key->push_back(ctrl[i][j].y);
+            key->push_back(ctrl[i][j].z);
+            key->push_back(weight[i][j]);
+        }
+    }
+    for(const STrimBy &stb : trim) {
+        key->push_back(stb.backwards ? 1.0 : 0.0);
+        key->push_back(stb.start.x);
+        key->push_back(stb.start.y);
+        key->push_back(stb.start.z);
+        key->push_back(stb.finish.x);
+        key->push_back(stb.finish.y);
+        key->push_back(stb.finish.z);
+
+        SCurve *sc = shell->curve.FindById(stb.curve);
+        key->push_back((double)sc->pts.n);
+        for(const SCurvePt &pt : sc->pts) {
+            key->push_back(pt.p.x);
+            key->push_back(pt.p.y);
+            key->push_back(pt.p.z);
+        }
+    }
+}
+
 void SSurface::TriangulateInto(SShell *shell, SMesh *sm) {
+    std::vector<double> key;
+    MakeTriangulationKey(shell, &key);
+    uint64_t hash = TriangulationCache::HashKey(key);
+    if(triangulationCache.Find(hash, key, sm)) return;
+
     SEdgeList el = {};
 
     MakeEdgesInto(shell, &el, MakeAs::UV);
@@ -452,6 +601,9 @@ void SSurface::TriangulateInto(SShell *shell, SMesh *sm) {
             // the triangle direction, sigh.
             st->FlipNormal();
         }
+
+        triangulationCache.Store(hash, std::move(key),
+                                 &sm->l.elem[start], &sm->l.elem[sm->l.n]);
     } else {
         dbp("failed to assemble polygon to trim nurbs surface in uv space");
     }
@@ -492,6 +644,8 @@ void SSurface::ScaleSelfBy(double s) {
 
 void SSurface::Clear() {
     trim.Clear();
+    samples.reset();
+    splits.reset();
 }
 
 typedef struct {
@@ -870,9 +1024,24 @@ void SShell::MakeSectionEdgesInto(Vector n, double d, SEdgeList *sel, SBezierLis
 }
 
 void SShell::TriangulateInto(SMesh *sm) {
-    SSurface *s;
-    for(s = surface.First(); s; s = surface.NextAfter(s)) {
-        s->TriangulateInto(this, sm);
+    // The surfaces triangulate independently (sharing only the curves, which
+    // are read-only here), so do them in parallel; but collect the triangles
+    // in surface order, so that the mesh doesn't depend on the scheduling.
+    std::vector<SMesh> meshes(surface.n);
+    ParallelFor(surface.n, [&](size_t i) {
+        surface.elem[i].TriangulateInto(this, &meshes[i]);
+    });
+
+    int count = 0;
+    for(const SMesh &m : meshes) {
+        count += m.l.n;
+    }
+    sm->l.ReserveMore(count);
+    for(SMesh &m : meshes) {
+        for(const STriangle &st : m.l) {
+            sm->AddTriangle(&st);
+        }
+        m.Clear();
     }
 }
 
@@ -892,5 +1061,6 @@ void SShell::Clear() {
         c->Clear();
     }
     curve.Clear();
+    bvh.reset();
 }
 
@@ -14,6 +14,10 @@
 double Bernstein(int k, int deg, double t);
 double BernsteinDerivative(int k, int deg, double t);
 
+// Curves and surfaces are evaluated in batches of this many points, laid out
+// so that the compiler can use SIMD instructions across the batch.
+#define BEZIER_LANES 4
+
 class SBezierList;
 class SSurface;
 class SCurvePt;
@@ -53,10 +57,40 @@ public:
     double MinimumDistanceToEdge(Point2d p, SSurface *srf) const;
 };
 
+// Something that we calculated from a surface and keep around; we remember
+// the control points that it came from, so that we can tell if it's stale.
+class SSurfaceCache {
+public:
+    int                 degm, degn;
+    Vector              ctrl[4][4];
+    double              weight[4][4];
+
+    void RecordFrom(const SSurface *srf);
+    bool IsCacheOf(const SSurface *srf) const;
+};
+
+// A grid of points sampled on a surface, with a kd-tree over them; used to
+// find an initial guess when projecting a point into the surface.
+class SSurfaceSamples : public SSurfaceCache {
+public:
+    std::vector<double> u, v;
+    std::vector<Vector> pt;
+    // The kd-tree is implicit; each node is the median of its range, and
+    // its children are the ranges to either side.
+    std::vector<int>    order;
+    std::vector<int>    axis;
+
+    static std::shared_ptr<SSurfaceSamples> From(const SSurface *srf, int res);
+    void BuildTree(int lo, int hi);
+    void FindNearest(int lo, int hi, Vector p, double *dmin, int *imin) const;
+    int Nearest(Vector p) const;
+};
+
 // Now the data structures to represent a shell of trimmed rational polynomial
 // surfaces.
 
 class SShell;
+class SSurfaceSplits;
 
 class hSSurface {
 public:
@@ -82,6 +116,7 @@ public:
     uint32_t        entity;
 
     Vector PointAt(double t) const;
+    void PointsAt(const double *t, Vector *pt, size_t n) const;
     Vector TangentAt(double t) const;
     void ClosestPointTo(Vector p, double *t, bool mustConverge=true) const;
     void SplitAt(double t, SBezier *bef, SBezier *aft) const;
@@ -94,8 +129,6 @@ public:
     void MakePwlInto(List<SCurvePt> *l, double chordTol=0) const;
     void MakePwlInto(SContour *sc, double chordTol=0) const;
     void MakePwlInto(List<Vector> *l, double chordTol=0) const;
-    void MakePwlWorker(List<Vector> *l, double ta, double tb, double chordTol) const;
-    void MakePwlInitialWorker(List<Vector> *l, double ta, double tb, double chordTol) const;
     void MakeNonrationalCubicInto(SBezierList *bl, double tolerance, int depth = 0) const;
 
     void AllIntersectionsWith(const SBezier *sbb, SPointList *spl) const;
@@ -280,6 +313,15 @@ public:
     // For caching our initial (u, v) when doing Newton iterations to project
     // a point into our surface.
     Point2d         cached;
+    // And for finding one if that fails; built on first use.
+    std::shared_ptr<SSurfaceSamples> samples;
+    // The pieces that we subdivide into when intersecting a line with the
+    // surface numerically; also built on first use.
+    std::shared_ptr<SSurfaceSplits> splits;
+
+    // How many projections we did, and how many of those converged from the
+    // cached (u, v) alone; for profiling.
+    static std::atomic<uint64_t> closestPointQueries, closestPointCacheHits;
 
     static SSurface FromExtrusionOf(SBezier *spc, Vector t0, Vector t1);
     static SSurface FromRevolutionOf(SBezier *sb, Vector pt, Vector axis,
@@ -324,14 +366,19 @@ public:
                                         SSurface *sorig);
 
     void ClosestPointTo(Vector p, Point2d *puv, bool mustConverge=true);
-    void ClosestPointTo(Vector p, double *u, double *v, bool mustConverge=true);
+    void ClosestPointTo(Vector p, double *u, double *v, bool mustConverge=true,
+                        bool useCachedGuess=true);
+    void MakeSamples();
+    void MakeSplits();
     bool ClosestPointNewton(Vector p, double *u, double *v, bool mustConverge=true) const;
 
     bool PointIntersectingLine(Vector p0, Vector p1, double *u, double *v) const;
     Vector ClosestPointOnThisAndSurface(SSurface *srf2, Vector p);
-    void PointOnSurfaces(SSurface *s1, SSurface *s2, double *u, double *v);
+    void PointOnSurfaces(SSurface *s1, SSurface *s2, double *u, double *v,
+                         bool useCachedGuess=true);
     Vector PointAt(double u, double v) const;
     Vector PointAt(Point2d puv) const;
+    void PointsAt(const double *u, const double *v, Vector *pt, size_t n) const;
     void TangentsAt(double u, double v, Vector *tu, Vector *tv) const;
     Vector NormalAt(Point2d puv) const;
     Vector NormalAt(double u, double v) const;
@@ -344,6 +391,8 @@ public:
                         Vector *start, Vector *finish) const;
 
     void TriangulateInto(SShell *shell, SMesh *sm);
+    void MakeTriangulationKey(SShell *shell, std::vector<double> *key) const;
+    static void ClearTriangulationCache();
 
     // these are intended as bitmasks, even though there's just one now
     enum class MakeAs : uint32_t {
@@ -361,12 +410,66 @@ public:
     double ChordToleranceForEdge(Vector a, Vector b) const;
     void MakeTriangulationGridInto(List<double> *l, double vs, double vf,
                                     bool swapped) const;
-    Vector PointAtMaybeSwapped(double u, double v, bool swapped) const;
 
     void Reverse();
     void Clear();
 };
 
+// The tree of pieces that we get by recursively splitting a surface in half,
+// alternately in u and in v, until each piece is nearly flat. We split only
+// as deep as some line has needed so far.
+class SSurfaceSplits : public SSurfaceCache {
+public:
+    class Piece {
+    public:
+        SSurface    srf;
+        bool        flat;
+        // Our two halves are at child and child + 1, or -1 if not split yet
+        int         child;
+    };
+    std::vector<Piece>  piece;
+    // Flatness is judged against the chord tolerance.
+    double              chordTol;
+    // Held while walking the tree, since that may split more pieces.
+    std::mutex          mutex;
+
+    static const int MAX_PIECES = 16384;
+
+    static std::shared_ptr<SSurfaceSplits> From(const SSurface *srf,
+                                                double chordTol);
+    void AddPiece(const SSurface *srf);
+    void AllPointsIntersecting(int i, Vector a, Vector b,
+                               int *cnt, int *level,
+                               List<SSurface::Inter> *l, bool asSegment,
+                               SSurface *sorig);
+};
+
+// A bounding volume hierarchy over the surfaces of a shell, for finding the
+// few that a line might intersect without testing all of them.
+class SSurfaceBvh {
+public:
+    class Node {
+    public:
+        Vector      ptMax, ptMin;
+        // A leaf holds surfaces [first, first + n) of our index; otherwise
+        // our children are at the next node and at right.
+        int         first, n;
+        int         right;
+    };
+    std::vector<Node>   node;
+    std::vector<int>    index;
+    std::vector<Vector> ptMax, ptMin;
+
+    static const int LEAF_SURFACES = 4;
+
+    static std::shared_ptr<SSurfaceBvh> From(SShell *shell);
+    void Build(int first, int n);
+    static bool LineMightIntersectBox(Vector amax, Vector amin,
+                                      Vector a, Vector b, bool asSegment);
+    void SurfacesNearLine(Vector a, Vector b, bool asSegment,
+                          std::vector<int> *out) const;
+};
+
 class SShell {
 public:
     IdList<SCurve,hSCurve>      curve;
@@ -374,6 +477,9 @@ public:
 
     bool                        booleanFailed;
 
+    // Only while we're doing a Boolean, when our surfaces don't move.
+    std::shared_ptr<SSurfaceBvh> bvh;
+
     void MakeFromExtrusionOf(SBezierLoopSet *sbls, Vector t0, Vector t1,
                              RgbaColor color);
     void MakeFromRevolutionOf(SBezierLoopSet *sbls, Vector pt, Vector axis,
@@ -386,6 +492,9 @@ public:
     void CopySurfacesTrimAgainst(SShell *sha, SShell *shb, SShell *into, SSurface::CombineAs type);
     void MakeIntersectionCurvesAgainst(SShell *against, SShell *into);
     void MakeClassifyingBsps(SShell *useCurvesFrom);
+    void MakeSurfaceBvh();
+    void SurfacesNearLine(Vector a, Vector b, bool asSegment,
+                          std::vector<SSurface *> *out);
     void AllPointsIntersecting(Vector a, Vector b, List<SInter> *il,
                                 bool asSegment, bool trimmed, bool inclTangent);
     void MakeCoincidentEdgesInto(SSurface *proto, bool sameNormal,
@@ -64,6 +64,12 @@ void SPolygon::UvTriangulateInto(SMesh *m, SSurface *srf) {
             }
         }
 
+        // Index those edges for the bridge tests. The bridges that we add
+        // as we go are few, so they're kept in their own list.
+        SKdNodeEdges *kdtree = SKdNodeEdges::From(&el);
+        SEdgeList bl = {};
+        int cnt = 1;
+
 //        dbp("finished finding holes: %d ms", (int)(GetMilliseconds() - in));
         for(;;) {
             double xmin = 1e10;
@@ -79,7 +85,7 @@ void SPolygon::UvTriangulateInto(SMesh *m, SSurface *srf) {
             }
             if(!scmin) break;
 
-            if(!merged.BridgeToContour(scmin, &el, &vl)) {
+            if(!merged.BridgeToContour(scmin, kdtree, &cnt, &bl, &vl)) {
                 dbp("couldn't merge our hole");
                 return;
             }
@@ -92,6 +98,7 @@ void SPolygon::UvTriangulateInto(SMesh *m, SSurface *srf) {
 //        dbp("finished ear clippping: %d ms", (int)(GetMilliseconds() - in));
         merged.l.Clear();
         el.Clear();
+        bl.Clear();
         vl.Clear();
 
         // Careful, need to free the points within the contours, and not just
@@ -105,7 +112,30 @@ void SPolygon::UvTriangulateInto(SMesh *m, SSurface *srf) {
     }
 }
 
+bool SContour::SharesPointWith(const SContour *sc) const {
+    // Sort the other contour's points by x, so that we only need to test
+    // the few with an x coordinate close to each of our points.
+    std::vector<Vector> pts;
+    for(int i = 0; i < (sc->l.n - 1); i++) {
+        pts.push_back(sc->l.elem[i].p);
+    }
+    std::sort(pts.begin(), pts.end(), [](const Vector &a, const Vector &b) {
+        return a.x < b.x;
+    });
+
+    for(const SPoint &sp : l) {
+        Vector a = sp.p;
+        auto it = std::lower_bound(pts.begin(), pts.end(), a.x - 2*LENGTH_EPS,
+            [](const Vector &b, double x) { return b.x < x; });
+        for(; it != pts.end() && it->x <= a.x + 2*LENGTH_EPS; ++it) {
+            if(a.Equals(*it)) return true;
+        }
+    }
+    return false;
+}
+
 bool SContour::BridgeToContour(SContour *sc,
+                               SKdNodeEdges *avoidTree, int *avoidCnt,
                                SEdgeList *avoidEdges, List<Vector> *avoidPts)
 {
     int i, j;
@@ -137,22 +167,25 @@ bool SContour::BridgeToContour(SContour *sc,
     Vector a, b, *f;
 
     // First check if the contours share a point; in that case we should
-    // merge them there, without a bridge.
-    for(i = 0; i < l.n; i++) {
-        thisp = WRAP(i+thiso, l.n);
-        a = l.elem[thisp].p;
+    // merge them there, without a bridge. That's rare, and the search is
+    // quadratic, so skip it unless some point is shared at all.
+    if(SharesPointWith(sc)) {
+        for(i = 0; i < l.n; i++) {
+            thisp = WRAP(i+thiso, l.n);
+            a = l.elem[thisp].p;
 
-        for(f = avoidPts->First(); f; f = avoidPts->NextAfter(f)) {
-            if(f->Equals(a)) break;
-        }
-        if(f) continue;
+            for(f = avoidPts->First(); f; f = avoidPts->NextAfter(f)) {
+                if(f->Equals(a)) break;
+            }
+            if(f) continue;
 
-        for(j = 0; j < (sc->l.n - 1); j++) {
-            scp = WRAP(j+sco, (sc->l.n - 1));
-            b = sc->l.elem[scp].p;
+            for(j = 0; j < (sc->l.n - 1); j++) {
+                scp = WRAP(j+sco, (sc->l.n - 1));
+                b = sc->l.elem[scp].p;
 
-            if(a.Equals(b)) {
-                goto haveEdge;
+                if(a.Equals(b)) {
+                    goto haveEdge;
+                }
             }
         }
     }
@@ -176,7 +209,9 @@ bool SContour::BridgeToContour(SContour *sc,
             }
             if(f) continue;
 
-            if(avoidEdges->AnyEdgeCrossings(a, b) > 0) {
+            if(avoidTree->AnyEdgeCrossings(a, b, (*avoidCnt)++) > 0 ||
+               avoidEdges->AnyEdgeCrossings(a, b) > 0)
+            {
                 // doesn't work, bridge crosses an existing edge
             } else {
                 goto haveEdge;
@@ -286,6 +321,208 @@ void SContour::ClipEarInto(SMesh *m, int bp, double scaledEps) {
     l.RemoveTagged();
 }
 
+//-----------------------------------------------------------------------------
+// The ear clipping below is quadratic in the number of points, since every
+// ear test looks at every point and every clip shifts the whole list. That
+// hurts on faces with many holes, which get bridged into one long contour.
+// So for long contours we keep the points in a linked list, bin them into a
+// uniform grid for the ear tests, and keep the ears in an ordered set. This
+// clips exactly the same ears, in the same order, as the simple code.
+//-----------------------------------------------------------------------------
+class EarClipper {
+public:
+    std::vector<Vector>     pts;
+    std::vector<int>        prev, next;
+    std::vector<bool>       alive;
+    std::vector<EarType>    ear;
+    std::vector<double>     chordTol;
+    std::vector<bool>       haveChordTol;
+    std::set<int>           ears;
+    int                     head, tail, count;
+
+    Vector                  gridMin;
+    double                  gridInvX, gridInvY;
+    int                     gridW, gridH;
+    std::vector<std::vector<int>> grid;
+
+    EarClipper(const SContour *sc) {
+        count = sc->l.n;
+        for(int i = 0; i < count; i++) {
+            pts.push_back(sc->l.elem[i].p);
+            prev.push_back(WRAP(i-1, count));
+            next.push_back(WRAP(i+1, count));
+        }
+        alive.assign(count, true);
+        ear.assign(count, EarType::UNKNOWN);
+        chordTol.assign(count, 0);
+        haveChordTol.assign(count, false);
+        head = 0;
+        tail = count - 1;
+
+        Vector maxv = pts[0], minv = pts[0];
+        for(const Vector &p : pts) {
+            p.MakeMaxMin(&maxv, &minv);
+        }
+        gridMin = minv;
+        gridW = gridH = max(1, (int)sqrt((double)count));
+        double dx = maxv.x - minv.x, dy = maxv.y - minv.y;
+        gridInvX = (dx > 0) ? gridW/dx : 0;
+        gridInvY = (dy > 0) ? gridH/dy : 0;
+        grid.resize(gridW*gridH);
+        for(int i = 0; i < count; i++) {
+            grid[CellY(pts[i].y)*gridW + CellX(pts[i].x)].push_back(i);
+        }
+    }
+
+    static int Cell(double f, int n) {
+        f = floor(f);
+        if(f < 0) return 0;
+        if(f >= n) return n - 1;
+        return (int)f;
+    }
+    int CellX(double x) const { return Cell((x - gridMin.x)*gridInvX, gridW); }
+    int CellY(double y) const { return Cell((y - gridMin.y)*gridInvY, gridH); }
+
+    void SetEar(int i, EarType e) {
+        ear[i] = e;
+        if(e == EarType::EAR) {
+            ears.insert(i);
+        } else {
+            ears.erase(i);
+        }
+    }
+
+    // Same tests as SContour::IsEar, but only against the points in the grid
+    // cells that overlap the triangle's (slightly grown) bounding box.
+    bool IsEar(int bp, double scaledEps) const {
+        int ap = prev[bp],
+            cp = next[bp];
+
+        STriangle tr = {};
+        tr.a = pts[ap];
+        tr.b = pts[bp];
+        tr.c = pts[cp];
+
+        if((tr.a).Equals(tr.c)) return true;
+
+        Vector n = Vector::From(0, 0, -1);
+        if((tr.Normal()).Dot(n) < scaledEps) return false;
+
+        Vector maxv = tr.a, minv = tr.a;
+        (tr.b).MakeMaxMin(&maxv, &minv);
+        (tr.c).MakeMaxMin(&maxv, &minv);
+
+        int x0 = CellX(minv.x - LENGTH_EPS), x1 = CellX(maxv.x + LENGTH_EPS),
+            y0 = CellY(minv.y - LENGTH_EPS), y1 = CellY(maxv.y + LENGTH_EPS);
+        for(int y = y0; y <= y1; y++) {
+            for(int x = x0; x <= x1; x++) {
+                for(int i : grid[y*gridW + x]) {
+                    if(!alive[i]) continue;
+                    if(i == ap || i == bp || i == cp) continue;
+
+                    Vector p = pts[i];
+                    if(p.OutsideAndNotOn(maxv, minv)) continue;
+
+                    if(p.EqualsExactly(tr.a)) continue;
+                    if(p.EqualsExactly(tr.b)) continue;
+                    if(p.EqualsExactly(tr.c)) continue;
+
+                    if(tr.ContainsPointProjd(n, p)) return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    double ChordTolFor(int i, SSurface *srf) {
+        if(!haveChordTol[i]) {
+            chordTol[i] = srf->ChordToleranceForEdge(pts[prev[i]], pts[next[i]]);
+            haveChordTol[i] = true;
+        }
+        return chordTol[i];
+    }
+
+    void ClipEarInto(SMesh *m, int bp, double scaledEps) {
+        int ap = prev[bp],
+            cp = next[bp];
+
+        STriangle tr = {};
+        tr.a = pts[ap];
+        tr.b = pts[bp];
+        tr.c = pts[cp];
+        if(tr.Normal().MagSquared() < scaledEps*scaledEps) {
+            // Zero-area triangle, culled as in SContour::ClipEarInto.
+        } else {
+            m->AddTriangle(&tr);
+        }
+
+        next[ap] = cp;
+        prev[cp] = ap;
+        alive[bp] = false;
+        SetEar(bp, EarType::NOT_EAR);
+        if(bp == head) head = cp;
+        if(bp == tail) tail = ap;
+        count--;
+
+        SetEar(ap, EarType::UNKNOWN);
+        SetEar(cp, EarType::UNKNOWN);
+        haveChordTol[ap] = false;
+        haveChordTol[cp] = false;
+    }
+
+    bool TriangulateInto(SMesh *m, SSurface *srf, double scaledEps) {
+        bool planar = (srf->degm == 1 && srf->degn == 1);
+        for(int i = 0; i < count; i++) {
+            SetEar(i, IsEar(i, scaledEps) ? EarType::EAR : EarType::NOT_EAR);
+        }
+
+        // The simple code starts its search at the last point on every
+        // other pass, and otherwise at the first one.
+        bool toggle = false;
+        while(count > 3) {
+            int bestEar = -1;
+            toggle = !toggle;
+            if(planar) {
+                if(toggle && ear[tail] == EarType::EAR) {
+                    bestEar = tail;
+                } else if(!ears.empty()) {
+                    bestEar = *ears.begin();
+                }
+            } else {
+                double bestChordTol = VERY_POSITIVE;
+                auto consider = [&](int e) {
+                    double tol = ChordTolFor(e, srf);
+                    if(tol < bestChordTol - scaledEps) {
+                        bestEar = e;
+                        bestChordTol = tol;
+                    }
+                    return bestChordTol < 0.1*SS.ChordTolMm();
+                };
+                bool done = false;
+                if(toggle && ear[tail] == EarType::EAR) {
+                    done = consider(tail);
+                }
+                for(auto it = ears.begin(); !done && it != ears.end(); ++it) {
+                    if(toggle && *it == tail) continue;
+                    done = consider(*it);
+                }
+            }
+            if(bestEar < 0) return false;
+
+            int ap = prev[bestEar],
+                cp = next[bestEar];
+            ClipEarInto(m, bestEar, scaledEps);
+            if(count > 3) {
+                SetEar(ap, IsEar(ap, scaledEps) ? EarType::EAR : EarType::NOT_EAR);
+                SetEar(cp, IsEar(cp, scaledEps) ? EarType::EAR : EarType::NOT_EAR);
+            }
+        }
+
+        ClipEarInto(m, head, scaledEps); // add the last triangle
+        return true;
+    }
+};
+
 void SContour::UvTriangulateInto(SMesh *m, SSurface *srf) {
     Vector tu, tv;
     srf->TangentsAt(0.5, 0.5, &tu, &tv);
@@ -305,6 +542,22 @@ void SContour::UvTriangulateInto(SMesh *m, SSurface *srf) {
     }
     l.RemoveTagged();
 
+    // Short contours are cheap either way, so use the simple code for those.
+    if(l.n > 64) {
+        SMesh em = {};
+        EarClipper clipper(this);
+        if(clipper.TriangulateInto(&em, srf, scaledEps)) {
+            m->l.ReserveMore(em.l.n);
+            for(const STriangle &tr : em.l) {
+                m->AddTriangle(&tr);
+            }
+            em.Clear();
+            return;
+        }
+        em.Clear();
+        // If that failed, then fall through and let the simple code try.
+    }
+
     // Now calculate the ear-ness of each vertex
     for(i = 0; i < l.n; i++) {
         (l.elem[i]).ear = IsEar(i, scaledEps) ? EarType::EAR : EarType::NOT_EAR;
@@ -374,47 +627,115 @@ double SSurface::ChordToleranceForEdge(Vector a, Vector b) const {
     return sqrt(worst);
 }
 
-Vector SSurface::PointAtMaybeSwapped(double u, double v, bool swapped) const {
-    if(swapped) {
-        return PointAt(v, u);
-    } else {
-        return PointAt(u, v);
-    }
-}
-
 void SSurface::MakeTriangulationGridInto(List<double> *l, double vs, double vf,
                                          bool swapped) const
 {
-    double worst = 0;
+    // Each span in v is tested along four curves, at u = 0, 1/3, 2/3, 1, and
+    // subdivided until the worst chord tolerance of any of those is small
+    // enough. That's done breadth-first, so that we can evaluate all the
+    // new points at each level in a single batch.
+    struct Span {
+        double  vs, vf;
+        Vector  ps[4], pf[4];
+        bool    done;
+    };
+    double step = 1.0/SS.GetMaxSegments();
 
-    // Try piecewise linearizing four curves, at u = 0, 1/3, 2/3, 1; choose
-    // the worst chord tolerance of any of those.
-    int i;
-    for(i = 0; i <= 3; i++) {
-        double u = i/3.0;
+    std::vector<double> pu, pv;
+    std::vector<Vector> pts;
+    // Evaluate all of the queued (u, v) points, in the same order.
+    auto evaluate = [&]() {
+        pts.resize(pu.size());
+        if(!pts.empty()) {
+            if(swapped) {
+                PointsAt(&pv[0], &pu[0], &pts[0], pts.size());
+            } else {
+                PointsAt(&pu[0], &pv[0], &pts[0], pts.size());
+            }
+        }
+        pu.clear();
+        pv.clear();
+    };
+    auto queue = [&](double v) {
+        for(int i = 0; i <= 3; i++) {
+            pu.push_back(i/3.0);
+            pv.push_back(v);
+        }
+    };
+
+    std::vector<Span> spans(1);
+    spans[0].vs = vs;
+    spans[0].vf = vf;
+    spans[0].done = false;
+    queue(vs);
+    queue(vf);
+    evaluate();
+    for(int i = 0; i <= 3; i++) {
+        spans[0].ps[i] = pts[i];
+        spans[0].pf[i] = pts[4 + i];
+    }
 
+    std::vector<Span> next;
+    for(;;) {
         // This chord test should be identical to the one in SBezier::MakePwl
         // to make the piecewise linear edges line up with the grid more or
         // less.
-        Vector ps = PointAtMaybeSwapped(u, vs, swapped),
-               pf = PointAtMaybeSwapped(u, vf, swapped);
-
-        double vm1 = (2*vs + vf) / 3,
-               vm2 = (vs + 2*vf) / 3;
+        for(const Span &sp : spans) {
+            if(sp.done) continue;
+            queue((2*sp.vs + sp.vf) / 3);
+            queue((sp.vs + 2*sp.vf) / 3);
+        }
+        if(pu.empty()) break;
+        evaluate();
+
+        next.clear();
+        size_t j = 0;
+        for(Span &sp : spans) {
+            if(sp.done) {
+                next.push_back(sp);
+                continue;
+            }
+            const Vector *pm1 = &pts[j], *pm2 = &pts[j + 4];
+            j += 8;
+
+            double worst = 0;
+            for(int i = 0; i <= 3; i++) {
+                Vector dir = sp.pf[i].Minus(sp.ps[i]);
+                worst = max(worst, pm1[i].DistanceToLine(sp.ps[i], dir));
+                worst = max(worst, pm2[i].DistanceToLine(sp.ps[i], dir));
+            }
 
-        Vector pm1 = PointAtMaybeSwapped(u, vm1, swapped),
-               pm2 = PointAtMaybeSwapped(u, vm2, swapped);
+            if((sp.vf - sp.vs) < step || worst < SS.ChordTolMm()) {
+                sp.done = true;
+            }
+            next.push_back(sp);
+        }
 
-        worst = max(worst, pm1.DistanceToLine(ps, pf.Minus(ps)));
-        worst = max(worst, pm2.DistanceToLine(ps, pf.Minus(ps)));
+        // Split the spans that failed our test at their midpoints.
+        for(const Span &sp : next) {
+            if(!sp.done) queue((sp.vs + sp.vf)/2);
+        }
+        evaluate();
+        spans.clear();
+        j = 0;
+        for(const Span &sp : next) {
+            if(sp.done) {
+                spans.push_back(sp);
+                continue;
+            }
+            Span a = sp, b = sp;
+            a.vf = b.vs = (sp.vs + sp.vf)/2;
+            for(int i = 0; i <= 3; i++) {
+                a.pf[i] = b.ps[i] = pts[j + i];
+            }
+            j += 4;
+            spans.push_back(a);
+            spans.push_back(b);
+        }
     }
 
-    double step = 1.0/SS.GetMaxSegments();
-    if((vf - vs) < step || worst < SS.ChordTolMm()) {
-        l->Add(&vf);
-    } else {
-        MakeTriangulationGridInto(l, vs, (vs+vf)/2, swapped);
-        MakeTriangulationGridInto(l, (vs+vf)/2, vf, swapped);
+    for(const Span &sp : spans) {
+        l->Add(&sp.vf);
     }
 }
 
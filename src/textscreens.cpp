@@ -229,6 +229,12 @@ void TextWindow::ScreenChangeGroupOption(int link, uint32_t v) {
         case 'd': g->allDimsReference = !(g->allDimsReference); break;
 
         case 'f': g->forceToMesh = !(g->forceToMesh); break;
+
+        case 'm':
+            g->linkMeshOnly = !(g->linkMeshOnly);
+            // Bring in the rest of the entities, or leave them out.
+            SS.ReloadAllLinked(SS.saveFile);
+            break;
     }
 
     SS.MarkGroupDirty(g->h);
@@ -355,6 +361,9 @@ void TextWindow::ShowGroupInfo() {
         Printf(false, "%Bd   %Ftscaled by%E %# %Fl%Ll%f%D[change]%E",
             g->scale,
             &TextWindow::ScreenChangeGroupScale, g->h.v);
+        Printf(false, "%Ba   %Fd%f%Lm%s  link only its mesh and faces",
+            &TextWindow::ScreenChangeGroupOption,
+            g->linkMeshOnly ? CHECK_TRUE : CHECK_FALSE);
     } else if(g->type == Group::Type::DRAWING_3D) {
         Printf(true, " %Ftsketch in 3d%E");
     } else if(g->type == Group::Type::DRAWING_WORKPLANE) {
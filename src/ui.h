@@ -67,6 +67,7 @@ struct FileFilter {
 // SolveSpace native file format
 const FileFilter SlvsFileFilter[] = {
     { N_("SolveSpace models"),          { "slvs" } },
+    { N_("SolveSpace binary models"),   { "slvsb" } },
     { NULL, {} }
 };
 // PNG format bitmap
@@ -80,6 +81,7 @@ const FileFilter MeshFileFilter[] = {
     { N_("Wavefront OBJ mesh"),         { "obj" } },
     { N_("Three.js-compatible mesh, with viewer"),  { "html" } },
     { N_("Three.js-compatible mesh, mesh only"),    { "js" } },
+    { N_("Binary glTF mesh"),           { "glb" } },
     { NULL, {} }
 };
 // NURBS surfaces
@@ -532,6 +534,7 @@ public:
     static void ScreenChangeBackFaces(int link, uint32_t v);
     static void ScreenChangeShowContourAreas(int link, uint32_t v);
     static void ScreenChangeCheckClosedContour(int link, uint32_t v);
+    static void ScreenChangeSaveRegenCache(int link, uint32_t v);
     static void ScreenChangePwlCurves(int link, uint32_t v);
     static void ScreenChangeCanvasSizeAuto(int link, uint32_t v);
     static void ScreenChangeCanvasSize(int link, uint32_t v);
@@ -8,6 +8,7 @@
 #include "solvespace.h"
 
 void SolveSpaceUI::UndoRemember() {
+    DiscardRegenCache();
     unsaved = true;
     PushFromCurrentOnto(&undo);
     UndoClearStack(&redo);
@@ -35,9 +36,68 @@ void SolveSpaceUI::UndoEnableMenus() {
     EnableMenuByCmd(Command::REDO, redo.cnt > 0);
 }
 
-void SolveSpaceUI::PushFromCurrentOnto(UndoStack *uk) {
-    int i;
+namespace {
+typedef SolveSpaceUI::EntityRemap EntityRemap;
+
+// Record the items of a list in handle order, sharing each one that's the
+// same as in the state recorded last, and copying only those that changed.
+template<class T, class H, class Same>
+void RememberItems(IdList<T,H> *list, const SolveSpaceUI::UndoItems<T> &last,
+                   SolveSpaceUI::UndoItems<T> *items, Same same) {
+    items->reserve(list->n);
+    size_t j = 0;
+    for(int i = 0; i < list->n; i++) {
+        const T &t = list->elem[list->iti[i].i];
+        while(j < last.size() && last[j]->h.v < t.h.v) j++;
+        if(j < last.size() && last[j]->h.v == t.h.v && same(*last[j], t)) {
+            items->push_back(last[j]);
+        } else {
+            items->push_back(std::make_shared<const T>(t));
+        }
+    }
+}
 
+template<class T, class H>
+void RestoreItems(const SolveSpaceUI::UndoItems<T> &items, IdList<T,H> *list) {
+    list->ReserveMore((int)items.size());
+    for(const std::shared_ptr<const T> &t : items) {
+        T item = *t;
+        list->Add(&item);
+    }
+}
+
+// Groups are compared with the generated stuff zeroed out, and without
+// their remap, which is compared on its own.
+bool SameGroup(const Group &a, const Group &b) {
+    return SS.SameUsingTable('g', &a, &b) &&
+           a.suppressDofCalculation == b.suppressDofCalculation &&
+           a.dofCheckOk == b.dofCheckOk &&
+           a.booleanFailed == b.booleanFailed &&
+           a.displayDirty == b.displayDirty;
+}
+
+bool SameRemap(EntityRemap *a, EntityRemap *b) {
+    if(a->n != b->n) return false;
+    for(int i = 0; i < a->n; i++) {
+        const EntityMap &ea = a->elem[a->iti[i].i],
+                        &eb = b->elem[b->iti[i].i];
+        if(ea.h.v != eb.h.v || ea.input.v != eb.input.v ||
+           ea.copyNumber != eb.copyNumber) return false;
+    }
+    return true;
+}
+
+std::shared_ptr<EntityRemap> CopyRemap(EntityRemap *src) {
+    EntityRemap *remap = new EntityRemap {};
+    src->DeepCopyInto(remap);
+    return std::shared_ptr<EntityRemap>(remap, [](EntityRemap *remap) {
+        remap->Clear();
+        delete remap;
+    });
+}
+}
+
+void SolveSpaceUI::PushFromCurrentOnto(UndoStack *uk) {
     if(uk->cnt == MAX_UNDO) {
         UndoClearState(&(uk->d[uk->write]));
         // And then write in to this one again
@@ -45,15 +105,25 @@ void SolveSpaceUI::PushFromCurrentOnto(UndoStack *uk) {
         (uk->cnt)++;
     }
 
-    UndoState *ut = &(uk->d[uk->write]);
+    UndoRememberState(&(uk->d[uk->write]));
+
+    uk->write = WRAP(uk->write + 1, MAX_UNDO);
+}
+
+// Record the current state of the sketch, sharing with the state recorded
+// or restored last every item that didn't change since.
+void SolveSpaceUI::UndoRememberState(UndoState *ut) {
     *ut = {};
-    ut->group.ReserveMore(SK.group.n);
-    for(i = 0; i < SK.group.n; i++) {
-        Group *src = &(SK.group.elem[i]);
+    ut->group.reserve(SK.group.n);
+    ut->remap.reserve(SK.group.n);
+    size_t j = 0;
+    for(int i = 0; i < SK.group.n; i++) {
+        Group *src = &(SK.group.elem[SK.group.iti[i].i]);
         Group dest = *src;
-        // And then clean up all the stuff that needs to be a deep copy,
-        // and zero out all the dynamic stuff that will get regenerated.
+        // Zero out all the dynamic stuff that will get regenerated; the
+        // remap is kept on its own, and shared if it didn't change.
         dest.clean = false;
+        dest.regenCached = false;
         dest.solved = {};
         dest.polyLoops = {};
         dest.bezierLoops = {};
@@ -65,39 +135,53 @@ void SolveSpaceUI::PushFromCurrentOnto(UndoStack *uk) {
         dest.runningShell = {};
         dest.displayMesh = {};
         dest.displayOutlines = {};
-
+        dest.displayLodHash = 0;
+        dest.displayLodBuilt = false;
+        for(int i = 0; i < Group::DISPLAY_LOD_LEVELS; i++) {
+            dest.displayLodMesh[i] = {};
+            dest.displayLodError[i] = 0.0;
+        }
         dest.remap = {};
-        src->remap.DeepCopyInto(&(dest.remap));
-
         dest.impMesh = {};
         dest.impShell = {};
         dest.impEntity = {};
-        ut->group.Add(&dest);
-    }
-    for(i = 0; i < SK.groupOrder.n; i++) {
-        ut->groupOrder.Add(&(SK.groupOrder.elem[i]));
-    }
-    ut->request.ReserveMore(SK.request.n);
-    for(i = 0; i < SK.request.n; i++) {
-        ut->request.Add(&(SK.request.elem[i]));
-    }
-    ut->constraint.ReserveMore(SK.constraint.n);
-    for(i = 0; i < SK.constraint.n; i++) {
-        Constraint *src = &(SK.constraint.elem[i]);
-        Constraint dest = *src;
-        ut->constraint.Add(&dest);
-    }
-    ut->param.ReserveMore(SK.param.n);
-    for(i = 0; i < SK.param.n; i++) {
-        ut->param.Add(&(SK.param.elem[i]));
+
+        const UndoState &last = undoLast;
+        while(j < last.group.size() && last.group[j]->h.v < src->h.v) j++;
+        bool inLast = (j < last.group.size() && last.group[j]->h.v == src->h.v);
+        if(inLast && SameGroup(*last.group[j], dest)) {
+            ut->group.push_back(last.group[j]);
+        } else {
+            ut->group.push_back(std::make_shared<const Group>(dest));
+        }
+        if(inLast && SameRemap(last.remap[j].get(), &src->remap)) {
+            ut->remap.push_back(last.remap[j]);
+        } else {
+            ut->remap.push_back(CopyRemap(&src->remap));
+        }
     }
-    ut->style.ReserveMore(SK.style.n);
-    for(i = 0; i < SK.style.n; i++) {
-        ut->style.Add(&(SK.style.elem[i]));
+    for(int i = 0; i < SK.groupOrder.n; i++) {
+        ut->groupOrder.push_back(SK.groupOrder.elem[i]);
     }
+    RememberItems(&SK.request, undoLast.request, &ut->request,
+        [](const Request &a, const Request &b) {
+            return SS.SameUsingTable('r', &a, &b);
+        });
+    RememberItems(&SK.constraint, undoLast.constraint, &ut->constraint,
+        [](const Constraint &a, const Constraint &b) {
+            return SS.SameUsingTable('c', &a, &b);
+        });
+    RememberItems(&SK.param, undoLast.param, &ut->param,
+        [](const Param &a, const Param &b) {
+            return memcmp(&a.val, &b.val, sizeof(double)) == 0 &&
+                   a.known == b.known && a.free == b.free;
+        });
+    RememberItems(&SK.style, undoLast.style, &ut->style,
+        [](const Style &a, const Style &b) {
+            return SS.SameUsingTable('s', &a, &b) && a.zIndex == b.zIndex;
+        });
     ut->activeGroup = SS.GW.activeGroup;
-
-    uk->write = WRAP(uk->write + 1, MAX_UNDO);
+    undoLast = *ut;
 }
 
 void SolveSpaceUI::PopOntoCurrentFrom(UndoStack *uk) {
@@ -121,17 +205,25 @@ void SolveSpaceUI::PopOntoCurrentFrom(UndoStack *uk) {
     SK.param.Clear();
     SK.style.Clear();
 
-    // And then do a shallow copy of the state from the undo list
-    ut->group.MoveSelfInto(&(SK.group));
-    for(i = 0; i < ut->groupOrder.n; i++)
-        SK.groupOrder.Add(&ut->groupOrder.elem[i]);
-    ut->request.MoveSelfInto(&(SK.request));
-    ut->constraint.MoveSelfInto(&(SK.constraint));
-    ut->param.MoveSelfInto(&(SK.param));
-    ut->style.MoveSelfInto(&(SK.style));
+    // And then copy the state out of the undo list; the items themselves
+    // stay there, since later states may be sharing them.
+    SK.group.ReserveMore((int)ut->group.size());
+    for(size_t j = 0; j < ut->group.size(); j++) {
+        Group g = *ut->group[j];
+        ut->remap[j]->DeepCopyInto(&g.remap);
+        SK.group.Add(&g);
+    }
+    for(hGroup hg : ut->groupOrder) {
+        SK.groupOrder.Add(&hg);
+    }
+    RestoreItems(ut->request, &SK.request);
+    RestoreItems(ut->constraint, &SK.constraint);
+    RestoreItems(ut->param, &SK.param);
+    RestoreItems(ut->style, &SK.style);
     SS.GW.activeGroup = ut->activeGroup;
 
-    // No need to free it, since a shallow copy was made above
+    // This is now the state that the next one recorded is shared with.
+    undoLast = *ut;
     *ut = {};
 
     // And reset the state everywhere else in the program, since the
@@ -157,17 +249,38 @@ void SolveSpaceUI::UndoClearStack(UndoStack *uk) {
 }
 
 void SolveSpaceUI::UndoClearState(UndoState *ut) {
-    int i;
-    for(i = 0; i < ut->group.n; i++) {
-        Group *g = &(ut->group.elem[i]);
+    ut->Clear();
+}
 
-        g->remap.Clear();
+// The memory taken by the undo and redo history, counting each item once
+// however many states are sharing it.
+size_t SolveSpaceUI::UndoMemoryUsed() {
+    std::unordered_set<const void *> seen;
+    size_t size = 0;
+    std::vector<const UndoState *> states;
+    for(int i = 0; i < undo.cnt; i++) {
+        states.push_back(&undo.d[WRAP(undo.write - 1 - i, MAX_UNDO)]);
     }
-    ut->group.Clear();
-    ut->request.Clear();
-    ut->constraint.Clear();
-    ut->param.Clear();
-    ut->style.Clear();
-    *ut = {};
-}
+    for(int i = 0; i < redo.cnt; i++) {
+        states.push_back(&redo.d[WRAP(redo.write - 1 - i, MAX_UNDO)]);
+    }
+    states.push_back(&undoLast);
 
+    for(const UndoState *ut : states) {
+        auto count = [&](const void *item, size_t itemSize) {
+            size += sizeof(std::shared_ptr<const void>);
+            if(seen.insert(item).second) size += itemSize;
+        };
+        for(const auto &g : ut->group)      count(g.get(), sizeof(Group));
+        for(const auto &r : ut->request)    count(r.get(), sizeof(Request));
+        for(const auto &c : ut->constraint) count(c.get(), sizeof(Constraint));
+        for(const auto &p : ut->param)      count(p.get(), sizeof(Param));
+        for(const auto &s : ut->style)      count(s.get(), sizeof(Style));
+        for(const auto &m : ut->remap) {
+            count(m.get(), sizeof(EntityRemap) +
+                m->elemsAllocated * (sizeof(EntityMap) + sizeof(IdToI)));
+        }
+        size += ut->groupOrder.size() * sizeof(hGroup);
+    }
+    return size;
+}
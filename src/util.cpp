@@ -26,6 +26,60 @@ std::string SolveSpace::ssprintf(const char *fmt, ...)
     return result;
 }
 
+//-----------------------------------------------------------------------------
+// Append v, formatted exactly as printf("%.*f", precision, v) would do, but
+// quickly. That's the decimal closest to v, which is also the one closest to
+// v * 10^precision computed in floating point, unless the product lands too
+// close to halfway between two integers for its rounding error to be ruled
+// out; so that (rare) case, and large or non-finite values, go to printf.
+//-----------------------------------------------------------------------------
+void SolveSpace::FormatFixedInto(std::string *dest, double v, int precision) {
+    static const uint64_t pow10[] = {
+        1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+        10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+        100000000000ull, 1000000000000ull, 10000000000000ull,
+        100000000000000ull, 1000000000000000ull
+    };
+
+    if(precision >= 0 && precision <= 15 && std::isfinite(v)) {
+        double y = fabs(v) * (double)pow10[precision];
+        if(y < 4503599627370496.0) { // 2^52, so the fraction below is exact
+            double ip = floor(y), frac = y - ip;
+            double ulp = nextafter(y, HUGE_VAL) - y;
+            if(fabs(frac - 0.5) > ulp) {
+                uint64_t k = (uint64_t)ip + (frac > 0.5 ? 1 : 0);
+                if(std::signbit(v)) *dest += '-';
+                FormatUnsignedInto(dest, k / pow10[precision]);
+                if(precision > 0) {
+                    char digits[16];
+                    uint64_t f = k % pow10[precision];
+                    for(int i = precision - 1; i >= 0; i--) {
+                        digits[i] = (char)('0' + f % 10);
+                        f /= 10;
+                    }
+                    *dest += '.';
+                    dest->append(digits, precision);
+                }
+                return;
+            }
+        }
+    }
+
+    char buf[512];
+    snprintf(buf, sizeof(buf), "%.*f", precision, v);
+    *dest += buf;
+}
+
+void SolveSpace::FormatUnsignedInto(std::string *dest, uint64_t v) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while(v != 0);
+    dest->append(digits + sizeof(digits) - n, n);
+}
+
 char32_t utf8_iterator::operator*()
 {
     const uint8_t *it = (const uint8_t*) this->p;
@@ -54,6 +108,82 @@ int64_t SolveSpace::GetMilliseconds()
     return std::chrono::duration_cast<std::chrono::milliseconds>(timestamp).count();
 }
 
+//-----------------------------------------------------------------------------
+// Call fn(i) for every i in [0, n), spread across all the available cores.
+// The calls happen concurrently and in no particular order, so fn must only
+// write to state that belongs to its own index. The threads are started the
+// first time they're needed, and then kept waiting for the next call; a call
+// made while they're busy (from fn, or from another thread) runs serially.
+//-----------------------------------------------------------------------------
+namespace {
+class WorkerPool {
+public:
+    std::mutex                  busy;
+    std::mutex                  mutex;
+    std::condition_variable     wake;
+    std::condition_variable     done;
+    std::vector<std::thread>    threads;
+    const std::function<void()> *job = NULL;
+    uint64_t                    generation = 0;
+    size_t                      working = 0;
+
+    void Run(size_t threadCount, const std::function<void()> &work) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while(threads.size() + 1 < threadCount) {
+            threads.emplace_back([this]() { Loop(); });
+        }
+        job = &work;
+        generation++;
+        working = threads.size();
+        wake.notify_all();
+        lock.unlock();
+
+        work();
+
+        lock.lock();
+        done.wait(lock, [&]() { return working == 0; });
+        job = NULL;
+    }
+
+    void Loop() {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for(;;) {
+            wake.wait(lock, [&]() { return generation != seen; });
+            seen = generation;
+            const std::function<void()> *work = job;
+            lock.unlock();
+            (*work)();
+            lock.lock();
+            if(--working == 0) done.notify_one();
+        }
+    }
+};
+}
+
+void SolveSpace::ParallelFor(size_t n, const std::function<void(size_t)> &fn)
+{
+    // Never destroyed; the threads are still waiting on it when we exit.
+    static WorkerPool *pool = new WorkerPool;
+
+    size_t threadCount = std::min((size_t)std::thread::hardware_concurrency(), n);
+    std::unique_lock<std::mutex> busy(pool->busy, std::defer_lock);
+    if(threadCount <= 1 || !busy.try_lock()) {
+        for(size_t i = 0; i < n; i++) fn(i);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::function<void()> worker = [&]() {
+        for(;;) {
+            size_t i = next++;
+            if(i >= n) break;
+            fn(i);
+        }
+    };
+    pool->Run(threadCount, worker);
+}
+
 void SolveSpace::MakeMatrix(double *mat,
                             double a11, double a12, double a13, double a14,
                             double a21, double a22, double a23, double a24,
@@ -0,0 +1,103 @@
+#include "harness.h"
+
+static std::string FormatFixed(double v, int precision) {
+    std::string str;
+    FormatFixedInto(&str, v, precision);
+    return str;
+}
+
+static std::string FormatUnsigned(uint64_t v) {
+    std::string str;
+    FormatUnsignedInto(&str, v);
+    return str;
+}
+
+TEST_CASE(fixed_edge_values) {
+    static const double values[] = {
+        0.0, -0.0, 1.0, -1.0, 0.1, -0.1, 1e-300, -1e-300, 4.9e-324,
+        // Exact ties, which printf rounds to even.
+        0.5, 1.5, 2.5, -0.5, -2.5, 0.125, 0.375, -0.625, 1.0625,
+        // Close to ties, but not on them.
+        0.15, 0.25000000000000006, 2.675, 1.005, 1.0049999999999999,
+        // Large magnitudes.
+        1e15, 1e16, 1e20, -1e20, 1e300, -1e300,
+        std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(),
+        9007199254740993.0, 4503599627370495.5, 4503599627370496.0,
+        // Non-finite.
+        INFINITY, -INFINITY, NAN,
+    };
+    for(double v : values) {
+        for(int precision = 0; precision <= 17; precision++) {
+            CHECK_EQ_STR(FormatFixed(v, precision), ssprintf("%.*f", precision, v));
+        }
+    }
+}
+
+TEST_CASE(fixed_near_threshold) {
+    // Values whose scaled magnitude is around 2^52, where formatting goes
+    // from the fast path to printf.
+    for(int precision = 0; precision <= 15; precision++) {
+        double threshold = 4503599627370496.0 / pow(10.0, precision);
+        double v = threshold;
+        for(int i = 0; i < 64; i++) v = nextafter(v, 0.0);
+        for(int i = 0; i < 128; i++) {
+            CHECK_EQ_STR(FormatFixed(v, precision), ssprintf("%.*f", precision, v));
+            CHECK_EQ_STR(FormatFixed(-v, precision), ssprintf("%.*f", precision, -v));
+            v = nextafter(v, HUGE_VAL);
+        }
+    }
+}
+
+TEST_CASE(fixed_ties) {
+    // Halfway between two decimals, as near as a double gets; some of these
+    // are exact ties, and the rest fall on either side.
+    uint32_t seed = 1;
+    auto random = [&]() {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 8) & 0xffff;
+    };
+    for(int i = 0; i < 10000; i++) {
+        int precision = (int)(random() % 8);
+        double v = (random() + 0.5) / pow(10.0, precision);
+        if(random() % 2) v = -v;
+        CHECK_EQ_STR(FormatFixed(v, precision), ssprintf("%.*f", precision, v));
+    }
+}
+
+TEST_CASE(fixed_random) {
+    uint64_t seed = 1;
+    auto random = [&]() {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        return seed;
+    };
+    for(int i = 0; i < 10000; i++) {
+        // Any bit pattern, so all magnitudes and signs, and NaNs too.
+        uint64_t bits = random();
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        int precision = (int)(random() >> 60);
+        CHECK_EQ_STR(FormatFixed(v, precision), ssprintf("%.*f", precision, v));
+
+        // And the kind of values that get exported.
+        v = (double)(int64_t)(random() >> 24) / 1e6 - 5e9;
+        CHECK_EQ_STR(FormatFixed(v, 10), ssprintf("%.10f", v));
+    }
+}
+
+TEST_CASE(unsigned_values) {
+    static const uint64_t values[] = {
+        0, 1, 9, 10, 11, 99, 100, 4294967295ull, 4294967296ull,
+        999999999999999999ull, 1000000000000000000ull,
+        9999999999999999999ull, 10000000000000000000ull, UINT64_MAX,
+    };
+    for(uint64_t v : values) {
+        CHECK_EQ_STR(FormatUnsigned(v), ssprintf("%llu", (unsigned long long)v));
+    }
+
+    uint64_t seed = 1;
+    for(int i = 0; i < 1000; i++) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        uint64_t v = seed >> (seed % 64);
+        CHECK_EQ_STR(FormatUnsigned(v), ssprintf("%llu", (unsigned long long)v));
+    }
+}
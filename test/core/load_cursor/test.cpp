@@ -0,0 +1,59 @@
+#include "harness.h"
+
+static std::string ParseDouble(const std::string &str) {
+    SolveSpaceUI::LoadCursor cursor = {};
+    cursor.line    = str.data();
+    cursor.lineEnd = str.data() + str.size();
+    cursor.field   = cursor.line;
+    cursor.next    = cursor.lineEnd;
+    cursor.end     = cursor.lineEnd;
+
+    double v;
+    if(!cursor.Double(&v)) return "(failed)";
+    // %a shows every bit of the value, including the sign of a zero.
+    return ssprintf("%a", v);
+}
+
+static std::string Strtod(const std::string &str) {
+    char *end;
+    double v = strtod(str.c_str(), &end);
+    if(end == str.c_str()) return "(failed)";
+    return ssprintf("%a", v);
+}
+
+TEST_CASE(double_edge_values) {
+    static const char *values[] = {
+        "0", "-0", "0.00000000000000000000", "-0.00000000000000000000", "+7",
+        "1", "-1", "0.1", "0.30000000000000004", "0.10000000000000000555",
+        "123.45678901234567890123", "-12.34567890123456789012",
+        // More than 19 significant digits.
+        "9007199254740993", "9007199254740993.00000000000000000001",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "1.00000000000000011102230246251565404236316680908203124",
+        "123456789012345678901234567890.5",
+        "0.00000000000000000000000000000000000000012345678901234567890123",
+        // Exponents, which take the slow path.
+        "1e22", "1E23", "1e-22", "1e-23", "1.7976931348623157e308",
+        "2.2250738585072014e-308", "4.9406564584124654e-324", "1e-400",
+        "-1e-400", "1e400",
+        // Not numbers, or with trailing junk.
+        "", "-", ".", "abc", "12abc", "  3.5",
+    };
+    for(const char *value : values) {
+        CHECK_EQ_STR(ParseDouble(value), Strtod(value));
+    }
+}
+
+TEST_CASE(double_saved_values) {
+    // Values as they're written to savefiles; mostly the fast paths.
+    uint64_t state = 1;
+    for(int i = 0; i < 1000; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        double mantissa = (double)(state >> 11) / (double)(1ULL << 53);
+        int exponent = (int)((state >> 3) % 25) - 12;
+        double v = mantissa * pow(10.0, exponent);
+        if(state & 1) v = -v;
+        std::string str = ssprintf("%.20f", v);
+        CHECK_EQ_STR(ParseDouble(str), Strtod(str));
+    }
+}
@@ -0,0 +1,486 @@
+#include "harness.h"
+
+// A closed cylinder along z, finely tessellated: the side is one smooth face,
+// and each cap is a flat face of its own, so the two circles are sharp edges.
+static void MakeCylinder(SMesh *m, double r, double h, int segments, int rings) {
+    auto onSide = [&](int i, double z) {
+        double theta = 2 * PI * (i % segments) / segments;
+        return Vector::From(r * cos(theta), r * sin(theta), z);
+    };
+    auto add = [&](uint32_t face, Vector a, Vector b, Vector c,
+                   Vector an, Vector bn, Vector cn) {
+        STriangle tr = {};
+        tr.meta.face  = face;
+        tr.meta.color = RgbaColor::From(128, 128, 128);
+        tr.a  = a;  tr.b  = b;  tr.c  = c;
+        tr.an = an; tr.bn = bn; tr.cn = cn;
+        m->AddTriangle(&tr);
+    };
+    auto sideNormal = [&](Vector p) {
+        return Vector::From(p.x, p.y, 0).WithMagnitude(1);
+    };
+
+    for(int i = 0; i < segments; i++) {
+        for(int j = 0; j < rings; j++) {
+            Vector a = onSide(i, h * j / rings),     b = onSide(i + 1, h * j / rings),
+                   c = onSide(i + 1, h * (j + 1) / rings), d = onSide(i, h * (j + 1) / rings);
+            add(1, a, b, c, sideNormal(a), sideNormal(b), sideNormal(c));
+            add(1, a, c, d, sideNormal(a), sideNormal(c), sideNormal(d));
+        }
+    }
+
+    // The caps in rings too, so that there's something to take out of them.
+    Vector up = Vector::From(0, 0, 1), down = Vector::From(0, 0, -1);
+    for(int i = 0; i < segments; i++) {
+        for(int j = 0; j < rings; j++) {
+            double r0 = (double)j / rings, r1 = (double)(j + 1) / rings;
+            Vector a = onSide(i, 0).ScaledBy(r0),     b = onSide(i + 1, 0).ScaledBy(r0),
+                   c = onSide(i + 1, 0).ScaledBy(r1), d = onSide(i, 0).ScaledBy(r1);
+            Vector top = Vector::From(0, 0, h);
+            if(j > 0) {
+                add(2, a.Plus(top), c.Plus(top), b.Plus(top), up, up, up);
+                add(3, a, b, c, down, down, down);
+            }
+            add(2, a.Plus(top), d.Plus(top), c.Plus(top), up, up, up);
+            add(3, a, c, d, down, down, down);
+        }
+    }
+}
+
+static double DistanceToTriangle(Vector p, const STriangle &tr) {
+    Vector n = tr.Normal();
+    if(n.Magnitude() > LENGTH_EPS) {
+        n = n.WithMagnitude(1);
+        Vector pp = p.Minus(n.ScaledBy(n.Dot(p.Minus(tr.a))));
+        if(tr.ContainsPointProjd(n, pp)) return fabs(n.Dot(p.Minus(tr.a)));
+    }
+    double d = VERY_POSITIVE;
+    for(int i = 0; i < 3; i++) {
+        Vector a = tr.vertices[i], b = tr.vertices[(i + 1) % 3];
+        Vector ab = b.Minus(a);
+        double t = (ab.MagSquared() > 0) ? p.Minus(a).Dot(ab) / ab.MagSquared() : 0;
+        t = max(0.0, min(1.0, t));
+        d = min(d, p.Minus(a.Plus(ab.ScaledBy(t))).Magnitude());
+    }
+    return d;
+}
+
+static bool IsClosed(SMesh *m) {
+    SEdgeList el = {};
+    bool inters, leaks;
+    SKdNode::From(m)->MakeCertainEdgesInto(&el,
+        EdgeKind::NAKED_OR_SELF_INTER, /*coplanarIsInter=*/false, &inters, &leaks);
+    el.Clear();
+    return !leaks;
+}
+
+TEST_CASE(decimate_budget) {
+    SMesh m = {}, d = {};
+    MakeCylinder(&m, 10, 20, 128, 16);
+    CHECK_TRUE(m.l.n == 2 * 128 * 16 + 2 * 128 * (2 * 16 - 1));
+
+    m.MakeDecimatedInto(&d, 1000, 0);
+    CHECK_TRUE(d.l.n <= 1000);
+    CHECK_TRUE(d.l.n > 0);
+    CHECK_TRUE(IsClosed(&d));
+
+    m.Clear();
+    d.Clear();
+}
+
+TEST_CASE(decimate_error) {
+    SMesh m = {}, d = {};
+    MakeCylinder(&m, 10, 20, 128, 16);
+
+    const double maxError = 0.01;
+    m.MakeDecimatedInto(&d, 0, maxError);
+    CHECK_TRUE(d.l.n < m.l.n / 10);
+    CHECK_TRUE(IsClosed(&d));
+
+    // The decimated surface doesn't stray from the original by more than the
+    // error bound; every vertex it has is one of the original ones, and every
+    // original vertex is close to it.
+    std::unordered_set<Vector, VectorHash, VectorPred> vertices;
+    for(const STriangle &tr : m.l) {
+        vertices.insert(std::begin(tr.vertices), std::end(tr.vertices));
+    }
+    double worst = 0.0;
+    for(Vector p : vertices) {
+        double dist = VERY_POSITIVE;
+        for(const STriangle &dtr : d.l) {
+            dist = min(dist, DistanceToTriangle(p, dtr));
+            if(dist <= maxError) break;
+        }
+        worst = max(worst, dist);
+    }
+    CHECK_TRUE(worst <= maxError);
+    bool original = true;
+    for(const STriangle &dtr : d.l) {
+        for(int i = 0; i < 3; i++) {
+            if(vertices.find(dtr.vertices[i]) == vertices.end()) original = false;
+        }
+    }
+    CHECK_TRUE(original);
+
+    m.Clear();
+    d.Clear();
+}
+
+TEST_CASE(decimate_keeps_faces) {
+    SMesh m = {}, d = {};
+    MakeCylinder(&m, 10, 20, 128, 16);
+    m.MakeDecimatedInto(&d, 0, 0.01);
+
+    // Each face keeps to its own surface, so the caps stay flat and the side
+    // stays on the cylinder.
+    auto onSide = [](Vector p) {
+        return fabs(Vector::From(p.x, p.y, 0).Magnitude() - 10) < LENGTH_EPS;
+    };
+    int count[4] = {};
+    bool onFace = true;
+    for(const STriangle &tr : d.l) {
+        if(tr.meta.face < 1 || tr.meta.face > 3) {
+            onFace = false;
+            continue;
+        }
+        count[tr.meta.face]++;
+        for(int i = 0; i < 3; i++) {
+            Vector p = tr.vertices[i];
+            switch(tr.meta.face) {
+                case 1: onFace = onFace && onSide(p);               break;
+                case 2: onFace = onFace && fabs(p.z - 20) < LENGTH_EPS; break;
+                case 3: onFace = onFace && fabs(p.z) < LENGTH_EPS;      break;
+            }
+        }
+    }
+    CHECK_TRUE(onFace);
+    CHECK_TRUE(count[1] > 0 && count[2] > 0 && count[3] > 0);
+
+    // The sharp edges are still there, on the two circles, and still go all
+    // the way round them.
+    SOutlineList sol = {};
+    d.MakeOutlinesInto(&sol, EdgeKind::SHARP);
+    bool onCircle = true;
+    double length[2] = {};
+    for(const SOutline &so : sol.l) {
+        if(so.tag == 0) continue;
+        double z = so.a.z;
+        onCircle = onCircle && fabs(so.b.z - z) < LENGTH_EPS &&
+                   (fabs(z) < LENGTH_EPS || fabs(z - 20) < LENGTH_EPS);
+        onCircle = onCircle && onSide(so.a) && onSide(so.b);
+        length[(z > 10) ? 1 : 0] += so.b.Minus(so.a).Magnitude();
+    }
+    CHECK_TRUE(onCircle);
+    CHECK_EQ_EPS(length[0], length[1]);
+    CHECK_TRUE(fabs(length[0] - 2 * PI * 10) < 0.1);
+
+    sol.Clear();
+    m.Clear();
+    d.Clear();
+}
+
+// The way Simplify() used to find the triangle across an edge, by scanning
+// all of them and comparing the endpoints with Equals(). It's kept here to
+// check that looking them up by welded vertex gives the same triangles.
+static void SimplifyByScan(SMesh *m, int start) {
+    List<STriangle> &l = m->l;
+    int maxTriangles = (l.n - start) + 10;
+
+    STriMeta meta = l.elem[start].meta;
+
+    std::vector<STriangle> tout;
+    std::vector<Vector> conv(maxTriangles*3);
+    int convc = 0;
+
+    Vector n = Vector::From(0, 0, 0);
+    int start0 = start;
+
+    int i, j;
+    for(i = start; i < l.n; i++) {
+        STriangle *tr = &(l.elem[i]);
+        tr->tag = (tr->MinAltitude() < LENGTH_EPS) ? 1 : 0;
+    }
+
+    for(;;) {
+        bool didAdd;
+        convc = 0;
+        for(i = start; i < l.n; i++) {
+            STriangle *tr = &(l.elem[i]);
+            if(tr->tag) continue;
+
+            tr->tag = 1;
+            n = (tr->Normal()).WithMagnitude(1);
+            conv[convc++] = tr->a;
+            conv[convc++] = tr->b;
+            conv[convc++] = tr->c;
+
+            start = i+1;
+            break;
+        }
+        if(i >= l.n) break;
+
+        do {
+            didAdd = false;
+
+            for(j = 0; j < convc; j++) {
+                Vector a = conv[WRAP((j-1), convc)],
+                       b = conv[j],
+                       d = conv[WRAP((j+1), convc)],
+                       e = conv[WRAP((j+2), convc)];
+
+                Vector c;
+                for(i = start; i < l.n; i++) {
+                    STriangle *tr = &(l.elem[i]);
+                    if(tr->tag) continue;
+
+                    if((tr->a).Equals(d) && (tr->b).Equals(b)) {
+                        c = tr->c;
+                    } else if((tr->b).Equals(d) && (tr->c).Equals(b)) {
+                        c = tr->a;
+                    } else if((tr->c).Equals(d) && (tr->a).Equals(b)) {
+                        c = tr->b;
+                    } else {
+                        continue;
+                    }
+                    Vector ab = b.Minus(a);
+                    Vector bc = c.Minus(b);
+                    Vector cd = d.Minus(c);
+                    Vector de = e.Minus(d);
+
+                    double bDot = (ab.Cross(bc)).Dot(n);
+                    double dDot = (cd.Cross(de)).Dot(n);
+
+                    bDot /= min(ab.Magnitude(), bc.Magnitude());
+                    dDot /= min(cd.Magnitude(), de.Magnitude());
+
+                    if(fabs(bDot) < LENGTH_EPS && fabs(dDot) < LENGTH_EPS) {
+                        conv[WRAP((j+1), convc)] = c;
+                        conv.erase(conv.begin() + j);
+                        conv.push_back(Vector());
+                        convc--;
+                    } else if(fabs(bDot) < LENGTH_EPS && dDot > 0) {
+                        conv[j] = c;
+                    } else if(fabs(dDot) < LENGTH_EPS && bDot > 0) {
+                        conv[WRAP((j+1), convc)] = c;
+                    } else if(bDot > 0 && dDot > 0) {
+                        conv.insert(conv.begin() + j + 1, c);
+                        conv.pop_back();
+                        convc++;
+                    } else {
+                        continue;
+                    }
+
+                    didAdd = true;
+                    tr->tag = 1;
+                    break;
+                }
+            }
+        } while(didAdd);
+
+        for(i = 0; i < convc; i++) {
+            Vector a = conv[WRAP((i-1), convc)],
+                   b = conv[i],
+                   c = conv[WRAP((i+1), convc)];
+            Vector ab = b.Minus(a);
+            Vector bc = c.Minus(b);
+            double bDot = (ab.Cross(bc)).Dot(n);
+            bDot /= min(ab.Magnitude(), bc.Magnitude());
+
+            if(bDot < 0) return;
+        }
+
+        for(i = 0; i < convc - 2; i++) {
+            STriangle tr = STriangle::From(meta, conv[0], conv[i+1], conv[i+2]);
+            if(tr.MinAltitude() > LENGTH_EPS) {
+                tout.push_back(tr);
+            }
+        }
+    }
+
+    l.n = start0;
+    for(STriangle &tr : tout) {
+        m->AddTriangle(&tr);
+    }
+}
+
+// A square of cells in a plane, each cut along a random diagonal or fanned
+// from its center, with a few cells left out, and the triangles shuffled.
+// Corners get moved by up to jitter, so that they're Equals() but not equal
+// to the same corner of the cells around them.
+static void MakeCoplanarGrid(SMesh *m, int cells, Vector u, Vector v,
+                             double jitter, uint32_t seed) {
+    auto random = [&]() {
+        seed = seed * 1664525 + 1013904223;
+        return (double)(seed >> 8) / (1 << 24);
+    };
+    auto at = [&](double i, double j) {
+        Vector p = u.ScaledBy(i).Plus(v.ScaledBy(j));
+        Vector r = Vector::From(random() - 0.5, random() - 0.5, random() - 0.5);
+        return p.Plus(r.ScaledBy(jitter));
+    };
+    STriMeta meta = { /*face=*/1, RgbaColor::From(128, 128, 128) };
+
+    std::vector<STriangle> tris;
+    auto add = [&](Vector a, Vector b, Vector c) {
+        tris.push_back(STriangle::From(meta, a, b, c));
+    };
+    for(int i = 0; i < cells; i++) {
+        for(int j = 0; j < cells; j++) {
+            double kind = random();
+            if(kind < 0.05) continue;
+            Vector a = at(i, j), b = at(i + 1, j), c = at(i + 1, j + 1), d = at(i, j + 1);
+            if(kind < 0.2) {
+                Vector o = at(i + 0.5, j + 0.5);
+                add(a, b, o); add(b, c, o); add(c, d, o); add(d, a, o);
+            } else if(kind < 0.6) {
+                add(a, b, c); add(a, c, d);
+            } else {
+                add(a, b, d); add(b, c, d);
+            }
+        }
+    }
+    for(size_t i = tris.size() - 1; i > 0; i--) {
+        std::swap(tris[i], tris[(size_t)(random() * (i + 1))]);
+    }
+    for(STriangle &tr : tris) {
+        m->AddTriangle(&tr);
+    }
+}
+
+static bool SameTriangles(SMesh *a, SMesh *b) {
+    if(a->l.n != b->l.n) return false;
+    for(int i = 0; i < a->l.n; i++) {
+        for(int k = 0; k < 3; k++) {
+            if(!a->l.elem[i].vertices[k].EqualsExactly(b->l.elem[i].vertices[k])) return false;
+        }
+    }
+    return true;
+}
+
+TEST_CASE(simplify_same_as_scan) {
+    struct {
+        Vector   u, v;
+        double   jitter;
+    } planes[] = {
+        { Vector::From(1, 0, 0), Vector::From(0, 1, 0), 0 },
+        { Vector::From(0.6, 0.48, 0.64), Vector::From(-0.8, 0.36, 0.48), 0 },
+        // Each cluster of corners fits well inside LENGTH_EPS, so every corner
+        // in it Equals() every other, and they all weld together. Welding isn't
+        // transitive, so a cluster that's spread wider than that may come out
+        // differently than pairwise matching would.
+        { Vector::From(0.6, 0.48, 0.64), Vector::From(-0.8, 0.36, 0.48), LENGTH_EPS / 100 },
+    };
+    uint32_t seed = 1;
+    for(auto &plane : planes) {
+        SMesh m = {}, s = {};
+        MakeCoplanarGrid(&m, 30, plane.u.ScaledBy(3), plane.v.ScaledBy(3), plane.jitter, seed++);
+        for(const STriangle &tr : m.l) s.AddTriangle(&tr);
+        int before = m.l.n;
+
+        m.Simplify(0);
+        SimplifyByScan(&s, 0);
+        CHECK_TRUE(m.l.n < before / 2);
+        CHECK_TRUE(SameTriangles(&m, &s));
+
+        m.Clear();
+        s.Clear();
+    }
+}
+
+static double Volume(SMesh *m) {
+    double vol = 0.0;
+    for(const STriangle &tr : m->l) vol += tr.SignedVolume();
+    return vol;
+}
+
+static double Area(SMesh *m) {
+    double area = 0.0;
+    for(const STriangle &tr : m->l) area += tr.Normal().Magnitude() / 2;
+    return area;
+}
+
+static int NakedEdges(SMesh *m) {
+    SEdgeList el = {};
+    bool inters, leaks;
+    SKdNode::From(m)->MakeCertainEdgesInto(&el,
+        EdgeKind::NAKED_OR_SELF_INTER, /*coplanarIsInter=*/false, &inters, &leaks);
+    int n = el.l.n;
+    el.Clear();
+    return n;
+}
+
+// The same as MakeFromUnionOf() and MakeFromDifferenceOf(), but choosing how
+// the trees get built and the triangles classified against them.
+static void BooleanOf(SMesh *dest, SMesh *a, SMesh *b, bool difference,
+                      bool ordered, bool parallel) {
+    SBsp3 *bspa = SBsp3::FromMesh(a, ordered);
+    SBsp3 *bspb = SBsp3::FromMesh(b, ordered);
+
+    dest->flipNormal   = difference;
+    dest->keepCoplanar = difference;
+    dest->AddAgainstBsp(b, bspa, parallel);
+
+    dest->flipNormal   = false;
+    dest->keepCoplanar = !difference;
+    dest->AddAgainstBsp(a, bspb, parallel);
+}
+
+static void Translate(SMesh *m, Vector offset) {
+    for(STriangle &tr : m->l) {
+        for(int i = 0; i < 3; i++) {
+            tr.vertices[i] = tr.vertices[i].Plus(offset);
+        }
+    }
+}
+
+TEST_CASE(boolean_ordered_bsp) {
+    // A stack of pucks, so that there are planes that split it well, and a rod
+    // that goes through all of them.
+    SMesh a = {}, b = {};
+    for(int i = 0; i < 3; i++) {
+        SMesh puck = {};
+        MakeCylinder(&puck, 10, 10, 96, 4);
+        Translate(&puck, Vector::From(0, 0, 15 * i));
+        a.MakeFromCopyOf(&puck);
+        puck.Clear();
+    }
+    MakeCylinder(&b, 6, 50, 64, 3);
+    Translate(&b, Vector::From(8, 1, -5));
+    CHECK_TRUE(a.l.n > 2 * 256 && b.l.n > 2 * 256);
+
+    for(bool difference : { false, true }) {
+        SMesh ordered = {}, serial = {}, unordered = {}, unorderedSerial = {};
+        BooleanOf(&ordered,         &a, &b, difference, /*ordered=*/true,  /*parallel=*/true);
+        BooleanOf(&serial,          &a, &b, difference, /*ordered=*/true,  /*parallel=*/false);
+        BooleanOf(&unordered,       &a, &b, difference, /*ordered=*/false, /*parallel=*/true);
+        BooleanOf(&unorderedSerial, &a, &b, difference, /*ordered=*/false, /*parallel=*/false);
+
+        // Classifying in parallel gives exactly the serial result.
+        CHECK_TRUE(SameTriangles(&ordered, &serial));
+        CHECK_TRUE(SameTriangles(&unordered, &unorderedSerial));
+
+        // The order of the splitters changes how the triangles get cut up,
+        // but not the solid that they bound.
+        CHECK_FALSE(SameTriangles(&ordered, &unordered));
+        CHECK_EQ_EPS(Volume(&ordered), Volume(&unordered));
+        CHECK_EQ_EPS(Area(&ordered), Area(&unordered));
+        CHECK_TRUE(NakedEdges(&ordered) <= NakedEdges(&unordered));
+
+        ordered.Clear();
+        serial.Clear();
+        unordered.Clear();
+        unorderedSerial.Clear();
+    }
+
+    // And it is the right solid: a union b is a minus b, plus b.
+    SMesh sum = {}, diff = {};
+    BooleanOf(&sum,  &a, &b, /*difference=*/false, /*ordered=*/true, /*parallel=*/true);
+    BooleanOf(&diff, &a, &b, /*difference=*/true,  /*ordered=*/true, /*parallel=*/true);
+    CHECK_EQ_EPS(Volume(&sum), Volume(&diff) + Volume(&b));
+    CHECK_TRUE(Volume(&diff) < Volume(&a) && Volume(&sum) > Volume(&a));
+
+    sum.Clear();
+    diff.Clear();
+    a.Clear();
+    b.Clear();
+}
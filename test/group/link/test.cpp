@@ -15,3 +15,198 @@ TEST_CASE(normal_migrate_from_v22) {
     CHECK_LOAD("normal_v22.slvs");
     CHECK_SAVE("normal.slvs");
 }
+
+TEST_CASE(normal_roundtrip_binary) {
+    CHECK_LOAD("normal.slvs");
+
+    Platform::Path binaryPath = helper->GetAssetPath(__FILE__, "normal.slvsb", "out");
+    CHECK_TRUE(SS.SaveToFile(binaryPath));
+    bool loaded = SS.LoadFromFile(binaryPath);
+    RemoveFile(binaryPath);
+    CHECK_TRUE(loaded);
+    SS.AfterNewFile();
+
+    CHECK_SAVE("normal.slvs");
+}
+
+TEST_CASE(normal_autosave) {
+    CHECK_LOAD("normal.slvs");
+
+    // The autosave leaves out everything that loading regenerates, so load it
+    // back to compare it with the synchronous save.
+    SS.saveFile = helper->GetAssetPath(__FILE__, "normal.slvs", "autosave");
+    SS.unsaved = true;
+    CHECK_TRUE(SS.Autosave());
+    SS.WaitForAutosave();
+    Platform::Path autosavePath = SS.saveFile.WithExtension(AUTOSAVE_EXT);
+    bool loaded = SS.LoadFromFile(autosavePath);
+    RemoveFile(autosavePath);
+    CHECK_TRUE(loaded);
+    SS.AfterNewFile();
+
+    CHECK_SAVE("normal.slvs");
+}
+
+TEST_CASE(normal_mesh_only) {
+    CHECK_LOAD("mesh_only.slvs");
+    CHECK_SAVE("mesh_only.slvs");
+    Group *g = SK.GetGroup(SK.groupOrder.elem[SK.groupOrder.n - 1]);
+    CHECK_TRUE(g->type == Group::Type::LINKED && g->linkMeshOnly);
+
+    // Only the faces are left, along with what they're built from; and that's
+    // all that's held on to for the linked file, too.
+    auto builtFrom = [&](hEntity he) {
+        for(Entity &e : g->impEntity) {
+            if(!e.IsFace()) continue;
+            for(hEntity hp : e.point) {
+                if(hp.v == he.v) return true;
+            }
+            if(e.normal.v == he.v || e.distance.v == he.v) return true;
+        }
+        return false;
+    };
+    int faces = 0;
+    bool onlyFaces = true;
+    for(Entity &e : g->impEntity) {
+        if(e.IsFace()) {
+            faces++;
+        } else if(!builtFrom(e.h)) {
+            onlyFaces = false;
+        }
+    }
+    CHECK_TRUE(faces > 0);
+    CHECK_TRUE(onlyFaces);
+    CHECK_TRUE(SS.linkedFiles[g->linkFile].entity.n == g->impEntity.n);
+    int meshOnlyEntities = g->impEntity.n;
+    SShell meshOnlyShell = {};
+    meshOnlyShell.MakeFromCopyOf(&g->impShell);
+    CHECK_TRUE(meshOnlyShell.surface.n > 0);
+
+    // Linking all of it brings back everything else, with the same shell.
+    g->linkMeshOnly = 0;
+    SS.ReloadAllLinked(SS.saveFile);
+    SS.MarkGroupDirty(g->h);
+    SS.GenerateAll(SolveSpaceUI::Generate::ALL);
+    g = SK.GetGroup(g->h);
+    CHECK_TRUE(g->impEntity.n > meshOnlyEntities);
+    auto sameShell = [&]() {
+        if(g->impShell.surface.n != meshOnlyShell.surface.n) return false;
+        for(int i = 0; i < meshOnlyShell.surface.n; i++) {
+            SSurface *sa = &g->impShell.surface.elem[i], *sb = &meshOnlyShell.surface.elem[i];
+            if(sa->degm != sb->degm || sa->degn != sb->degn) return false;
+            for(int m = 0; m <= sa->degm; m++) {
+                for(int n = 0; n <= sa->degn; n++) {
+                    if(!sa->ctrl[m][n].EqualsExactly(sb->ctrl[m][n])) return false;
+                }
+            }
+        }
+        return true;
+    };
+    CHECK_TRUE(sameShell());
+
+    // Refer to the end points of a line that isn't part of any face; those,
+    // but not the line, stay when linking the mesh only again.
+    Entity *line = NULL;
+    for(Entity &e : g->impEntity) {
+        if(e.type == Entity::Type::LINE_SEGMENT && !builtFrom(e.point[0])) {
+            line = &e;
+            break;
+        }
+    }
+    CHECK_TRUE(line != NULL);
+    hEntity lineh = line->h, pointa = line->point[0], pointb = line->point[1];
+    hEntity linkedPoint[2] = {};
+    for(EntityMap &em : g->remap) {
+        if(em.input.v == pointa.v) linkedPoint[0] = g->Remap(em.input, em.copyNumber);
+        if(em.input.v == pointb.v) linkedPoint[1] = g->Remap(em.input, em.copyNumber);
+    }
+    Constraint c = {};
+    c.group     = g->h;
+    c.workplane = Entity::FREE_IN_3D;
+    c.type      = Constraint::Type::PT_PT_DISTANCE;
+    c.reference = true;
+    c.ptA       = linkedPoint[0];
+    c.ptB       = linkedPoint[1];
+    SK.constraint.AddAndAssignId(&c);
+
+    g->linkMeshOnly = 1;
+    SS.ReloadAllLinked(SS.saveFile);
+    SS.MarkGroupDirty(g->h);
+    SS.GenerateAll(SolveSpaceUI::Generate::ALL);
+    g = SK.GetGroup(g->h);
+    CHECK_TRUE(g->impEntity.n == meshOnlyEntities + 2);
+    CHECK_TRUE(g->impEntity.FindByIdNoOops(pointa) != NULL);
+    CHECK_TRUE(g->impEntity.FindByIdNoOops(pointb) != NULL);
+    CHECK_TRUE(g->impEntity.FindByIdNoOops(lineh) == NULL);
+    CHECK_TRUE(SK.entity.FindByIdNoOops(linkedPoint[0]) != NULL);
+    CHECK_TRUE(sameShell());
+
+    meshOnlyShell.Clear();
+}
+
+TEST_CASE(normal_linked_cache) {
+    CHECK_LOAD("normal.slvs");
+    Group *g = SK.GetGroup(SK.groupOrder.elem[SK.groupOrder.n - 1]);
+    CHECK_TRUE(g->type == Group::Type::LINKED);
+
+    // Link a copy instead, so that it can be changed.
+    std::string data;
+    CHECK_TRUE(ReadFile(helper->GetAssetPath(__FILE__, "rect_v20.slvs"), &data));
+    Platform::Path copyPath = helper->GetAssetPath(__FILE__, "rect_v20.slvs", "cache");
+    CHECK_TRUE(WriteFile(copyPath, data));
+    g->linkFile = copyPath;
+    SS.ReloadAllLinked(SS.saveFile);
+    g = SK.GetGroup(g->h);
+    CHECK_TRUE(SS.linkedFiles.count(copyPath) == 1);
+    int entities = g->impEntity.n;
+    CHECK_TRUE(entities > 0);
+
+    // While the file stays the same, it's taken from memory; so a mark on the
+    // copy in memory is still there after reloading.
+    SS.linkedFiles[copyPath].entity.elem[0].tag = 1;
+    SS.ReloadAllLinked(SS.saveFile);
+    g = SK.GetGroup(g->h);
+    CHECK_TRUE(SS.linkedFiles[copyPath].entity.elem[0].tag == 1);
+    CHECK_TRUE(g->impEntity.n == entities);
+
+    // Once it changes on disk, it's read again.
+    std::string solid;
+    CHECK_TRUE(ReadFile(helper->GetAssetPath(__FILE__, "solid.slvs"), &solid));
+    CHECK_TRUE(WriteFile(copyPath, solid));
+    SS.ReloadAllLinked(SS.saveFile);
+    g = SK.GetGroup(g->h);
+    CHECK_TRUE(SS.linkedFiles[copyPath].entity.elem[0].tag == 0);
+    CHECK_TRUE(g->impEntity.n != entities);
+    RemoveFile(copyPath);
+
+    // Loading several at once gives the same as loading each on its own.
+    std::vector<SolveSpaceUI::LinkedFileUse> uses;
+    for(const char *name : { "rect_v20.slvs", "solid.slvs", "normal.slvs",
+                             "normal_v20.slvs", "normal_v22.slvs" }) {
+        SolveSpaceUI::LinkedFileUse use = {};
+        use.filename = helper->GetAssetPath(__FILE__, name);
+        SS.ForgetLinkedFile(use.filename);
+        uses.push_back(use);
+    }
+    SS.LoadLinkedFiles(uses);
+    bool same = true;
+    for(const SolveSpaceUI::LinkedFileUse &use : uses) {
+        EntityList le = {};
+        SMesh m = {};
+        SShell sh = {};
+        CHECK_TRUE(SS.LoadEntitiesFromFile(use.filename, &le, &m, &sh));
+        CHECK_TRUE(SS.linkedFiles.count(use.filename) == 1);
+        SolveSpaceUI::LinkedFile *file = &SS.linkedFiles[use.filename];
+        if(file->entity.n != le.n || file->shell.surface.n != sh.surface.n) same = false;
+        for(int i = 0; same && i < le.n; i++) {
+            if(file->entity.elem[i].h.v != le.elem[i].h.v ||
+               file->entity.elem[i].type != le.elem[i].type) {
+                same = false;
+            }
+        }
+        le.Clear();
+        m.Clear();
+        sh.Clear();
+    }
+    CHECK_TRUE(same);
+}
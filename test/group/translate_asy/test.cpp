@@ -26,3 +26,48 @@ TEST_CASE(normal_inters) {
     // The assembly is supposed to interfere.
     CHECK_TRUE(inters);
 }
+
+TEST_CASE(normal_undo_redo) {
+    CHECK_LOAD("normal.slvs");
+
+    Platform::Path outPath = helper->GetAssetPath(__FILE__, "normal.slvs", "undo");
+    auto saved = [&]() {
+        std::string data;
+        if(SS.SaveToFile(outPath)) ReadFile(outPath, &data);
+        RemoveFile(outPath);
+        return data;
+    };
+    auto undoState = [&](int back) -> SolveSpaceUI::UndoState & {
+        return SS.undo.d[WRAP(SS.undo.write - back, SolveSpaceUI::MAX_UNDO)];
+    };
+
+    // Move the translated copy; only its param changes.
+    std::string before = saved();
+    CHECK_TRUE(!before.empty());
+    SS.UndoRemember();
+    Group *translate = SK.GetGroup(SK.groupOrder.elem[3]);
+    SK.GetParam(translate->h.param(0))->val += 5.0;
+    SS.MarkGroupDirty(translate->h);
+    std::string moved = saved();
+    CHECK_TRUE(moved != before);
+
+    // Then rename it; only the group changes.
+    SS.UndoRemember();
+    SolveSpaceUI::UndoState &beforeState = undoState(2), &movedState = undoState(1);
+    CHECK_TRUE(beforeState.request[0] == movedState.request[0]);
+    CHECK_TRUE(beforeState.group[3] == movedState.group[3]);
+    CHECK_TRUE(beforeState.param != movedState.param);
+    translate = SK.GetGroup(SK.groupOrder.elem[3]);
+    translate->name = "moved";
+    std::string renamed = saved();
+    CHECK_TRUE(renamed != moved);
+
+    SS.UndoUndo();
+    CHECK_TRUE(saved() == moved);
+    SS.UndoUndo();
+    CHECK_TRUE(saved() == before);
+    SS.UndoRedo();
+    CHECK_TRUE(saved() == moved);
+    SS.UndoRedo();
+    CHECK_TRUE(saved() == renamed);
+}
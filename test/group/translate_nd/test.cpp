@@ -1,5 +1,96 @@
 #include "harness.h"
 
+// Just enough of a JSON parser to check the structure of an export.
+struct JsonValue {
+    enum class Type { NONE, LITERAL, NUMBER, STRING, ARRAY, OBJECT };
+    Type                                type;
+    double                              number;
+    std::string                         string;
+    std::vector<JsonValue>              elements;
+    std::map<std::string, JsonValue>    members;
+
+    const JsonValue &operator[](const std::string &key) const {
+        static const JsonValue none = {};
+        auto it = members.find(key);
+        return (it == members.end()) ? none : it->second;
+    }
+    const JsonValue &operator[](size_t i) const {
+        static const JsonValue none = {};
+        return (i < elements.size()) ? elements[i] : none;
+    }
+};
+
+static const char *SkipJsonSpace(const char *p) {
+    while(*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+    return p;
+}
+
+static bool ParseJsonString(const char **p, std::string *str) {
+    if(**p != '"') return false;
+    for((*p)++; **p != '"'; (*p)++) {
+        if(**p == '\0') return false;
+        if(**p == '\\') {
+            (*p)++;
+            if(**p == '\0') return false;
+        }
+        *str += **p;
+    }
+    (*p)++;
+    return true;
+}
+
+static bool ParseJson(const char **p, JsonValue *v) {
+    *v = {};
+    *p = SkipJsonSpace(*p);
+    if(**p == '{') {
+        v->type = JsonValue::Type::OBJECT;
+        *p = SkipJsonSpace(*p + 1);
+        if(**p == '}') return (*p)++, true;
+        for(;;) {
+            std::string key;
+            *p = SkipJsonSpace(*p);
+            if(!ParseJsonString(p, &key)) return false;
+            *p = SkipJsonSpace(*p);
+            if(*(*p)++ != ':') return false;
+            if(!ParseJson(p, &v->members[key])) return false;
+            *p = SkipJsonSpace(*p);
+            char c = *(*p)++;
+            if(c == '}') return true;
+            if(c != ',') return false;
+        }
+    } else if(**p == '[') {
+        v->type = JsonValue::Type::ARRAY;
+        *p = SkipJsonSpace(*p + 1);
+        if(**p == ']') return (*p)++, true;
+        for(;;) {
+            v->elements.emplace_back();
+            if(!ParseJson(p, &v->elements.back())) return false;
+            *p = SkipJsonSpace(*p);
+            char c = *(*p)++;
+            if(c == ']') return true;
+            if(c != ',') return false;
+        }
+    } else if(**p == '"') {
+        v->type = JsonValue::Type::STRING;
+        return ParseJsonString(p, &v->string);
+    } else {
+        for(const char *literal : { "true", "false", "null" }) {
+            if(!strncmp(*p, literal, strlen(literal))) {
+                v->type = JsonValue::Type::LITERAL;
+                v->string = literal;
+                *p += strlen(literal);
+                return true;
+            }
+        }
+        char *end;
+        v->type = JsonValue::Type::NUMBER;
+        v->number = strtod(*p, &end);
+        if(end == *p) return false;
+        *p = end;
+        return true;
+    }
+}
+
 TEST_CASE(normal_roundtrip) {
     CHECK_LOAD("normal.slvs");
     CHECK_RENDER("normal.png");
@@ -10,3 +101,301 @@ TEST_CASE(normal_migrate_from_v22) {
     CHECK_LOAD("normal_v22.slvs");
     CHECK_SAVE("normal.slvs");
 }
+
+TEST_CASE(normal_vertex_to_vertex) {
+    CHECK_LOAD("normal.slvs");
+
+    // Redo the last difference as a mesh Boolean; that leaves the vertices of
+    // one mesh on the edges of the other, until we make it vertex-to-vertex.
+    Group *g = SK.GetGroup(SK.groupOrder.elem[SK.groupOrder.n - 1]);
+    SMesh prevm = {}, thism = {}, outm = {}, vvm = {}, serialm = {}, kdm = {};
+    g->PreviousGroup()->runningShell.TriangulateInto(&prevm);
+    g->thisShell.TriangulateInto(&thism);
+    outm.MakeFromDifferenceOf(&prevm, &thism);
+    outm.RemoveDegenerateTriangles();
+    outm.MakeVertexToVertexInto(&vvm);
+    outm.MakeVertexToVertexInto(&serialm, /*parallel=*/false);
+
+    // The reference, snapping to each vertex in turn through a kd tree.
+    SKdNode *root = SKdNode::From(&outm);
+    root->SnapToMesh(&outm);
+    root->MakeMeshInto(&kdm);
+
+    // Running in parallel doesn't change anything.
+    bool sameAsSerial = (vvm.l.n == serialm.l.n);
+    for(int i = 0; sameAsSerial && i < vvm.l.n; i++) {
+        for(int j = 0; j < 3; j++) {
+            if(!vvm.l.elem[i].vertices[j].EqualsExactly(serialm.l.elem[i].vertices[j])) {
+                sameAsSerial = false;
+            }
+        }
+    }
+    CHECK_TRUE(sameAsSerial);
+
+    // The triangles may get split differently, but there are as many of them,
+    // with the same vertices, enclosing the same volume.
+    CHECK_TRUE(vvm.l.n == kdm.l.n);
+    auto hasVertex = [](const SMesh &m, Vector p) {
+        for(const STriangle &tr : m.l) {
+            for(int j = 0; j < 3; j++) {
+                if(tr.vertices[j].Equals(p)) return true;
+            }
+        }
+        return false;
+    };
+    bool sameVertices = true;
+    for(const STriangle &tr : kdm.l) {
+        for(int j = 0; j < 3; j++) {
+            if(!hasVertex(vvm, tr.vertices[j])) sameVertices = false;
+        }
+    }
+    for(const STriangle &tr : vvm.l) {
+        for(int j = 0; j < 3; j++) {
+            if(!hasVertex(kdm, tr.vertices[j])) sameVertices = false;
+        }
+    }
+    CHECK_TRUE(sameVertices);
+    double volume = 0.0, kdVolume = 0.0;
+    for(const STriangle &tr : vvm.l) volume += tr.SignedVolume();
+    for(const STriangle &tr : kdm.l) kdVolume += tr.SignedVolume();
+    CHECK_EQ_EPS(volume, kdVolume);
+
+    // And both are closed.
+    for(SMesh *m : { &vvm, &kdm }) {
+        SEdgeList el = {};
+        bool inters, leaks;
+        SKdNode::From(m)->MakeCertainEdgesInto(&el,
+            EdgeKind::NAKED_OR_SELF_INTER, /*coplanarIsInter=*/false, &inters, &leaks);
+        CHECK_FALSE(leaks);
+        CHECK_TRUE(el.l.n == 0);
+        el.Clear();
+    }
+
+    prevm.Clear();
+    thism.Clear();
+    outm.Clear();
+    vvm.Clear();
+    serialm.Clear();
+    kdm.Clear();
+}
+
+TEST_CASE(normal_export_glb) {
+    CHECK_LOAD("normal.slvs");
+
+    Platform::Path glbPath = helper->GetAssetPath(__FILE__, "normal.glb", "out");
+    SS.ExportMeshTo(glbPath);
+    SS.exportMode = false;
+    std::string data;
+    bool read = ReadFile(glbPath, &data);
+    RemoveFile(glbPath);
+    CHECK_TRUE(read);
+
+    // The header, then a JSON chunk and a BIN chunk, each a multiple of four
+    // bytes long, which fill the file exactly.
+    uint32_t header[3], jsonChunk[2], binChunk[2];
+    CHECK_TRUE(data.size() >= sizeof(header) + sizeof(jsonChunk));
+    memcpy(header, &data[0], sizeof(header));
+    CHECK_TRUE(header[0] == 0x46546C67); // "glTF"
+    CHECK_TRUE(header[1] == 2);
+    CHECK_TRUE(header[2] == data.size());
+
+    memcpy(jsonChunk, &data[12], sizeof(jsonChunk));
+    CHECK_TRUE(jsonChunk[1] == 0x4E4F534A); // "JSON"
+    CHECK_TRUE(jsonChunk[0] % 4 == 0);
+    size_t binAt = 20 + jsonChunk[0];
+    CHECK_TRUE(binAt + sizeof(binChunk) <= data.size());
+
+    memcpy(binChunk, &data[binAt], sizeof(binChunk));
+    CHECK_TRUE(binChunk[1] == 0x004E4942); // "BIN"
+    CHECK_TRUE(binChunk[0] % 4 == 0);
+    CHECK_TRUE(binAt + sizeof(binChunk) + binChunk[0] == data.size());
+
+    // And the one buffer that the JSON describes is the BIN chunk.
+    std::string json = data.substr(20, jsonChunk[0]);
+    JsonValue gltf;
+    const char *p = json.c_str();
+    CHECK_TRUE(ParseJson(&p, &gltf));
+    CHECK_TRUE(*SkipJsonSpace(p) == '\0');
+    CHECK_TRUE(gltf["buffers"].elements.size() == 1);
+    CHECK_TRUE(gltf["buffers"][0]["byteLength"].number == binChunk[0]);
+    const char *bin = &data[binAt + sizeof(binChunk)];
+
+    const JsonValue &bufferViews = gltf["bufferViews"];
+    double viewBytes = 0.0;
+    for(const JsonValue &view : bufferViews.elements) {
+        viewBytes += view["byteLength"].number;
+    }
+    CHECK_TRUE(viewBytes == binChunk[0]);
+
+    // One primitive and one material per color, and one more of each for
+    // the outlines, if there are any.
+    Group *g = SK.GetGroup(SS.GW.activeGroup);
+    std::set<uint32_t> colors;
+    for(const STriangle &tr : g->displayMesh.l) colors.insert(tr.meta.color.ToPackedInt());
+    bool hasOutlines = false;
+    for(const SOutline &so : g->displayOutlines.l) {
+        if(so.tag != 0) hasOutlines = true;
+    }
+    const JsonValue &primitives = gltf["meshes"][0]["primitives"],
+                    &materials  = gltf["materials"],
+                    &accessors  = gltf["accessors"];
+    size_t primitiveCount = colors.size() + (hasOutlines ? 1 : 0);
+    CHECK_TRUE(primitives.elements.size() == primitiveCount);
+    CHECK_TRUE(materials.elements.size() == primitiveCount);
+
+    // The vertices are deduplicated: each (position, normal) pair is there
+    // once, and there are fewer of them than corners of triangles.
+    size_t vertexCount = (size_t)accessors[0]["count"].number;
+    CHECK_TRUE(accessors[1]["count"].number == vertexCount);
+    CHECK_TRUE(vertexCount < 3 * (size_t)g->displayMesh.l.n);
+    std::set<std::string> vertices;
+    size_t normalAt = (size_t)bufferViews[1]["byteOffset"].number;
+    for(size_t i = 0; i < vertexCount; i++) {
+        vertices.insert(std::string(bin + 12 * i, 12) + std::string(bin + normalAt + 12 * i, 12));
+    }
+    CHECK_TRUE(vertices.size() == vertexCount);
+
+    // Every triangle is in exactly one primitive, with indices that are in
+    // range.
+    size_t indexCount = 0;
+    bool inRange = true;
+    size_t indexAt = (size_t)bufferViews[2]["byteOffset"].number;
+    for(const JsonValue &primitive : primitives.elements) {
+        if(primitive["material"].number >= materials.elements.size()) inRange = false;
+        if(primitive["indices"].type == JsonValue::Type::NONE) continue;
+        const JsonValue &indices = accessors[(size_t)primitive["indices"].number];
+        size_t count = (size_t)indices["count"].number,
+               at    = indexAt + (size_t)indices["byteOffset"].number;
+        for(size_t i = 0; i < count; i++) {
+            uint32_t index;
+            memcpy(&index, bin + at + 4 * i, sizeof(index));
+            if(index >= vertexCount) inRange = false;
+        }
+        indexCount += count;
+    }
+    CHECK_TRUE(indexCount == 3 * (size_t)g->displayMesh.l.n);
+    CHECK_TRUE(inRange);
+}
+
+TEST_CASE(normal_export_step) {
+    CHECK_LOAD("normal.slvs");
+
+    // Exporting the same model twice gives the same file.
+    std::string step[2];
+    for(std::string &data : step) {
+        Platform::Path stepPath = helper->GetAssetPath(__FILE__, "normal.step", "out");
+        StepFileWriter sfw = {};
+        sfw.ExportSurfacesTo(stepPath);
+        bool read = ReadFile(stepPath, &data);
+        RemoveFile(stepPath);
+        CHECK_TRUE(read);
+    }
+    CHECK_TRUE(!step[0].empty());
+    CHECK_TRUE(step[0] == step[1]);
+
+    struct Edge {
+        int start, finish;
+        int forward, backward; // uses
+    };
+    struct OrientedEdge {
+        int  edge;
+        bool forward;
+    };
+    std::map<int, Edge> edges;
+    std::map<int, OrientedEdge> orientedEdges;
+    std::vector<std::vector<int>> loops;
+    std::istringstream lines(step[0]);
+    std::string line;
+    while(std::getline(lines, line)) {
+        int id, start, finish, curve, edge;
+        char sense;
+        if(sscanf(line.c_str(), "#%d=EDGE_CURVE('',#%d,#%d,#%d,", &id, &start, &finish,
+                  &curve) == 4) {
+            edges[id] = { start, finish, 0, 0 };
+        } else if(sscanf(line.c_str(), "#%d=ORIENTED_EDGE('',*,*,#%d,.%c.)", &id, &edge,
+                         &sense) == 3) {
+            orientedEdges[id] = { edge, sense == 'T' };
+        } else if(line.find("=EDGE_LOOP('',(") != std::string::npos) {
+            std::vector<int> loop;
+            const char *p = strchr(line.c_str(), '(');
+            while((p = strchr(p, '#')) != NULL) {
+                loop.push_back(atoi(p + 1));
+                p++;
+            }
+            loops.push_back(loop);
+        }
+    }
+    CHECK_TRUE(!edges.empty());
+
+    // Every edge of the closed solid is written once, and used by the two
+    // faces on either side of it, once in each direction; and the edges go
+    // head to tail around each loop.
+    bool linked = true;
+    for(const std::vector<int> &loop : loops) {
+        for(size_t i = 0; i < loop.size(); i++) {
+            if(!orientedEdges.count(loop[i])) {
+                linked = false;
+                continue;
+            }
+            const OrientedEdge &oe = orientedEdges[loop[i]],
+                               &next = orientedEdges[loop[(i + 1) % loop.size()]];
+            if(!edges.count(oe.edge) || !edges.count(next.edge)) {
+                linked = false;
+                continue;
+            }
+            Edge &e = edges[oe.edge], &ne = edges[next.edge];
+            (oe.forward ? e.forward : e.backward)++;
+            int finish = oe.forward ? e.finish : e.start,
+                start  = next.forward ? ne.start : ne.finish;
+            if(finish != start) linked = false;
+        }
+    }
+    CHECK_TRUE(linked);
+    bool sharedOnce = true;
+    for(const auto &it : edges) {
+        if(it.second.forward != 1 || it.second.backward != 1) sharedOnce = false;
+    }
+    CHECK_TRUE(sharedOnce);
+}
+
+TEST_CASE(normal_regen_cache) {
+    // Save with the group hashes, so that loading takes the last group's
+    // shell and mesh from the file instead of regenerating them.
+    CHECK_LOAD("normal.slvs");
+    Platform::Path cachePath = helper->GetAssetPath(__FILE__, "normal.slvs", "cache");
+    bool saveRegenCache = SS.saveRegenCache;
+    SS.saveRegenCache = true;
+    bool saved = SS.SaveToFile(cachePath);
+    SS.saveRegenCache = saveRegenCache;
+    CHECK_TRUE(saved);
+
+    CHECK_LOAD("normal.slvs");
+    Group *g = SK.GetGroup(SK.groupOrder.elem[SK.groupOrder.n - 1]);
+    CHECK_FALSE(g->regenCached);
+    g->GenerateDisplayItems();
+    SMesh regenerated = {};
+    regenerated.MakeFromCopyOf(&g->displayMesh);
+
+    bool loaded = SS.LoadFromFile(cachePath);
+    RemoveFile(cachePath);
+    CHECK_TRUE(loaded);
+    SS.AfterNewFile();
+    g = SK.GetGroup(SK.groupOrder.elem[SK.groupOrder.n - 1]);
+    CHECK_TRUE(g->regenCached);
+    g->GenerateDisplayItems();
+
+    // The cached geometry went through the file, so compare to within the
+    // usual tolerance.
+    SMesh *cached = &g->displayMesh;
+    CHECK_TRUE(cached->l.n == regenerated.l.n);
+    bool same = true;
+    for(int i = 0; i < cached->l.n; i++) {
+        const STriangle &a = cached->l.elem[i], &b = regenerated.l.elem[i];
+        for(int j = 0; j < 3; j++) {
+            if(!a.vertices[j].Equals(b.vertices[j])) same = false;
+        }
+        if(a.meta.face != b.meta.face) same = false;
+    }
+    regenerated.Clear();
+    CHECK_TRUE(same);
+}